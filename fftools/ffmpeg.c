@@ -140,6 +140,7 @@ unsigned nb_output_dumped = 0;
 
 static BenchmarkTimeStamps current_time;
 AVIOContext *progress_avio = NULL;
+AVIOContext *stage_stats_avio = NULL;
 
 InputStream **input_streams = NULL;
 int        nb_input_streams = 0;
@@ -513,6 +514,9 @@ static void ffmpeg_cleanup(int ret)
 
     for (i = 0; i < nb_filtergraphs; i++) {
         FilterGraph *fg = filtergraphs[i];
+        fg_thread_stop(fg);
+        av_frame_free(&fg->thread_frame);
+        fg_print_profile(fg);
         avfilter_graph_free(&fg->graph);
         for (j = 0; j < fg->nb_inputs; j++) {
             InputFilter *ifilter = fg->inputs[j];
@@ -570,6 +574,7 @@ static void ffmpeg_cleanup(int ret)
         av_freep(&ist->hwaccel_device);
         av_freep(&ist->dts_buffer);
 
+        dec_thread_stop(ist);
         avcodec_free_context(&ist->dec_ctx);
         avcodec_parameters_free(&ist->par);
 
@@ -589,6 +594,8 @@ static void ffmpeg_cleanup(int ret)
     av_freep(&input_files);
     av_freep(&output_files);
 
+    av_executor_free(&executor);
+
     uninit_opts();
 
     avformat_network_deinit();
@@ -644,6 +651,27 @@ static void abort_codec_experimental(const AVCodec *c, int encoder)
     exit_program(1);
 }
 
+void stage_stats_add_busy(StageStats *s, int64_t start)
+{
+    atomic_fetch_add(&s->busy_time, av_gettime_relative() - start);
+}
+
+void stage_stats_add_output(StageStats *s, const AVFrame *frame)
+{
+    atomic_fetch_add(&s->nb_output, 1);
+
+    if (frame) {
+        uint64_t size = 0;
+
+        for (int i = 0; i < FF_ARRAY_ELEMS(frame->buf) && frame->buf[i]; i++)
+            size += frame->buf[i]->size;
+        for (int i = 0; i < frame->nb_extended_buf; i++)
+            size += frame->extended_buf[i]->size;
+
+        atomic_fetch_add(&s->frame_bytes, size);
+    }
+}
+
 static void update_benchmark(const char *fmt, ...)
 {
     if (do_benchmark_all) {
@@ -822,12 +850,78 @@ static void update_video_stats(OutputStream *ost, const AVPacket *pkt, int write
     fprintf(vstats_file, "type= %c\n", av_get_picture_type_char(ost->pict_type));
 }
 
+static void encoded_packet_out(OutputFile *of, OutputStream *ost, AVPacket *pkt)
+{
+    AVCodecContext   *enc = ost->enc_ctx;
+    const char *type_desc = av_get_media_type_string(enc->codec_type);
+
+    if (debug_ts) {
+        av_log(NULL, AV_LOG_INFO, "encoder -> type:%s "
+               "pkt_pts:%s pkt_pts_time:%s pkt_dts:%s pkt_dts_time:%s "
+               "duration:%s duration_time:%s\n",
+               type_desc,
+               av_ts2str(pkt->pts), av_ts2timestr(pkt->pts, &enc->time_base),
+               av_ts2str(pkt->dts), av_ts2timestr(pkt->dts, &enc->time_base),
+               av_ts2str(pkt->duration), av_ts2timestr(pkt->duration, &enc->time_base));
+    }
+
+    av_packet_rescale_ts(pkt, enc->time_base, ost->mux_timebase);
+
+    if (debug_ts) {
+        av_log(NULL, AV_LOG_INFO, "encoder -> type:%s "
+               "pkt_pts:%s pkt_pts_time:%s pkt_dts:%s pkt_dts_time:%s "
+               "duration:%s duration_time:%s\n",
+               type_desc,
+               av_ts2str(pkt->pts), av_ts2timestr(pkt->pts, &enc->time_base),
+               av_ts2str(pkt->dts), av_ts2timestr(pkt->dts, &enc->time_base),
+               av_ts2str(pkt->duration), av_ts2timestr(pkt->duration, &enc->time_base));
+    }
+
+    ost->data_size_enc += pkt->size;
+
+    if (enc->codec_type == AVMEDIA_TYPE_VIDEO)
+        update_video_stats(ost, pkt, !!vstats_filename);
+
+    ost->packets_encoded++;
+    stage_stats_add_output(&ost->enc_stats, NULL);
+
+    of_output_packet(of, pkt, ost, 0);
+}
+
+/*
+ * Pass the packets returned so far by the encoding thread of ost on to the
+ * muxer. When flushing, wait until the encoder is fully flushed and return
+ * AVERROR_EOF.
+ */
+static int reap_encoder_thread(OutputFile *of, OutputStream *ost, int flush)
+{
+    AVPacket *pkt = ost->pkt;
+    int ret;
+
+    while (1) {
+        ret = enc_thread_receive_packet(ost, pkt, flush);
+        if (ret == AVERROR(EAGAIN))
+            return 0;
+        else if (ret == AVERROR_EOF) {
+            of_output_packet(of, pkt, ost, 1);
+            return ret;
+        } else if (ret < 0) {
+            av_log(NULL, AV_LOG_ERROR, "%s encoding failed\n",
+                   av_get_media_type_string(ost->enc_ctx->codec_type));
+            return ret;
+        }
+
+        encoded_packet_out(of, ost, pkt);
+    }
+}
+
 static int encode_frame(OutputFile *of, OutputStream *ost, AVFrame *frame)
 {
     AVCodecContext   *enc = ost->enc_ctx;
     AVPacket         *pkt = ost->pkt;
     const char *type_desc = av_get_media_type_string(enc->codec_type);
     const char    *action = frame ? "encode" : "flush";
+    int64_t start;
     int ret;
 
     if (frame) {
@@ -843,9 +937,28 @@ static int encode_frame(OutputFile *of, OutputStream *ost, AVFrame *frame)
         }
     }
 
+    if (enc_thread_running(ost)) {
+        /* both queues of the thread are bounded, so its packets must be
+         * drained while waiting for room for the frame */
+        while ((ret = enc_thread_send_frame(ost, frame)) == AVERROR(EAGAIN)) {
+            ret = reap_encoder_thread(of, ost, 0);
+            if (ret < 0)
+                return ret;
+            enc_thread_wait(ost);
+        }
+        if (ret < 0) {
+            av_log(NULL, AV_LOG_ERROR, "Error submitting %s frame to the encoder\n",
+                   type_desc);
+            return ret;
+        }
+        return reap_encoder_thread(of, ost, !frame);
+    }
+
     update_benchmark(NULL);
 
+    start = av_gettime_relative();
     ret = avcodec_send_frame(enc, frame);
+    stage_stats_add_busy(&ost->enc_stats, start);
     if (ret < 0 && !(ret == AVERROR_EOF && !frame)) {
         av_log(NULL, AV_LOG_ERROR, "Error submitting %s frame to the encoder\n",
                type_desc);
@@ -853,7 +966,9 @@ static int encode_frame(OutputFile *of, OutputStream *ost, AVFrame *frame)
     }
 
     while (1) {
+        start = av_gettime_relative();
         ret = avcodec_receive_packet(enc, pkt);
+        stage_stats_add_busy(&ost->enc_stats, start);
         update_benchmark("%s_%s %d.%d", action, type_desc,
                          ost->file_index, ost->index);
 
@@ -872,36 +987,7 @@ static int encode_frame(OutputFile *of, OutputStream *ost, AVFrame *frame)
             return ret;
         }
 
-        if (debug_ts) {
-            av_log(NULL, AV_LOG_INFO, "encoder -> type:%s "
-                   "pkt_pts:%s pkt_pts_time:%s pkt_dts:%s pkt_dts_time:%s "
-                   "duration:%s duration_time:%s\n",
-                   type_desc,
-                   av_ts2str(pkt->pts), av_ts2timestr(pkt->pts, &enc->time_base),
-                   av_ts2str(pkt->dts), av_ts2timestr(pkt->dts, &enc->time_base),
-                   av_ts2str(pkt->duration), av_ts2timestr(pkt->duration, &enc->time_base));
-        }
-
-        av_packet_rescale_ts(pkt, enc->time_base, ost->mux_timebase);
-
-        if (debug_ts) {
-            av_log(NULL, AV_LOG_INFO, "encoder -> type:%s "
-                   "pkt_pts:%s pkt_pts_time:%s pkt_dts:%s pkt_dts_time:%s "
-                   "duration:%s duration_time:%s\n",
-                   type_desc,
-                   av_ts2str(pkt->pts), av_ts2timestr(pkt->pts, &enc->time_base),
-                   av_ts2str(pkt->dts), av_ts2timestr(pkt->dts, &enc->time_base),
-                   av_ts2str(pkt->duration), av_ts2timestr(pkt->duration, &enc->time_base));
-        }
-
-        ost->data_size_enc += pkt->size;
-
-        if (enc->codec_type == AVMEDIA_TYPE_VIDEO)
-            update_video_stats(ost, pkt, !!vstats_filename);
-
-        ost->packets_encoded++;
-
-        of_output_packet(of, pkt, ost, 0);
+        encoded_packet_out(of, ost, pkt);
     }
 
     av_assert0(0);
@@ -1268,6 +1354,114 @@ static void do_video_out(OutputFile *of,
         av_frame_move_ref(ost->last_frame, next_picture);
 }
 
+static void filtered_frame_out(OutputStream *ost, AVFrame *filtered_frame)
+{
+    OutputFile    *of = output_files[ost->file_index];
+    AVFilterContext *filter = ost->filter->filter;
+    AVCodecContext *enc = ost->enc_ctx;
+
+    stage_stats_add_output(&ost->filter->graph->stats, filtered_frame);
+
+    if (ost->finished) {
+        av_frame_unref(filtered_frame);
+        return;
+    }
+
+    if (filtered_frame->pts != AV_NOPTS_VALUE) {
+        AVRational tb = av_buffersink_get_time_base(filter);
+        ost->last_filter_pts = av_rescale_q(filtered_frame->pts, tb,
+                                            AV_TIME_BASE_Q);
+    }
+
+    switch (av_buffersink_get_type(filter)) {
+    case AVMEDIA_TYPE_VIDEO:
+        /* the encoding thread does this on its own */
+        if (!ost->frame_aspect_ratio.num && !enc_thread_running(ost))
+            enc->sample_aspect_ratio = filtered_frame->sample_aspect_ratio;
+
+        do_video_out(of, ost, filtered_frame);
+        break;
+    case AVMEDIA_TYPE_AUDIO:
+        if (!(enc->codec->capabilities & AV_CODEC_CAP_PARAM_CHANGE) &&
+            enc->ch_layout.nb_channels != filtered_frame->ch_layout.nb_channels) {
+            av_log(NULL, AV_LOG_ERROR,
+                   "Audio filter graph output is not normalized and encoder does not support parameter changes\n");
+            break;
+        }
+        do_audio_out(of, ost, filtered_frame);
+        break;
+    default:
+        // TODO support subtitle filters
+        av_assert0(0);
+    }
+
+    av_frame_unref(filtered_frame);
+}
+
+/*
+ * Process the frames sent so far by the filtering thread of fg. If ctl is
+ * non-negative, the given control message is sent to the thread first and
+ * this function waits for its reply.
+ */
+static int reap_filter_thread(FilterGraph *fg, int ctl)
+{
+    int ret;
+
+    if (ctl >= 0) {
+        /* both queues of the thread are bounded, so its frames must be
+         * processed while waiting for room for the message */
+        while ((ret = fg_thread_send_control(fg, ctl)) == AVERROR(EAGAIN)) {
+            ret = reap_filter_thread(fg, -1);
+            if (ret < 0)
+                return ret;
+            fg_thread_wait(fg);
+        }
+        if (ret < 0)
+            return ret;
+    }
+
+    while (1) {
+        OutputStream *ost;
+        int idx;
+
+        ret = fg_thread_receive(fg, &idx, fg->thread_frame, ctl >= 0);
+        if (ret == AVERROR(EAGAIN))
+            return 0;
+        if (ret < 0 && ret != AVERROR_EOF)
+            return ret;
+        if (idx == fg->nb_outputs)
+            return 0;
+
+        ost = fg->outputs[idx]->ost;
+        if (ret == AVERROR_EOF) {
+            if (av_buffersink_get_type(ost->filter->filter) == AVMEDIA_TYPE_VIDEO)
+                do_video_out(output_files[ost->file_index], ost, NULL);
+            close_output_stream(ost);
+            continue;
+        }
+
+        /* stop the thread from filtering for an output that is done */
+        if (ost->finished)
+            fg_thread_close_output(fg, idx);
+
+        filtered_frame_out(ost, fg->thread_frame);
+    }
+}
+
+/*
+ * Wait until the filtering thread of fg has room for more input, processing
+ * the frames it sends meanwhile.
+ */
+static int wait_filter_thread(FilterGraph *fg)
+{
+    int ret = reap_filter_thread(fg, -1);
+    if (ret < 0)
+        return ret;
+
+    fg_thread_wait(fg);
+    return 0;
+}
+
 /**
  * Get and encode new output from any of the filtergraphs, without causing
  * activity.
@@ -1282,10 +1476,10 @@ static int reap_filters(int flush)
     for (OutputStream *ost = ost_iter(NULL); ost; ost = ost_iter(ost)) {
         OutputFile    *of = output_files[ost->file_index];
         AVFilterContext *filter;
-        AVCodecContext *enc = ost->enc_ctx;
         int ret = 0;
 
-        if (!ost->filter || !ost->filter->graph->graph)
+        if (!ost->filter || !ost->filter->graph->graph ||
+            fg_thread_running(ost->filter->graph))
             continue;
         filter = ost->filter->filter;
 
@@ -1304,8 +1498,10 @@ static int reap_filters(int flush)
         filtered_frame = ost->filtered_frame;
 
         while (1) {
+            int64_t start = av_gettime_relative();
             ret = av_buffersink_get_frame_flags(filter, filtered_frame,
                                                AV_BUFFERSINK_FLAG_NO_REQUEST);
+            stage_stats_add_busy(&ost->filter->graph->stats, start);
             if (ret < 0) {
                 if (ret != AVERROR(EAGAIN) && ret != AVERROR_EOF) {
                     av_log(NULL, AV_LOG_WARNING,
@@ -1316,45 +1512,57 @@ static int reap_filters(int flush)
                 }
                 break;
             }
-            if (ost->finished) {
-                av_frame_unref(filtered_frame);
-                continue;
-            }
 
-            if (filtered_frame->pts != AV_NOPTS_VALUE) {
-                AVRational tb = av_buffersink_get_time_base(filter);
-                ost->last_filter_pts = av_rescale_q(filtered_frame->pts, tb,
-                                                    AV_TIME_BASE_Q);
-            }
+            filtered_frame_out(ost, filtered_frame);
+        }
+    }
 
-            switch (av_buffersink_get_type(filter)) {
-            case AVMEDIA_TYPE_VIDEO:
-                if (!ost->frame_aspect_ratio.num)
-                    enc->sample_aspect_ratio = filtered_frame->sample_aspect_ratio;
+    for (OutputStream *ost = ost_iter(NULL); ost; ost = ost_iter(ost)) {
+        int ret;
 
-                do_video_out(of, ost, filtered_frame);
-                break;
-            case AVMEDIA_TYPE_AUDIO:
-                if (!(enc->codec->capabilities & AV_CODEC_CAP_PARAM_CHANGE) &&
-                    enc->ch_layout.nb_channels != filtered_frame->ch_layout.nb_channels) {
-                    av_log(NULL, AV_LOG_ERROR,
-                           "Audio filter graph output is not normalized and encoder does not support parameter changes\n");
-                    break;
-                }
-                do_audio_out(of, ost, filtered_frame);
-                break;
-            default:
-                // TODO support subtitle filters
-                av_assert0(0);
-            }
+        if (!enc_thread_running(ost))
+            continue;
 
-            av_frame_unref(filtered_frame);
-        }
+        ret = reap_encoder_thread(output_files[ost->file_index], ost, 0);
+        if (ret < 0 && ret != AVERROR_EOF)
+            return ret;
+    }
+
+    /* filtering threads flush their outputs on their own */
+    for (int i = 0; i < nb_filtergraphs; i++) {
+        FilterGraph *fg = filtergraphs[i];
+        int ret;
+
+        if (!fg_thread_running(fg))
+            continue;
+
+        ret = reap_filter_thread(fg, -1);
+        if (ret < 0)
+            return ret;
     }
 
     return 0;
 }
 
+/*
+ * Start filtering in a separate thread, if enabled, after the graph has been
+ * (re)configured.
+ */
+static int filtergraph_start(FilterGraph *fg)
+{
+    if (!filtergraph_threads)
+        return 0;
+
+    /* see the comment on audio encoder initialization in reap_filters() */
+    for (int i = 0; i < fg->nb_outputs; i++) {
+        OutputFilter *ofilter = fg->outputs[i];
+        if (av_buffersink_get_type(ofilter->filter) == AVMEDIA_TYPE_AUDIO)
+            init_output_stream_wrapper(ofilter->ost, NULL, 1);
+    }
+
+    return fg_thread_start(fg);
+}
+
 static void print_final_stats(int64_t total_size)
 {
     uint64_t video_size = 0, audio_size = 0, extra_size = 0, other_size = 0;
@@ -1475,6 +1683,142 @@ static void print_final_stats(int64_t total_size)
     }
 }
 
+static void print_stage(AVBPrint *bp, const char *stage, const char *id,
+                        StageStats *s, int frames, double interval)
+{
+    int64_t  busy_time = atomic_load(&s->busy_time);
+    uint64_t nb_output = atomic_load(&s->nb_output);
+
+    av_bprintf(bp, "%s{\"stage\":\"%s\",\"id\":\"%s\",\"busy\":%.6f,\"load\":%.3f,"
+               "\"%s\":%"PRIu64",\"%s\":%.2f",
+               bp->len && bp->str[bp->len - 1] != '[' ? "," : "", stage, id,
+               busy_time / 1e6,
+               interval > 0 ? (busy_time - s->last_busy_time) / 1e6 / interval : 0.0,
+               frames ? "frames" : "packets", nb_output,
+               frames ? "fps" : "pps",
+               interval > 0 ? (nb_output - s->last_nb_output) / interval : 0.0);
+    if (frames)
+        av_bprintf(bp, ",\"frame_bytes\":%"PRIu64, (uint64_t)atomic_load(&s->frame_bytes));
+
+    s->last_busy_time = busy_time;
+    s->last_nb_output = nb_output;
+}
+
+static void print_stage_queue(AVBPrint *bp, const char *name,
+                              size_t nb_queued, size_t queue_size)
+{
+    av_bprintf(bp, ",\"%s\":%zu,\"%s_size\":%zu", name, nb_queued, name, queue_size);
+}
+
+static void print_stage_tq(AVBPrint *bp, const char *name, ThreadQueue *tq)
+{
+    size_t nb_queued = 0, queue_size = 0;
+
+    if (tq)
+        tq_occupancy(tq, &nb_queued, &queue_size);
+    print_stage_queue(bp, name, nb_queued, queue_size);
+}
+
+/*
+ * Write one JSON object describing every stage of the processing pipeline to
+ * the -stage_stats output. Rates and loads are computed over the time since
+ * the previous report. The current time is sampled here rather than passed by
+ * the caller, so that the work done since the caller sampled it is included.
+ */
+static void print_stage_stats(int is_last_report, int64_t timer_start)
+{
+    static int64_t last_time = -1;
+    int64_t cur_time = av_gettime_relative();
+    double interval;
+    AVBPrint bp;
+    char id[32];
+    size_t nb_queued, queue_size;
+    int ret;
+
+    if (last_time < 0)
+        last_time = timer_start;
+    interval  = (cur_time - last_time) / 1e6;
+    last_time = cur_time;
+
+    av_bprint_init(&bp, 0, AV_BPRINT_SIZE_UNLIMITED);
+    av_bprintf(&bp, "{\"time\":%.6f,\"progress\":\"%s\",\"stages\":[",
+               (cur_time - timer_start) / 1e6, is_last_report ? "end" : "continue");
+
+    for (int i = 0; i < nb_input_files; i++) {
+        InputFile *f = input_files[i];
+
+        snprintf(id, sizeof(id), "%d", i);
+        print_stage(&bp, "demux", id, &f->demux_stats, 0, interval);
+        ifile_queue_occupancy(f, &nb_queued, &queue_size);
+        print_stage_queue(&bp, "queue", nb_queued, queue_size);
+        av_bprintf(&bp, "}");
+    }
+
+    for (int i = 0; i < nb_input_streams; i++) {
+        InputStream *ist = input_streams[i];
+
+        if (!ist->decoding_needed)
+            continue;
+
+        snprintf(id, sizeof(id), "%d:%d", ist->file_index, ist->st->index);
+        print_stage(&bp, "decode", id, &ist->dec_stats, 1, interval);
+        if (dec_thread_running(ist)) {
+            print_stage_tq(&bp, "queue_in",  ist->dec_queue_in);
+            print_stage_tq(&bp, "queue_out", ist->dec_queue_out);
+        }
+        av_bprintf(&bp, "}");
+    }
+
+    for (int i = 0; i < nb_filtergraphs; i++) {
+        FilterGraph *fg = filtergraphs[i];
+
+        snprintf(id, sizeof(id), "%d", i);
+        print_stage(&bp, "filter", id, &fg->stats, 1, interval);
+        if (fg_thread_running(fg)) {
+            print_stage_tq(&bp, "queue_in",  fg->queue_in);
+            print_stage_tq(&bp, "queue_out", fg->queue_out);
+        }
+        av_bprintf(&bp, "}");
+    }
+
+    for (OutputStream *ost = ost_iter(NULL); ost; ost = ost_iter(ost)) {
+        if (!ost->enc_ctx)
+            continue;
+
+        snprintf(id, sizeof(id), "%d:%d", ost->file_index, ost->index);
+        print_stage(&bp, "encode", id, &ost->enc_stats, 0, interval);
+        if (enc_thread_running(ost)) {
+            print_stage_tq(&bp, "queue_in",  ost->enc_queue_in);
+            print_stage_tq(&bp, "queue_out", ost->enc_queue_out);
+        }
+        av_bprintf(&bp, "}");
+    }
+
+    for (int i = 0; i < nb_output_files; i++) {
+        OutputFile *of = output_files[i];
+
+        snprintf(id, sizeof(id), "%d", i);
+        print_stage(&bp, "mux", id, &of->mux_stats, 0, interval);
+        of_queue_occupancy(of, &nb_queued, &queue_size);
+        print_stage_queue(&bp, "queue", nb_queued, queue_size);
+        av_bprintf(&bp, "}");
+    }
+
+    av_bprintf(&bp, "]}\n");
+
+    if (av_bprint_is_complete(&bp))
+        avio_write(stage_stats_avio, bp.str, bp.len);
+    avio_flush(stage_stats_avio);
+    av_bprint_finalize(&bp, NULL);
+
+    if (is_last_report) {
+        if ((ret = avio_closep(&stage_stats_avio)) < 0)
+            av_log(NULL, AV_LOG_ERROR,
+                   "Error closing stage statistics log, loss of information possible: %s\n",
+                   av_err2str(ret));
+    }
+}
+
 static void print_report(int is_last_report, int64_t timer_start, int64_t cur_time)
 {
     AVBPrint buf, buf_script;
@@ -1491,7 +1835,7 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
     int ret;
     float t;
 
-    if (!print_stats && !is_last_report && !progress_avio)
+    if (!print_stats && !is_last_report && !progress_avio && !stage_stats_avio)
         return;
 
     if (!is_last_report) {
@@ -1666,6 +2010,9 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
         }
     }
 
+    if (stage_stats_avio)
+        print_stage_stats(is_last_report, timer_start);
+
     first_report = 0;
 
     if (is_last_report)
@@ -1877,6 +2224,7 @@ static int ifilter_send_frame(InputFilter *ifilter, AVFrame *frame, int keep_ref
 {
     FilterGraph *fg = ifilter->graph;
     AVFrameSideData *sd;
+    int64_t start;
     int need_reinit, ret;
     int buffersrc_flags = AV_BUFFERSRC_FLAG_PUSH;
 
@@ -1930,6 +2278,16 @@ static int ifilter_send_frame(InputFilter *ifilter, AVFrame *frame, int keep_ref
             return ret;
         }
 
+        if (fg_thread_running(fg)) {
+            /* wait for the frames already sent to the graph being replaced */
+            ret = reap_filter_thread(fg, FG_CONTROL_SYNC);
+            fg_thread_stop(fg);
+            if (ret < 0) {
+                av_log(NULL, AV_LOG_ERROR, "Error while filtering: %s\n", av_err2str(ret));
+                return ret;
+            }
+        }
+
         ret = reap_filters(1);
         if (ret < 0 && ret != AVERROR_EOF) {
             av_log(NULL, AV_LOG_ERROR, "Error while filtering: %s\n", av_err2str(ret));
@@ -1941,9 +2299,24 @@ static int ifilter_send_frame(InputFilter *ifilter, AVFrame *frame, int keep_ref
             av_log(NULL, AV_LOG_ERROR, "Error reinitializing filters!\n");
             return ret;
         }
+
+        ret = filtergraph_start(fg);
+        if (ret < 0)
+            return ret;
+    }
+
+    if (fg_thread_running(fg)) {
+        while ((ret = fg_thread_send_frame(ifilter, frame, keep_reference)) == AVERROR(EAGAIN)) {
+            ret = wait_filter_thread(fg);
+            if (ret < 0)
+                return ret;
+        }
+        return ret;
     }
 
+    start = av_gettime_relative();
     ret = av_buffersrc_add_frame_flags(ifilter->filter, frame, buffersrc_flags);
+    stage_stats_add_busy(&fg->stats, start);
     if (ret < 0) {
         if (ret != AVERROR_EOF)
             av_log(NULL, AV_LOG_ERROR, "Error while filtering: %s\n", av_err2str(ret));
@@ -1959,7 +2332,15 @@ static int ifilter_send_eof(InputFilter *ifilter, int64_t pts)
 
     ifilter->eof = 1;
 
-    if (ifilter->filter) {
+    if (fg_thread_running(ifilter->graph)) {
+        while ((ret = fg_thread_send_eof(ifilter, pts)) == AVERROR(EAGAIN)) {
+            ret = wait_filter_thread(ifilter->graph);
+            if (ret < 0)
+                return ret;
+        }
+        if (ret < 0)
+            return ret;
+    } else if (ifilter->filter) {
         ret = av_buffersrc_close(ifilter->filter, pts, AV_BUFFERSRC_FLAG_PUSH);
         if (ret < 0)
             return ret;
@@ -1983,8 +2364,10 @@ static int ifilter_send_eof(InputFilter *ifilter, int64_t pts)
 // There is the following difference: if you got a frame, you must call
 // it again with pkt=NULL. pkt==NULL is treated differently from pkt->size==0
 // (pkt==NULL means get more output, pkt->size==0 is a flush/drain packet)
-static int decode(AVCodecContext *avctx, AVFrame *frame, int *got_frame, AVPacket *pkt)
+static int decode(InputStream *ist, AVFrame *frame, int *got_frame, AVPacket *pkt)
 {
+    AVCodecContext *avctx = ist->dec_ctx;
+    int64_t start = av_gettime_relative();
     int ret;
 
     *got_frame = 0;
@@ -1993,11 +2376,39 @@ static int decode(AVCodecContext *avctx, AVFrame *frame, int *got_frame, AVPacke
         ret = avcodec_send_packet(avctx, pkt);
         // In particular, we don't expect AVERROR(EAGAIN), because we read all
         // decoded frames with avcodec_receive_frame() until done.
-        if (ret < 0 && ret != AVERROR_EOF)
+        if (ret < 0 && ret != AVERROR_EOF) {
+            stage_stats_add_busy(&ist->dec_stats, start);
             return ret;
+        }
     }
 
     ret = avcodec_receive_frame(avctx, frame);
+    stage_stats_add_busy(&ist->dec_stats, start);
+    if (ret < 0 && ret != AVERROR(EAGAIN))
+        return ret;
+    if (ret >= 0) {
+        stage_stats_add_output(&ist->dec_stats, frame);
+        *got_frame = 1;
+    }
+
+    return 0;
+}
+
+// Same as decode(), but with the decoding done in the stream's decoding thread.
+// The packet is not sent again when it already was, see defer_packet().
+static int decode_threaded(InputStream *ist, AVFrame *frame, int *got_frame, AVPacket *pkt)
+{
+    int ret;
+
+    *got_frame = 0;
+
+    if (pkt && !ist->dec_thread_pending) {
+        ret = dec_thread_send_packet(ist, pkt);
+        if (ret < 0)
+            return ret;
+    }
+
+    ret = dec_thread_receive_frame(ist, frame);
     if (ret < 0 && ret != AVERROR(EAGAIN))
         return ret;
     if (ret >= 0)
@@ -2033,7 +2444,9 @@ static int decode_audio(InputStream *ist, AVPacket *pkt, int *got_output,
     AVRational decoded_frame_tb;
 
     update_benchmark(NULL);
-    ret = decode(avctx, decoded_frame, got_output, pkt);
+    ret = dec_thread_running(ist) ?
+          decode_threaded(ist, decoded_frame, got_output, pkt) :
+          decode(ist, decoded_frame, got_output, pkt);
     update_benchmark("decode_audio %d.%d", ist->file_index, ist->st->index);
     if (ret < 0)
         *decode_failed = 1;
@@ -2115,43 +2528,20 @@ static int decode_video(InputStream *ist, AVPacket *pkt, int *got_output, int64_
     }
 
     update_benchmark(NULL);
-    ret = decode(ist->dec_ctx, decoded_frame, got_output, pkt);
+    ret = dec_thread_running(ist) ?
+          decode_threaded(ist, decoded_frame, got_output, pkt) :
+          decode(ist, decoded_frame, got_output, pkt);
     update_benchmark("decode_video %d.%d", ist->file_index, ist->st->index);
     if (ret < 0)
         *decode_failed = 1;
 
-    // The following line may be required in some cases where there is no parser
-    // or the parser does not has_b_frames correctly
-    if (ist->par->video_delay < ist->dec_ctx->has_b_frames) {
-        if (ist->dec_ctx->codec_id == AV_CODEC_ID_H264) {
-            ist->par->video_delay = ist->dec_ctx->has_b_frames;
-        } else
-            av_log(ist->dec_ctx, AV_LOG_WARNING,
-                   "video_delay is larger in decoder than demuxer %d > %d.\n"
-                   "If you want to help, upload a sample "
-                   "of this file to https://streams.videolan.org/upload/ "
-                   "and contact the ffmpeg-devel mailing list. (ffmpeg-devel@ffmpeg.org)\n",
-                   ist->dec_ctx->has_b_frames,
-                   ist->par->video_delay);
-    }
+    // done by the decoding thread itself when threaded
+    if (!dec_thread_running(ist))
+        dec_check_video_params(ist, *got_output && ret >= 0 ? decoded_frame : NULL);
 
     if (ret != AVERROR_EOF)
         check_decode_result(ist, got_output, ret);
 
-    if (*got_output && ret >= 0) {
-        if (ist->dec_ctx->width  != decoded_frame->width ||
-            ist->dec_ctx->height != decoded_frame->height ||
-            ist->dec_ctx->pix_fmt != decoded_frame->format) {
-            av_log(NULL, AV_LOG_DEBUG, "Frame parameters mismatch context %d,%d,%d != %d,%d,%d\n",
-                decoded_frame->width,
-                decoded_frame->height,
-                decoded_frame->format,
-                ist->dec_ctx->width,
-                ist->dec_ctx->height,
-                ist->dec_ctx->pix_fmt);
-        }
-    }
-
     if (!*got_output || ret < 0)
         return ret;
 
@@ -2297,6 +2687,42 @@ static int send_filter_eof(InputStream *ist)
 }
 
 /* pkt = NULL means EOF (needed to flush decoder buffers) */
+/*
+ * Send a packet to the stream's decoding thread, leaving the processing of its
+ * frames to finish_deferred_packet(). Everything done for the packet by
+ * process_input_packet() then happens in the same way as without the thread,
+ * while the decoding runs in parallel with the processing of other packets.
+ *
+ * Only one packet per stream is deferred: the timestamp checks of the next
+ * packet read for the stream depend on the frames of this one.
+ */
+static int defer_packet(InputStream *ist, const AVPacket *pkt)
+{
+    AVPacket *avpkt = ist->pkt;
+    int ret;
+
+    ret = av_packet_ref(ist->dec_thread_deferred_pkt, pkt);
+    if (ret < 0)
+        return ret;
+
+    // set in decode_video() when not deferred
+    if (ist->par->codec_type == AVMEDIA_TYPE_VIDEO)
+        avpkt->dts = ist->next_dts != AV_NOPTS_VALUE ?
+                     av_rescale_q(ist->next_dts, AV_TIME_BASE_Q, ist->st->time_base) :
+                     AV_NOPTS_VALUE;
+
+    ret = dec_thread_send_packet(ist, avpkt);
+    av_packet_unref(avpkt);
+    if (ret < 0) {
+        av_packet_unref(ist->dec_thread_deferred_pkt);
+        return ret;
+    }
+
+    ist->dec_thread_deferred = 1;
+
+    return 0;
+}
+
 static int process_input_packet(InputStream *ist, const AVPacket *pkt, int no_eof)
 {
     const AVCodecParameters *par = ist->par;
@@ -2336,6 +2762,16 @@ static int process_input_packet(InputStream *ist, const AVPacket *pkt, int no_eo
             ist->next_pts = ist->pts = ist->dts;
     }
 
+    if (pkt && pkt->size && dec_thread_running(ist) && !ist->dec_thread_deferred) {
+        ret = defer_packet(ist, pkt);
+        if (ret < 0) {
+            av_log(NULL, AV_LOG_FATAL, "Error sending a packet for decoding "
+                   "for stream #%d:%d\n", ist->file_index, ist->st->index);
+            exit_program(1);
+        }
+        return 1;
+    }
+
     // while we have more to decode or while the decoder did output something on EOF
     while (ist->decoding_needed) {
         int64_t duration_dts = 0;
@@ -2489,6 +2925,27 @@ static int process_input_packet(InputStream *ist, const AVPacket *pkt, int no_eo
     return !eof_reached;
 }
 
+/*
+ * Process the frames of the packet sent by defer_packet(); this must be done
+ * before anything else is done with the stream.
+ */
+static void finish_deferred_packet(InputStream *ist)
+{
+    if (!ist->dec_thread_deferred)
+        return;
+
+    process_input_packet(ist, ist->dec_thread_deferred_pkt, 0);
+
+    // the remaining frames are dropped when decoding was interrupted by an error
+    while (ist->dec_thread_pending) {
+        dec_thread_receive_frame(ist, ist->decoded_frame);
+        av_frame_unref(ist->decoded_frame);
+    }
+
+    ist->dec_thread_deferred = 0;
+    av_packet_unref(ist->dec_thread_deferred_pkt);
+}
+
 static enum AVPixelFormat get_format(AVCodecContext *s, const enum AVPixelFormat *pix_fmts)
 {
     InputStream *ist = s->opaque;
@@ -2584,6 +3041,7 @@ static int init_input_stream(int ist_index, char *error, int error_len)
             return ret;
         }
 
+        ist->dec_ctx->executor = executor;
         if ((ret = avcodec_open2(ist->dec_ctx, codec, &ist->decoder_opts)) < 0) {
             if (ret == AVERROR_EXPERIMENTAL)
                 abort_codec_experimental(codec, 0);
@@ -2595,6 +3053,20 @@ static int init_input_stream(int ist_index, char *error, int error_len)
             return ret;
         }
         assert_avoptions(ist->decoder_opts);
+
+        /* hwaccel frames are retrieved with the decoder context from the
+         * main thread, so those decoders are kept there */
+        if (decoder_threads && ist->hwaccel_id == HWACCEL_NONE &&
+            !ist->dec_ctx->hw_device_ctx &&
+            (codec->type == AVMEDIA_TYPE_VIDEO ||
+             codec->type == AVMEDIA_TYPE_AUDIO)) {
+            ret = dec_thread_start(ist);
+            if (ret < 0) {
+                snprintf(error, error_len, "Error starting the decoder thread "
+                         "for input stream #%d:%d", ist->file_index, ist->st->index);
+                return ret;
+            }
+        }
     }
 
     ist->next_pts = AV_NOPTS_VALUE;
@@ -3074,6 +3546,7 @@ static int init_output_stream(OutputStream *ost, AVFrame *frame,
             return ret;
         }
 
+        ost->enc_ctx->executor = executor;
         if ((ret = avcodec_open2(ost->enc_ctx, codec, &ost->encoder_opts)) < 0) {
             if (ret == AVERROR_EXPERIMENTAL)
                 abort_codec_experimental(codec, 1);
@@ -3100,6 +3573,16 @@ static int init_output_stream(OutputStream *ost, AVFrame *frame,
             exit_program(1);
         }
 
+        if (encoder_threads && (codec->type == AVMEDIA_TYPE_VIDEO ||
+                                codec->type == AVMEDIA_TYPE_AUDIO)) {
+            ret = enc_thread_start(ost);
+            if (ret < 0) {
+                snprintf(error, error_len, "Error starting the encoder thread "
+                         "for output stream #%d:%d", ost->file_index, ost->index);
+                return ret;
+            }
+        }
+
         if (ost->enc_ctx->nb_coded_side_data) {
             int i;
 
@@ -3413,6 +3896,11 @@ static int check_keyboard_interaction(int64_t cur_time)
             for (i = 0; i < nb_filtergraphs; i++) {
                 FilterGraph *fg = filtergraphs[i];
                 if (fg->graph) {
+                    if (fg_thread_running(fg)) {
+                        ret = reap_filter_thread(fg, FG_CONTROL_SYNC);
+                        if (ret < 0)
+                            return ret;
+                    }
                     if (time < 0) {
                         ret = avfilter_graph_send_command(fg->graph, target, command, arg, buf, sizeof(buf),
                                                           key == 'c' ? AVFILTER_CMD_FLAG_ONE : 0);
@@ -3506,6 +3994,8 @@ static void decode_flush(InputFile *ifile)
         if (!ist->processing_needed)
             continue;
 
+        finish_deferred_packet(ist);
+
         do {
             ret = process_input_packet(ist, NULL, 1);
         } while (ret > 0);
@@ -3646,6 +4136,11 @@ static int process_input(int file_index)
                 exit_program(1);
         }
 
+        /* filters may depend on the order of EOF relative to the frames of
+         * the other inputs, so it is the same as without decoding threads */
+        for (i = 0; i < nb_input_streams; i++)
+            finish_deferred_packet(input_streams[i]);
+
         for (i = 0; i < ifile->nb_streams; i++) {
             ist = input_streams[ifile->ist_index + i];
             if (ist->processing_needed) {
@@ -3678,6 +4173,8 @@ static int process_input(int file_index)
     if (ist->discard)
         goto discard_packet;
 
+    finish_deferred_packet(ist);
+
     /* add the stream-global side data to the first packet */
     if (ist->nb_packets == 1) {
         for (i = 0; i < ist->st->nb_side_data; i++) {
@@ -3737,7 +4234,30 @@ static int transcode_from_filter(FilterGraph *graph, InputStream **best_ist)
     InputStream *ist;
 
     *best_ist = NULL;
-    ret = avfilter_graph_request_oldest(graph->graph);
+
+    if (fg_thread_running(graph)) {
+        /* the filtering thread processes whatever it gets from a single
+         * input, so there is nothing to request while that input is live */
+        if (graph->nb_inputs == 1) {
+            ifilter = graph->inputs[0];
+            ist = ifilter->ist;
+            if (!ifilter->eof &&
+                !input_files[ist->file_index]->eagain &&
+                !input_files[ist->file_index]->eof_reached) {
+                *best_ist = ist;
+                return 0;
+            }
+        }
+
+        ret = reap_filter_thread(graph, FG_CONTROL_REQUEST);
+        if (ret < 0)
+            return ret;
+        ret = graph->request_ret;
+    } else {
+        int64_t start = av_gettime_relative();
+        ret = avfilter_graph_request_oldest(graph->graph);
+        stage_stats_add_busy(&graph->stats, start);
+    }
     if (ret >= 0)
         return reap_filters(0);
 
@@ -3799,6 +4319,10 @@ static int transcode_step(void)
                 av_log(NULL, AV_LOG_ERROR, "Error reinitializing filters!\n");
                 return ret;
             }
+
+            ret = filtergraph_start(ost->filter->graph);
+            if (ret < 0)
+                return ret;
         }
     }
 
@@ -3910,11 +4434,19 @@ static int transcode(void)
     for (i = 0; i < nb_input_streams; i++) {
         ist = input_streams[i];
         if (!input_files[ist->file_index]->eof_reached) {
+            finish_deferred_packet(ist);
             process_input_packet(ist, NULL, 0);
         }
     }
+    for (i = 0; i < nb_input_streams; i++)
+        dec_thread_stop(input_streams[i]);
+    for (i = 0; i < nb_filtergraphs; i++)
+        fg_thread_stop(filtergraphs[i]);
     flush_encoders();
 
+    for (OutputStream *ost = ost_iter(NULL); ost; ost = ost_iter(ost))
+        enc_thread_stop(ost);
+
     term_exit();
 
     /* write the trailer if needed */
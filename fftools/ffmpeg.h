@@ -28,6 +28,7 @@
 
 #include "cmdutils.h"
 #include "sync_queue.h"
+#include "thread_queue.h"
 
 #include "libavformat/avformat.h"
 #include "libavformat/avio.h"
@@ -40,6 +41,7 @@
 #include "libavutil/avutil.h"
 #include "libavutil/dict.h"
 #include "libavutil/eval.h"
+#include "libavutil/executor.h"
 #include "libavutil/fifo.h"
 #include "libavutil/hwcontext.h"
 #include "libavutil/pixfmt.h"
@@ -254,11 +256,29 @@ typedef struct OptionsContext {
     int        nb_bits_per_raw_sample;
 } OptionsContext;
 
+/**
+ * Statistics of a processing stage, updated by the thread running the stage
+ * and read by the main thread for -stage_stats.
+ */
+typedef struct StageStats {
+    // time spent processing, in microseconds
+    atomic_int_least64_t  busy_time;
+    // number of frames or packets output by the stage
+    atomic_uint_least64_t nb_output;
+    // combined size of the buffers of the frames output by the stage
+    atomic_uint_least64_t frame_bytes;
+
+    /* values at the previous report, only used by the main thread */
+    int64_t  last_busy_time;
+    uint64_t last_nb_output;
+} StageStats;
+
 typedef struct InputFilter {
     AVFilterContext    *filter;
     struct InputStream *ist;
     struct FilterGraph *graph;
     uint8_t            *name;
+    int                 index;  // index in FilterGraph.inputs
     enum AVMediaType    type;   // AVMEDIA_TYPE_SUBTITLE for sub2video
 
     AVFifo *frame_queue;
@@ -283,6 +303,7 @@ typedef struct OutputFilter {
     struct OutputStream *ost;
     struct FilterGraph  *graph;
     uint8_t             *name;
+    int                  index; // index in FilterGraph.outputs
 
     /* temporary storage until stream maps are processed */
     AVFilterInOut       *out_tmp;
@@ -316,6 +337,27 @@ typedef struct FilterGraph {
     int          nb_inputs;
     OutputFilter **outputs;
     int         nb_outputs;
+
+    /* filtering thread, only used when queue_in is non-NULL;
+     * see fg_thread_start() */
+    pthread_t    thread;
+    ThreadQueue *queue_in;
+    ThreadQueue *queue_out;
+    /* used by the main thread for exchanging frames with the thread */
+    AVFrame     *thread_frame;
+    /* written by the filtering thread before it replies to a control
+     * message, read by the main thread after receiving the reply */
+    int          request_ret;
+    /* written by the filtering thread before it terminates due to an error */
+    int          thread_err;
+    /* incremented by the filtering thread whenever it takes an item, outputs
+     * a frame or terminates; see fg_thread_wait() */
+    pthread_mutex_t progress_lock;
+    pthread_cond_t  progress_cond;
+    unsigned        progress;
+    unsigned        wait_progress;
+
+    StageStats   stats;
 } FilterGraph;
 
 typedef struct InputStream {
@@ -339,6 +381,22 @@ typedef struct InputStream {
     AVFrame *decoded_frame;
     AVPacket *pkt;
 
+    /* decoding thread, only used when dec_queue_in is non-NULL;
+     * see dec_thread_start() */
+    pthread_t    dec_thread;
+    ThreadQueue *dec_queue_in;
+    ThreadQueue *dec_queue_out;
+    /* used by the main thread for sending packets to dec_queue_in */
+    AVPacket    *dec_thread_pkt;
+    /* written by the decoding thread before it terminates due to an error */
+    int          dec_thread_err;
+    /* set while the result of decoding a sent packet has not been received */
+    int          dec_thread_pending;
+    /* set when the frames of dec_thread_deferred_pkt, which was sent to the
+     * decoding thread, are yet to be processed */
+    int          dec_thread_deferred;
+    AVPacket    *dec_thread_deferred_pkt;
+
     AVRational framerate_guessed;
 
     int64_t       prev_pkt_pts;
@@ -424,6 +482,8 @@ typedef struct InputStream {
     int nb_dts_buffer;
 
     int got_output;
+
+    StageStats dec_stats;
 } InputStream;
 
 typedef struct LastFrameDuration {
@@ -462,6 +522,8 @@ typedef struct InputFile {
      * the last frame duration back to the demuxer thread */
     AVThreadMessageQueue *audio_duration_queue;
     int                   audio_duration_queue_size;
+
+    StageStats demux_stats;
 } InputFile;
 
 enum forced_keyframes_const {
@@ -512,6 +574,23 @@ typedef struct OutputStream {
     AVFrame *last_frame;
     AVFrame *sq_frame;
     AVPacket *pkt;
+
+    /* encoding thread, only used when enc_queue_in is non-NULL;
+     * see enc_thread_start() */
+    pthread_t    enc_thread;
+    ThreadQueue *enc_queue_in;
+    ThreadQueue *enc_queue_out;
+    /* used by the main thread for sending frames to enc_queue_in */
+    AVFrame     *enc_thread_frame;
+    /* written by the encoding thread before it terminates due to an error */
+    int          enc_thread_err;
+    /* incremented by the encoding thread whenever it takes a frame, outputs
+     * a packet or terminates; see enc_thread_wait() */
+    pthread_mutex_t enc_progress_lock;
+    pthread_cond_t  enc_progress_cond;
+    unsigned        enc_progress;
+    unsigned        enc_wait_progress;
+
     int64_t last_dropped;
     int64_t last_nb0_frames[3];
 
@@ -604,6 +683,8 @@ typedef struct OutputStream {
 
     int sq_idx_encode;
     int sq_idx_mux;
+
+    StageStats enc_stats;
 } OutputStream;
 
 typedef struct OutputFile {
@@ -622,6 +703,8 @@ typedef struct OutputFile {
 
     int shortest;
     int bitexact;
+
+    StageStats mux_stats;
 } OutputFile;
 
 extern InputStream **input_streams;
@@ -659,10 +742,17 @@ extern int64_t stats_period;
 extern int qp_hist;
 extern int stdin_interaction;
 extern AVIOContext *progress_avio;
+extern AVIOContext *stage_stats_avio;
 extern float max_error_rate;
 
 extern char *filter_nbthreads;
 extern int filter_complex_nbthreads;
+extern int filtergraph_threads;
+extern int filter_frame_threads;
+extern int filter_profile;
+extern int encoder_threads;
+extern int decoder_threads;
+extern AVExecutor *executor;
 extern int vstats_version;
 extern int auto_conversion_filters;
 
@@ -707,6 +797,163 @@ void sub2video_update(InputStream *ist, int64_t heartbeat_pts, AVSubtitle *sub);
 
 int ifilter_parameters_from_frame(InputFilter *ifilter, const AVFrame *frame);
 
+/**
+ * Start the filtering thread for a configured filtergraph, if the graph is
+ * eligible for running in its own thread and it is not running already.
+ *
+ * Once the thread is running, the graph must only be accessed by the main
+ * thread between receiving a reply from fg_thread_receive() and sending the
+ * next item with fg_thread_send_*().
+ */
+int fg_thread_start(FilterGraph *fg);
+void fg_thread_stop(FilterGraph *fg);
+/**
+ * Log the processing statistics of every filter of a profiled graph.
+ */
+void fg_print_profile(FilterGraph *fg);
+/**
+ * @return 1 if frames sent to the graph are filtered in its own thread
+ */
+int fg_thread_running(const FilterGraph *fg);
+
+/**
+ * Send a frame to the filtering thread. The frame is left untouched on
+ * failure.
+ *
+ * The fg_thread_send_*() functions do not block and return AVERROR(EAGAIN)
+ * when the input queue of the thread is full, another negative error code
+ * when the thread terminated due to an error.
+ */
+int fg_thread_send_frame(InputFilter *ifilter, AVFrame *frame, int keep_reference);
+int fg_thread_send_eof(InputFilter *ifilter, int64_t pts);
+
+enum FilterGraphControl {
+    /* reply once all the previously sent frames have been filtered */
+    FG_CONTROL_SYNC,
+    /* same as FG_CONTROL_SYNC, but first request a frame from the oldest
+     * output with avfilter_graph_request_oldest(); its return value is
+     * stored in FilterGraph.request_ret */
+    FG_CONTROL_REQUEST,
+    FG_CONTROL_NB,
+};
+int fg_thread_send_control(FilterGraph *fg, enum FilterGraphControl ctl);
+/**
+ * Wait until the filtering thread has made progress since the last call to
+ * fg_thread_send_*() that returned AVERROR(EAGAIN).
+ *
+ * The frames output by the thread must be received before waiting, as the
+ * thread blocks when its output queue is full.
+ */
+void fg_thread_wait(FilterGraph *fg);
+/**
+ * Tell the filtering thread that no more frames are wanted from the given
+ * output. The thread stops producing frames once all its outputs are
+ * finished or closed.
+ */
+void fg_thread_close_output(FilterGraph *fg, int output_idx);
+
+/**
+ * Receive a filtered frame from the graph thread.
+ *
+ * @param output_idx index of the output the frame belongs to, or nb_outputs
+ *                   for a reply to a control message, is written here
+ * @param block wait until an item is available
+ * @return
+ * - 0 a frame or a control reply was received
+ * - AVERROR(EAGAIN) nothing is available and block is 0
+ * - AVERROR_EOF the output given by *output_idx is finished
+ * - another negative error code when the thread terminated due to an error
+ */
+int fg_thread_receive(FilterGraph *fg, int *output_idx, AVFrame *frame, int block);
+
+/**
+ * Start the encoding thread for an output stream whose encoder has been
+ * opened. Once the thread is running, the encoder must not be used directly
+ * by the main thread until the thread is stopped.
+ */
+int  enc_thread_start(OutputStream *ost);
+void enc_thread_stop(OutputStream *ost);
+/**
+ * @return 1 if frames for the stream are encoded in its own thread
+ */
+int  enc_thread_running(const OutputStream *ost);
+/**
+ * Send a frame to the encoding thread, or flush the encoder when frame is
+ * NULL. The frame is not modified.
+ *
+ * @return 0 on success, AVERROR(EAGAIN) if the input queue of the thread is
+ *         full, another negative error code when the thread terminated due
+ *         to an error
+ */
+int  enc_thread_send_frame(OutputStream *ost, AVFrame *frame);
+/**
+ * Wait until the encoding thread has made progress since the last call to
+ * enc_thread_send_frame() that returned AVERROR(EAGAIN).
+ *
+ * The packets output by the thread must be received before waiting, as the
+ * thread blocks when its output queue is full.
+ */
+void enc_thread_wait(OutputStream *ost);
+/**
+ * Receive an encoded packet from the encoding thread.
+ *
+ * @param block wait until a packet is available or the encoder is flushed
+ * @return
+ * - 0 a packet was received
+ * - AVERROR(EAGAIN) no packet is available and block is 0
+ * - AVERROR_EOF the encoder has been fully flushed
+ * - another negative error code when the thread terminated due to an error
+ */
+int  enc_thread_receive_packet(OutputStream *ost, AVPacket *pkt, int block);
+
+/**
+ * Start the decoding thread for an input stream whose decoder has been
+ * opened. Once the thread is running, the decoder must not be used directly
+ * by the main thread until the thread is stopped, except for flushing it
+ * after the end of decoding has been received.
+ */
+int  dec_thread_start(InputStream *ist);
+void dec_thread_stop(InputStream *ist);
+/**
+ * @return 1 if packets for the stream are decoded in its own thread
+ */
+int  dec_thread_running(const InputStream *ist);
+/**
+ * Send a packet to the decoding thread; a packet without data and side data
+ * starts draining the decoder. The packet is not modified.
+ *
+ * The result of decoding the packet must be received with
+ * dec_thread_receive_frame() before sending the next one.
+ */
+int  dec_thread_send_packet(InputStream *ist, const AVPacket *pkt);
+/**
+ * Receive a frame decoded from the last sent packet, waiting until it is
+ * available. All frames output for a packet are followed by the return code
+ * of the decoder, after which the next packet may be sent.
+ *
+ * @return
+ * - 0 a frame was received
+ * - AVERROR(EAGAIN) all frames for the packet were received
+ * - AVERROR_EOF the decoder has been fully drained
+ * - another negative error code returned by the decoder or the thread
+ */
+int  dec_thread_receive_frame(InputStream *ist, AVFrame *frame);
+/**
+ * Check the parameters of a decoded video frame, and of the decoder, against
+ * the stream parameters.
+ */
+void dec_check_video_params(InputStream *ist, const AVFrame *frame);
+
+/**
+ * Account the time elapsed since start, as returned by av_gettime_relative(),
+ * as spent processing by the stage.
+ */
+void stage_stats_add_busy(StageStats *s, int64_t start);
+/**
+ * Account a frame, or a packet when frame is NULL, output by the stage.
+ */
+void stage_stats_add_output(StageStats *s, const AVFrame *frame);
+
 int ffmpeg_parse_options(int argc, char **argv);
 
 HWDevice *hw_device_get_by_name(const char *name);
@@ -743,6 +990,11 @@ void of_close(OutputFile **pof);
  */
 void of_output_packet(OutputFile *of, AVPacket *pkt, OutputStream *ost, int eof);
 int64_t of_filesize(OutputFile *of);
+/**
+ * Get the number of packets currently queued for the muxing thread and the
+ * size of its queue.
+ */
+void of_queue_occupancy(OutputFile *of, size_t *nb_queued, size_t *queue_size);
 AVChapter * const *
 of_get_chapters(OutputFile *of, unsigned int *nb_chapters);
 
@@ -760,6 +1012,11 @@ void ifile_close(InputFile **f);
  * - a negative error code on failure
  */
 int ifile_get_packet(InputFile *f, AVPacket **pkt);
+/**
+ * Get the number of packets currently queued by the demuxing thread and the
+ * size of its queue.
+ */
+void ifile_queue_occupancy(InputFile *f, size_t *nb_queued, size_t *queue_size);
 
 #define SPECIFIER_OPT_FMT_str  "%s"
 #define SPECIFIER_OPT_FMT_i    "%i"
@@ -0,0 +1,310 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "ffmpeg.h"
+#include "objpool.h"
+#include "thread_queue.h"
+
+#include "libavutil/avassert.h"
+#include "libavutil/error.h"
+#include "libavutil/frame.h"
+#include "libavutil/thread.h"
+#include "libavutil/time.h"
+
+#include "libavcodec/avcodec.h"
+#include "libavcodec/packet.h"
+
+void dec_check_video_params(InputStream *ist, const AVFrame *frame)
+{
+    // The following line may be required in some cases where there is no parser
+    // or the parser does not has_b_frames correctly
+    if (ist->par->video_delay < ist->dec_ctx->has_b_frames) {
+        if (ist->dec_ctx->codec_id == AV_CODEC_ID_H264) {
+            ist->par->video_delay = ist->dec_ctx->has_b_frames;
+        } else
+            av_log(ist->dec_ctx, AV_LOG_WARNING,
+                   "video_delay is larger in decoder than demuxer %d > %d.\n"
+                   "If you want to help, upload a sample "
+                   "of this file to https://streams.videolan.org/upload/ "
+                   "and contact the ffmpeg-devel mailing list. (ffmpeg-devel@ffmpeg.org)\n",
+                   ist->dec_ctx->has_b_frames,
+                   ist->par->video_delay);
+    }
+
+    if (frame) {
+        if (ist->dec_ctx->width  != frame->width ||
+            ist->dec_ctx->height != frame->height ||
+            ist->dec_ctx->pix_fmt != frame->format) {
+            av_log(NULL, AV_LOG_DEBUG, "Frame parameters mismatch context %d,%d,%d != %d,%d,%d\n",
+                frame->width,
+                frame->height,
+                frame->format,
+                ist->dec_ctx->width,
+                ist->dec_ctx->height,
+                ist->dec_ctx->pix_fmt);
+        }
+    }
+}
+
+int dec_thread_running(const InputStream *ist)
+{
+    return !!ist->dec_queue_in;
+}
+
+static void thread_set_name(InputStream *ist)
+{
+    char name[16];
+    snprintf(name, sizeof(name), "dec%d:%d", ist->file_index, ist->st->index);
+    ff_thread_setname(name);
+}
+
+/* Report the result of decoding a packet to the main thread, after all the
+ * frames output for it, as a frame without data carrying the return code:
+ * AVERROR(EAGAIN) when the decoder needs more input, AVERROR_EOF when it has
+ * been fully drained, or an error. */
+static int send_status(InputStream *ist, AVFrame *frame, int err)
+{
+    av_frame_unref(frame);
+    frame->opaque = (void*)(intptr_t)err;
+    return tq_send(ist->dec_queue_out, 0, frame);
+}
+
+static void *decoder_thread(void *arg)
+{
+    InputStream    *ist = arg;
+    AVCodecContext *dec = ist->dec_ctx;
+    AVPacket       *pkt = NULL;
+    AVFrame      *frame = NULL;
+    int             ret = 0;
+
+    pkt   = av_packet_alloc();
+    frame = av_frame_alloc();
+    if (!pkt || !frame) {
+        ret = AVERROR(ENOMEM);
+        goto finish;
+    }
+
+    thread_set_name(ist);
+
+    while (1) {
+        int64_t start;
+        int idx;
+
+        ret = tq_receive(ist->dec_queue_in, &idx, pkt);
+        if (ret < 0) {
+            ret = 0;
+            break;
+        }
+
+        start = av_gettime_relative();
+
+        /* the same calls as done by decode() in the main thread, so that the
+         * frames and errors are exactly the same; an empty packet starts
+         * draining the decoder */
+        ret = avcodec_send_packet(dec, pkt);
+        av_packet_unref(pkt);
+        if (ret < 0 && ret != AVERROR_EOF) {
+            stage_stats_add_busy(&ist->dec_stats, start);
+            ret = send_status(ist, frame, ret);
+            if (ret < 0)
+                break;
+            continue;
+        }
+
+        while (1) {
+            ret = avcodec_receive_frame(dec, frame);
+            if (dec->codec_type == AVMEDIA_TYPE_VIDEO)
+                dec_check_video_params(ist, ret >= 0 ? frame : NULL);
+
+            if (ret < 0) {
+                stage_stats_add_busy(&ist->dec_stats, start);
+                ret = send_status(ist, frame, ret);
+                break;
+            }
+
+            stage_stats_add_output(&ist->dec_stats, frame);
+            ret = tq_send(ist->dec_queue_out, 0, frame);
+            if (ret < 0) {
+                av_frame_unref(frame);
+                break;
+            }
+        }
+        if (ret < 0)
+            break;
+    }
+
+finish:
+    /* AVERROR_EOF means the main thread does not want any more frames */
+    if (ret < 0 && ret != AVERROR_EOF)
+        ist->dec_thread_err = ret;
+
+    tq_receive_finish(ist->dec_queue_in, 0);
+    tq_send_finish(ist->dec_queue_out, 0);
+
+    av_frame_free(&frame);
+    av_packet_free(&pkt);
+
+    av_log(NULL, AV_LOG_VERBOSE, "Terminating decoder thread %d:%d\n",
+           ist->file_index, ist->st->index);
+
+    return NULL;
+}
+
+static void pkt_move(void *dst, void *src)
+{
+    av_packet_move_ref(dst, src);
+}
+
+static void frame_move(void *dst, void *src)
+{
+    av_frame_move_ref(dst, src);
+}
+
+int dec_thread_start(InputStream *ist)
+{
+    ObjPool *op;
+    int ret;
+
+    if (ist->dec_queue_in)
+        return 0;
+
+    if (!ist->dec_thread_pkt) {
+        ist->dec_thread_pkt = av_packet_alloc();
+        if (!ist->dec_thread_pkt)
+            return AVERROR(ENOMEM);
+    }
+    if (!ist->dec_thread_deferred_pkt) {
+        ist->dec_thread_deferred_pkt = av_packet_alloc();
+        if (!ist->dec_thread_deferred_pkt)
+            return AVERROR(ENOMEM);
+    }
+
+    op = objpool_alloc_packets();
+    if (!op)
+        return AVERROR(ENOMEM);
+
+    /* At most one packet per stream is in flight, see defer_packet(): the
+     * frames of a packet advance ist->next_dts, which the timestamp checks of
+     * the next packet of the stream and the dts given to video decoders
+     * depend on, so they must be processed before that packet is sent.
+     * Decoding still overlaps with the demuxing and processing of the other
+     * streams, which is where the parallelism comes from. */
+    ist->dec_queue_in = tq_alloc(1, 1, op, pkt_move);
+    if (!ist->dec_queue_in) {
+        objpool_free(&op);
+        return AVERROR(ENOMEM);
+    }
+
+    op = objpool_alloc_frames();
+    if (!op) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+
+    /* the main thread may block on sending packets, so the decoder must never
+     * block on sending frames back */
+    ist->dec_queue_out = tq_alloc(1, 0, op, frame_move);
+    if (!ist->dec_queue_out) {
+        objpool_free(&op);
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+
+    ist->dec_thread_err      = 0;
+    ist->dec_thread_pending  = 0;
+    ist->dec_thread_deferred = 0;
+
+    ret = pthread_create(&ist->dec_thread, NULL, decoder_thread, ist);
+    if (ret) {
+        ret = AVERROR(ret);
+        goto fail;
+    }
+
+    return 0;
+fail:
+    tq_free(&ist->dec_queue_in);
+    tq_free(&ist->dec_queue_out);
+    return ret;
+}
+
+void dec_thread_stop(InputStream *ist)
+{
+    if (!ist->dec_queue_in)
+        return;
+
+    tq_send_finish(ist->dec_queue_in, 0);
+    tq_receive_finish(ist->dec_queue_out, 0);
+
+    pthread_join(ist->dec_thread, NULL);
+
+    tq_free(&ist->dec_queue_in);
+    tq_free(&ist->dec_queue_out);
+    av_packet_free(&ist->dec_thread_pkt);
+    av_packet_free(&ist->dec_thread_deferred_pkt);
+}
+
+int dec_thread_send_packet(InputStream *ist, const AVPacket *pkt)
+{
+    int ret;
+
+    /* an empty packet is sent as it is, so that it still means draining */
+    if (pkt->data || pkt->side_data_elems) {
+        ret = av_packet_ref(ist->dec_thread_pkt, pkt);
+        if (ret < 0)
+            return ret;
+    }
+
+    ret = tq_send(ist->dec_queue_in, 0, ist->dec_thread_pkt);
+    if (ret < 0) {
+        av_packet_unref(ist->dec_thread_pkt);
+        /* the input is only finished from the receiving side when the thread
+         * terminated */
+        if (ret == AVERROR_EOF && ist->dec_thread_err < 0)
+            ret = ist->dec_thread_err;
+        return ret;
+    }
+
+    ist->dec_thread_pending = 1;
+
+    return 0;
+}
+
+int dec_thread_receive_frame(InputStream *ist, AVFrame *frame)
+{
+    int ret, idx;
+
+    av_assert0(ist->dec_thread_pending);
+
+    ret = tq_receive(ist->dec_queue_out, &idx, frame);
+    if (ret < 0) {
+        ist->dec_thread_pending = 0;
+        return ist->dec_thread_err < 0 ? ist->dec_thread_err : AVERROR_BUG;
+    }
+
+    if (!frame->buf[0]) {
+        ist->dec_thread_pending = 0;
+        ret = (int)(intptr_t)frame->opaque;
+        frame->opaque = NULL;
+        return ret;
+    }
+
+    return 0;
+}
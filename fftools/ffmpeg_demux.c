@@ -52,6 +52,14 @@ static const char *const opt_name_display_rotations[]         = {"display_rotati
 static const char *const opt_name_display_hflips[]            = {"display_hflip", NULL};
 static const char *const opt_name_display_vflips[]            = {"display_vflip", NULL};
 
+typedef struct DemuxMsg {
+    AVPacket *pkt;
+    int looping;
+
+    // repeat_pict from the demuxer-internal parser
+    int repeat_pict;
+} DemuxMsg;
+
 typedef struct Demuxer {
     InputFile f;
 
@@ -70,15 +78,13 @@ typedef struct Demuxer {
     int                   thread_queue_size;
     pthread_t             thread;
     int                   non_blocking;
-} Demuxer;
 
-typedef struct DemuxMsg {
-    AVPacket *pkt;
-    int looping;
-
-    // repeat_pict from the demuxer-internal parser
-    int repeat_pict;
-} DemuxMsg;
+    /* messages received from the demuxing thread in one batch, of which
+     * recv_msgs[recv_msg_idx..nb_recv_msgs-1] are still to be returned */
+    DemuxMsg             recv_msgs[8];
+    int                  nb_recv_msgs;
+    int                  recv_msg_idx;
+} Demuxer;
 
 static Demuxer *demuxer_from_ifile(InputFile *f)
 {
@@ -252,6 +258,7 @@ static void *input_thread(void *arg)
 
     while (1) {
         DemuxMsg msg = { NULL };
+        int64_t start = av_gettime_relative();
 
         ret = av_read_frame(f->ctx, pkt);
 
@@ -307,6 +314,9 @@ static void *input_thread(void *arg)
 
         ts_fixup(d, pkt, &msg.repeat_pict);
 
+        stage_stats_add_busy(&f->demux_stats, start);
+        stage_stats_add_output(&f->demux_stats, NULL);
+
         msg.pkt = av_packet_alloc();
         if (!msg.pkt) {
             av_packet_unref(pkt);
@@ -351,6 +361,9 @@ static void thread_stop(Demuxer *d)
 
     if (!d->in_thread_queue)
         return;
+    for (; d->recv_msg_idx < d->nb_recv_msgs; d->recv_msg_idx++)
+        av_packet_free(&d->recv_msgs[d->recv_msg_idx].pkt);
+
     av_thread_message_queue_set_err_send(d->in_thread_queue, AVERROR_EOF);
     while (av_thread_message_queue_recv(d->in_thread_queue, &msg, 0) >= 0)
         av_packet_free(&msg.pkt);
@@ -372,8 +385,10 @@ static int thread_start(Demuxer *d)
         (f->ctx->pb ? !f->ctx->pb->seekable :
          strcmp(f->ctx->iformat->name, "lavfi")))
         d->non_blocking = 1;
-    ret = av_thread_message_queue_alloc(&d->in_thread_queue,
-                                        d->thread_queue_size, sizeof(DemuxMsg));
+    /* only this thread receives the packets sent by the demuxing thread */
+    ret = av_thread_message_queue_alloc2(&d->in_thread_queue,
+                                         d->thread_queue_size, sizeof(DemuxMsg),
+                                         AV_THREAD_MESSAGE_QUEUE_SPSC);
     if (ret < 0)
         return ret;
 
@@ -407,6 +422,15 @@ fail:
     return ret;
 }
 
+void ifile_queue_occupancy(InputFile *f, size_t *nb_queued, size_t *queue_size)
+{
+    Demuxer *d = demuxer_from_ifile(f);
+
+    *nb_queued  = d->in_thread_queue ? av_thread_message_queue_nb_elems(d->in_thread_queue) : 0;
+    *nb_queued += d->nb_recv_msgs - d->recv_msg_idx;
+    *queue_size = d->thread_queue_size;
+}
+
 int ifile_get_packet(InputFile *f, AVPacket **pkt)
 {
     Demuxer *d = demuxer_from_ifile(f);
@@ -439,11 +463,17 @@ int ifile_get_packet(InputFile *f, AVPacket **pkt)
         }
     }
 
-    ret = av_thread_message_queue_recv(d->in_thread_queue, &msg,
-                                       d->non_blocking ?
-                                       AV_THREAD_MESSAGE_NONBLOCK : 0);
-    if (ret < 0)
-        return ret;
+    if (d->recv_msg_idx == d->nb_recv_msgs) {
+        ret = av_thread_message_queue_recv_batch(d->in_thread_queue, d->recv_msgs,
+                                                 FF_ARRAY_ELEMS(d->recv_msgs),
+                                                 d->non_blocking ?
+                                                 AV_THREAD_MESSAGE_NONBLOCK : 0);
+        if (ret < 0)
+            return ret;
+        d->nb_recv_msgs = ret;
+        d->recv_msg_idx = 0;
+    }
+    msg = d->recv_msgs[d->recv_msg_idx++];
     if (msg.looping)
         return 1;
 
@@ -0,0 +1,299 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "ffmpeg.h"
+#include "objpool.h"
+#include "thread_queue.h"
+
+#include "libavutil/error.h"
+#include "libavutil/frame.h"
+#include "libavutil/thread.h"
+#include "libavutil/time.h"
+
+#include "libavcodec/avcodec.h"
+#include "libavcodec/packet.h"
+
+/* number of frames that can be queued for encoding, and of packets that can
+ * be queued for muxing, before sending blocks */
+#define ENC_QUEUE_SIZE 8
+
+int enc_thread_running(const OutputStream *ost)
+{
+    return !!ost->enc_queue_in;
+}
+
+static void thread_set_name(OutputStream *ost)
+{
+    char name[16];
+    snprintf(name, sizeof(name), "enc%d:%d", ost->file_index, ost->index);
+    ff_thread_setname(name);
+}
+
+static void signal_progress(OutputStream *ost)
+{
+    pthread_mutex_lock(&ost->enc_progress_lock);
+    ost->enc_progress++;
+    pthread_cond_signal(&ost->enc_progress_cond);
+    pthread_mutex_unlock(&ost->enc_progress_lock);
+}
+
+static void *encoder_thread(void *arg)
+{
+    OutputStream   *ost = arg;
+    AVCodecContext *enc = ost->enc_ctx;
+    const char *type_desc = av_get_media_type_string(enc->codec_type);
+    AVFrame      *frame = NULL;
+    AVPacket       *pkt = NULL;
+    int             ret = 0;
+
+    frame = av_frame_alloc();
+    pkt   = av_packet_alloc();
+    if (!frame || !pkt) {
+        ret = AVERROR(ENOMEM);
+        goto finish;
+    }
+
+    thread_set_name(ost);
+
+    while (1) {
+        int64_t start;
+        int flush, idx;
+
+        ret = tq_receive(ost->enc_queue_in, &idx, frame);
+        if (ret < 0) {
+            ret = 0;
+            break;
+        }
+        signal_progress(ost);
+
+        start = av_gettime_relative();
+
+        /* a frame without data requests flushing the encoder */
+        flush = !frame->buf[0];
+
+        /* done here rather than in the main thread, as the encoder may be
+         * reading the codec context concurrently */
+        if (!flush && enc->codec_type == AVMEDIA_TYPE_VIDEO &&
+            !ost->frame_aspect_ratio.num)
+            enc->sample_aspect_ratio = frame->sample_aspect_ratio;
+
+        ret = avcodec_send_frame(enc, flush ? NULL : frame);
+        av_frame_unref(frame);
+        if (ret < 0 && !(ret == AVERROR_EOF && flush)) {
+            av_log(NULL, AV_LOG_ERROR, "Error submitting %s frame to the encoder\n",
+                   type_desc);
+            break;
+        }
+
+        while (1) {
+            ret = avcodec_receive_packet(enc, pkt);
+            stage_stats_add_busy(&ost->enc_stats, start);
+
+            /* if two pass, output log on success and EOF */
+            if ((ret >= 0 || ret == AVERROR_EOF) && ost->logfile && enc->stats_out)
+                fprintf(ost->logfile, "%s", enc->stats_out);
+
+            if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF)
+                break;
+            if (ret < 0) {
+                av_log(NULL, AV_LOG_ERROR, "%s encoding failed\n", type_desc);
+                goto finish;
+            }
+
+            ret = tq_send(ost->enc_queue_out, 0, pkt);
+            if (ret < 0) {
+                av_packet_unref(pkt);
+                /* the main thread does not want any more packets */
+                if (ret == AVERROR_EOF)
+                    break;
+                goto finish;
+            }
+            signal_progress(ost);
+            start = av_gettime_relative();
+        }
+
+        if (ret == AVERROR_EOF)
+            tq_send_finish(ost->enc_queue_out, 0);
+    }
+
+finish:
+    if (ret < 0 && ret != AVERROR_EOF)
+        ost->enc_thread_err = ret;
+
+    tq_receive_finish(ost->enc_queue_in, 0);
+    tq_send_finish(ost->enc_queue_out, 0);
+    signal_progress(ost);
+
+    av_packet_free(&pkt);
+    av_frame_free(&frame);
+
+    av_log(NULL, AV_LOG_VERBOSE, "Terminating encoder thread %d:%d\n",
+           ost->file_index, ost->index);
+
+    return NULL;
+}
+
+static void frame_move(void *dst, void *src)
+{
+    av_frame_move_ref(dst, src);
+}
+
+static void pkt_move(void *dst, void *src)
+{
+    av_packet_move_ref(dst, src);
+}
+
+int enc_thread_start(OutputStream *ost)
+{
+    ObjPool *op;
+    int ret;
+
+    if (ost->enc_queue_in)
+        return 0;
+
+    if (!ost->enc_thread_frame) {
+        ost->enc_thread_frame = av_frame_alloc();
+        if (!ost->enc_thread_frame)
+            return AVERROR(ENOMEM);
+    }
+
+    op = objpool_alloc_frames();
+    if (!op)
+        return AVERROR(ENOMEM);
+
+    ost->enc_queue_in = tq_alloc(1, ENC_QUEUE_SIZE, op, frame_move);
+    if (!ost->enc_queue_in) {
+        objpool_free(&op);
+        return AVERROR(ENOMEM);
+    }
+
+    op = objpool_alloc_packets();
+    if (!op) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+
+    /* the main thread does not block on sending frames, but waits for the
+     * encoder while receiving its packets, so the encoder may block on sending
+     * packets back */
+    ost->enc_queue_out = tq_alloc(1, ENC_QUEUE_SIZE, op, pkt_move);
+    if (!ost->enc_queue_out) {
+        objpool_free(&op);
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+
+    ost->enc_thread_err = 0;
+    ost->enc_progress   = 0;
+
+    ret = pthread_mutex_init(&ost->enc_progress_lock, NULL);
+    if (ret) {
+        ret = AVERROR(ret);
+        goto fail;
+    }
+    ret = pthread_cond_init(&ost->enc_progress_cond, NULL);
+    if (ret) {
+        pthread_mutex_destroy(&ost->enc_progress_lock);
+        ret = AVERROR(ret);
+        goto fail;
+    }
+
+    ret = pthread_create(&ost->enc_thread, NULL, encoder_thread, ost);
+    if (ret) {
+        pthread_cond_destroy(&ost->enc_progress_cond);
+        pthread_mutex_destroy(&ost->enc_progress_lock);
+        ret = AVERROR(ret);
+        goto fail;
+    }
+
+    return 0;
+fail:
+    tq_free(&ost->enc_queue_in);
+    tq_free(&ost->enc_queue_out);
+    return ret;
+}
+
+void enc_thread_stop(OutputStream *ost)
+{
+    if (!ost->enc_queue_in)
+        return;
+
+    tq_send_finish(ost->enc_queue_in, 0);
+    tq_receive_finish(ost->enc_queue_out, 0);
+
+    pthread_join(ost->enc_thread, NULL);
+
+    pthread_cond_destroy(&ost->enc_progress_cond);
+    pthread_mutex_destroy(&ost->enc_progress_lock);
+    tq_free(&ost->enc_queue_in);
+    tq_free(&ost->enc_queue_out);
+    av_frame_free(&ost->enc_thread_frame);
+}
+
+int enc_thread_send_frame(OutputStream *ost, AVFrame *frame)
+{
+    unsigned progress;
+    int ret;
+
+    if (frame) {
+        ret = av_frame_ref(ost->enc_thread_frame, frame);
+        if (ret < 0)
+            return ret;
+    }
+
+    /* read before trying, so that progress made in between is not missed */
+    pthread_mutex_lock(&ost->enc_progress_lock);
+    progress = ost->enc_progress;
+    pthread_mutex_unlock(&ost->enc_progress_lock);
+
+    ret = tq_send_nonblock(ost->enc_queue_in, 0, ost->enc_thread_frame);
+    if (ret == AVERROR(EAGAIN))
+        ost->enc_wait_progress = progress;
+    if (ret < 0) {
+        av_frame_unref(ost->enc_thread_frame);
+        /* the input is only finished from the receiving side when the thread
+         * terminated */
+        if (ret == AVERROR_EOF && ost->enc_thread_err < 0)
+            ret = ost->enc_thread_err;
+    }
+
+    return ret;
+}
+
+void enc_thread_wait(OutputStream *ost)
+{
+    pthread_mutex_lock(&ost->enc_progress_lock);
+    while (ost->enc_progress == ost->enc_wait_progress)
+        pthread_cond_wait(&ost->enc_progress_cond, &ost->enc_progress_lock);
+    pthread_mutex_unlock(&ost->enc_progress_lock);
+}
+
+int enc_thread_receive_packet(OutputStream *ost, AVPacket *pkt, int block)
+{
+    int ret, idx;
+
+    ret = block ? tq_receive(ost->enc_queue_out, &idx, pkt) :
+                  tq_receive_nonblock(ost->enc_queue_out, &idx, pkt);
+    if (ret == AVERROR_EOF && ost->enc_thread_err < 0)
+        ret = ost->enc_thread_err;
+
+    return ret;
+}
@@ -21,6 +21,8 @@
 #include <stdint.h>
 
 #include "ffmpeg.h"
+#include "objpool.h"
+#include "thread_queue.h"
 
 #include "libavfilter/avfilter.h"
 #include "libavfilter/buffersink.h"
@@ -36,6 +38,10 @@
 #include "libavutil/pixfmt.h"
 #include "libavutil/imgutils.h"
 #include "libavutil/samplefmt.h"
+#include "libavutil/thread.h"
+#include "libavutil/time.h"
+
+#define FG_QUEUE_SIZE 8
 
 // FIXME: YUV420P etc. are actually supported with full color range,
 // yet the latter information isn't available here.
@@ -187,6 +193,7 @@ int init_simple_filtergraph(InputStream *ist, OutputStream *ost)
     fg->index = nb_filtergraphs;
 
     ofilter = ALLOC_ARRAY_ELEM(fg->outputs, fg->nb_outputs);
+    ofilter->index  = fg->nb_outputs - 1;
     ofilter->ost    = ost;
     ofilter->graph  = fg;
     ofilter->format = -1;
@@ -194,6 +201,7 @@ int init_simple_filtergraph(InputStream *ist, OutputStream *ost)
     ost->filter = ofilter;
 
     ifilter = ALLOC_ARRAY_ELEM(fg->inputs, fg->nb_inputs);
+    ifilter->index  = fg->nb_inputs - 1;
     ifilter->ist    = ist;
     ifilter->graph  = fg;
     ifilter->format = -1;
@@ -301,6 +309,7 @@ static void init_input_filter(FilterGraph *fg, AVFilterInOut *in)
     ist->st->discard = AVDISCARD_NONE;
 
     ifilter = ALLOC_ARRAY_ELEM(fg->inputs, fg->nb_inputs);
+    ifilter->index  = fg->nb_inputs - 1;
     ifilter->ist    = ist;
     ifilter->graph  = fg;
     ifilter->format = -1;
@@ -338,6 +347,7 @@ int init_complex_filtergraph(FilterGraph *fg)
     for (cur = outputs; cur;) {
         OutputFilter *const ofilter = ALLOC_ARRAY_ELEM(fg->outputs, fg->nb_outputs);
 
+        ofilter->index   = fg->nb_outputs - 1;
         ofilter->graph   = fg;
         ofilter->out_tmp = cur;
         ofilter->type    = avfilter_pad_get_type(cur->filter_ctx->output_pads,
@@ -972,6 +982,11 @@ int configure_filtergraph(FilterGraph *fg)
     if (!(fg->graph = avfilter_graph_alloc()))
         return AVERROR(ENOMEM);
 
+    if (filter_frame_threads)
+        fg->graph->thread_type |= AVFILTER_THREAD_FRAME;
+    fg->graph->profile = filter_profile;
+    fg->graph->executor = executor;
+
     if (simple) {
         OutputStream *ost = fg->outputs[0]->ost;
         char args[512];
@@ -1165,3 +1180,401 @@ int filtergraph_is_simple(FilterGraph *fg)
 {
     return !fg->graph_desc;
 }
+
+static int fg_thread_eligible(const FilterGraph *fg)
+{
+    if (!filtergraph_threads)
+        return 0;
+
+    /* sub2video pushes frames into the graph from the main thread */
+    for (int i = 0; i < fg->nb_inputs; i++)
+        if (fg->inputs[i]->ist->par->codec_type == AVMEDIA_TYPE_SUBTITLE)
+            return 0;
+
+    return 1;
+}
+
+int fg_thread_running(const FilterGraph *fg)
+{
+    return !!fg->queue_in;
+}
+
+static void thread_set_name(FilterGraph *fg)
+{
+    char name[16];
+    snprintf(name, sizeof(name), "filter%d", fg->index);
+    ff_thread_setname(name);
+}
+
+static void signal_progress(FilterGraph *fg)
+{
+    pthread_mutex_lock(&fg->progress_lock);
+    fg->progress++;
+    pthread_cond_signal(&fg->progress_cond);
+    pthread_mutex_unlock(&fg->progress_lock);
+}
+
+/* Send all frames currently available in the buffersinks to the main thread.
+ * A frame without data signals EOF on the corresponding output. */
+static int filter_thread_reap(FilterGraph *fg, AVFrame *frame, uint8_t *out_eof,
+                              int *nb_out_eof)
+{
+    for (int i = 0; i < fg->nb_outputs; i++) {
+        AVFilterContext *sink = fg->outputs[i]->filter;
+        int ret;
+
+        while (!out_eof[i]) {
+            ret = av_buffersink_get_frame_flags(sink, frame,
+                                                AV_BUFFERSINK_FLAG_NO_REQUEST);
+            if (ret == AVERROR(EAGAIN))
+                break;
+            if (ret < 0 && ret != AVERROR_EOF) {
+                av_log(NULL, AV_LOG_WARNING,
+                       "Error in av_buffersink_get_frame_flags(): %s\n", av_err2str(ret));
+                break;
+            }
+            out_eof[i] = ret == AVERROR_EOF;
+
+            ret = tq_send(fg->queue_out, i, frame);
+            if (ret < 0) {
+                av_frame_unref(frame);
+                /* the main thread closed this output */
+                if (ret != AVERROR_EOF)
+                    return ret;
+                out_eof[i] = 1;
+            } else
+                signal_progress(fg);
+            *nb_out_eof += out_eof[i];
+        }
+    }
+
+    return 0;
+}
+
+/* Keep requesting output from the graph until it needs more input, or until
+ * one of its outputs is finished or closed, as requesting from the oldest
+ * output could then keep producing frames nobody wants. */
+static int filter_thread_pump(FilterGraph *fg, AVFrame *frame, uint8_t *out_eof,
+                              int *nb_out_eof)
+{
+    while (!*nb_out_eof) {
+        int ret = avfilter_graph_request_oldest(fg->graph);
+        int err = filter_thread_reap(fg, frame, out_eof, nb_out_eof);
+        if (err < 0)
+            return err;
+        if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF)
+            return 0;
+        if (ret < 0)
+            return ret;
+    }
+
+    return 0;
+}
+
+static void *filter_thread(void *arg)
+{
+    FilterGraph *fg = arg;
+    AVFrame  *frame = NULL;
+    uint8_t *out_eof = NULL;
+    int   nb_out_eof = 0;
+    int          ret = 0;
+
+    frame   = av_frame_alloc();
+    out_eof = av_calloc(fg->nb_outputs, sizeof(*out_eof));
+    if (!frame || !out_eof) {
+        ret = AVERROR(ENOMEM);
+        goto finish;
+    }
+
+    thread_set_name(fg);
+
+    while (1) {
+        int64_t start;
+        int idx;
+
+        ret = tq_receive(fg->queue_in, &idx, frame);
+        if (idx < 0) {
+            ret = 0;
+            break;
+        }
+        signal_progress(fg);
+        /* individual inputs are only finished when stopping the thread */
+        if (ret < 0)
+            continue;
+
+        start = av_gettime_relative();
+
+        /* nothing is wanted from the graph anymore, only reply to control
+         * messages */
+        if (nb_out_eof == fg->nb_outputs) {
+            if (idx - fg->nb_inputs == FG_CONTROL_REQUEST)
+                fg->request_ret = AVERROR_EOF;
+        } else if (idx < fg->nb_inputs) {
+            AVFilterContext *src = fg->inputs[idx]->filter;
+
+            if (frame->buf[0])
+                ret = av_buffersrc_add_frame_flags(src, frame, AV_BUFFERSRC_FLAG_PUSH);
+            else
+                ret = av_buffersrc_close(src, frame->pts, AV_BUFFERSRC_FLAG_PUSH);
+            /* a finished input only discards its frames */
+            if (ret < 0 && ret != AVERROR_EOF) {
+                av_log(NULL, AV_LOG_ERROR, "Error while filtering: %s\n", av_err2str(ret));
+                av_frame_unref(frame);
+                break;
+            }
+        } else if (idx - fg->nb_inputs == FG_CONTROL_REQUEST)
+            fg->request_ret = avfilter_graph_request_oldest(fg->graph);
+        av_frame_unref(frame);
+
+        /* the main thread does not send requests to graphs with a single
+         * input while that input is live, see transcode_from_filter() */
+        if (idx < fg->nb_inputs && fg->nb_inputs == 1)
+            ret = filter_thread_pump(fg, frame, out_eof, &nb_out_eof);
+        else
+            ret = filter_thread_reap(fg, frame, out_eof, &nb_out_eof);
+        stage_stats_add_busy(&fg->stats, start);
+        if (ret < 0)
+            break;
+
+        if (idx >= fg->nb_inputs) {
+            ret = tq_send(fg->queue_out, fg->nb_outputs, frame);
+            if (ret < 0)
+                break;
+            signal_progress(fg);
+        }
+    }
+
+finish:
+    if (ret < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Error in the filtering thread for "
+               "filtergraph #%d: %s\n", fg->index, av_err2str(ret));
+        fg->thread_err = ret;
+    }
+
+    for (int i = 0; i < fg->nb_inputs + FG_CONTROL_NB; i++)
+        tq_receive_finish(fg->queue_in, i);
+    for (int i = 0; i <= fg->nb_outputs; i++)
+        tq_send_finish(fg->queue_out, i);
+    signal_progress(fg);
+
+    av_freep(&out_eof);
+    av_frame_free(&frame);
+
+    av_log(NULL, AV_LOG_VERBOSE, "Terminating filtering thread %d\n", fg->index);
+
+    return NULL;
+}
+
+static void frame_move(void *dst, void *src)
+{
+    av_frame_move_ref(dst, src);
+}
+
+int fg_thread_start(FilterGraph *fg)
+{
+    ObjPool *op;
+    int ret;
+
+    if (fg->queue_in || !fg_thread_eligible(fg))
+        return 0;
+
+    if (!fg->thread_frame) {
+        fg->thread_frame = av_frame_alloc();
+        if (!fg->thread_frame)
+            return AVERROR(ENOMEM);
+    }
+
+    op = objpool_alloc_frames();
+    if (!op)
+        return AVERROR(ENOMEM);
+
+    fg->queue_in = tq_alloc(fg->nb_inputs + FG_CONTROL_NB, FG_QUEUE_SIZE, op, frame_move);
+    if (!fg->queue_in) {
+        objpool_free(&op);
+        return AVERROR(ENOMEM);
+    }
+
+    op = objpool_alloc_frames();
+    if (!op) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+
+    /* the main thread does not block on sending input, but waits for the
+     * thread while receiving its output, so the thread may block on sending
+     * frames back */
+    fg->queue_out = tq_alloc(fg->nb_outputs + 1, FG_QUEUE_SIZE, op, frame_move);
+    if (!fg->queue_out) {
+        objpool_free(&op);
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+
+    fg->thread_err = 0;
+    fg->progress   = 0;
+
+    ret = pthread_mutex_init(&fg->progress_lock, NULL);
+    if (ret) {
+        ret = AVERROR(ret);
+        goto fail;
+    }
+    ret = pthread_cond_init(&fg->progress_cond, NULL);
+    if (ret) {
+        pthread_mutex_destroy(&fg->progress_lock);
+        ret = AVERROR(ret);
+        goto fail;
+    }
+
+    ret = pthread_create(&fg->thread, NULL, filter_thread, fg);
+    if (ret) {
+        pthread_cond_destroy(&fg->progress_cond);
+        pthread_mutex_destroy(&fg->progress_lock);
+        ret = AVERROR(ret);
+        goto fail;
+    }
+
+    return 0;
+fail:
+    tq_free(&fg->queue_in);
+    tq_free(&fg->queue_out);
+    return ret;
+}
+
+void fg_thread_stop(FilterGraph *fg)
+{
+    if (!fg->queue_in)
+        return;
+
+    for (int i = 0; i < fg->nb_inputs + FG_CONTROL_NB; i++)
+        tq_send_finish(fg->queue_in, i);
+    /* the thread may be blocked on sending frames nobody will receive */
+    for (int i = 0; i <= fg->nb_outputs; i++)
+        tq_receive_finish(fg->queue_out, i);
+
+    pthread_join(fg->thread, NULL);
+
+    pthread_cond_destroy(&fg->progress_cond);
+    pthread_mutex_destroy(&fg->progress_lock);
+    tq_free(&fg->queue_in);
+    tq_free(&fg->queue_out);
+}
+
+void fg_print_profile(FilterGraph *fg)
+{
+    const AVFilterPoolStats *pool;
+    int64_t total = 0;
+
+    if (!fg->graph || !fg->graph->profile)
+        return;
+
+    for (int i = 0; i < fg->graph->nb_filters; i++)
+        total += avfilter_get_profile(fg->graph->filters[i])->time;
+
+    av_log(NULL, AV_LOG_INFO, "Filter profile of graph %d:\n", fg->index);
+    av_log(NULL, AV_LOG_INFO, "%-24s %-12s %10s %10s %6s %10s %10s %10s %12s %8s %12s\n",
+           "filter", "type", "calls", "time [s]", "%", "blocked", "frames in",
+           "frames out", "alloc [KiB]", "copies", "copied [KiB]");
+    for (int i = 0; i < fg->graph->nb_filters; i++) {
+        AVFilterContext *f = fg->graph->filters[i];
+        const AVFilterProfile *p = avfilter_get_profile(f);
+
+        av_log(NULL, AV_LOG_INFO, "%-24s %-12s %10"PRId64" %10.3f %6.1f %10.3f %10"PRId64" %10"PRId64" %12"PRId64" %8"PRId64" %12"PRId64"\n",
+               f->name, f->filter->name, p->nb_calls, p->time / 1000000.,
+               total ? 100. * p->time / total : 0., p->time_blocked / 1000000.,
+               p->frames_in, p->frames_out, p->bytes_alloc >> 10,
+               p->nb_copies, p->bytes_copied >> 10);
+    }
+
+    pool = avfilter_graph_get_pool_stats(fg->graph);
+    av_log(NULL, AV_LOG_INFO, "Frame buffers: %"PRId64" reused, %"PRId64" allocated, "
+           "%"PRId64" trimmed, peak %"PRId64" KiB\n",
+           pool->hits, pool->misses, pool->trimmed, pool->peak_size >> 10);
+}
+
+static int fg_thread_send(FilterGraph *fg, unsigned int idx, AVFrame *frame)
+{
+    unsigned progress;
+    int ret;
+
+    /* read before trying, so that progress made in between is not missed */
+    pthread_mutex_lock(&fg->progress_lock);
+    progress = fg->progress;
+    pthread_mutex_unlock(&fg->progress_lock);
+
+    ret = tq_send_nonblock(fg->queue_in, idx, frame);
+    if (ret == AVERROR(EAGAIN))
+        fg->wait_progress = progress;
+    /* the queue is only finished from the receiving side when the thread
+     * terminated on an error */
+    return ret == AVERROR_EOF ? fg->thread_err : ret;
+}
+
+int fg_thread_send_frame(InputFilter *ifilter, AVFrame *frame, int keep_reference)
+{
+    FilterGraph *fg = ifilter->graph;
+    int ret;
+
+    if (keep_reference) {
+        ret = av_frame_ref(fg->thread_frame, frame);
+        if (ret < 0)
+            return ret;
+        frame = fg->thread_frame;
+    }
+
+    ret = fg_thread_send(fg, ifilter->index, frame);
+    if (ret < 0 && keep_reference)
+        av_frame_unref(fg->thread_frame);
+
+    return ret;
+}
+
+int fg_thread_send_eof(InputFilter *ifilter, int64_t pts)
+{
+    FilterGraph *fg = ifilter->graph;
+
+    av_frame_unref(fg->thread_frame);
+    fg->thread_frame->pts = pts;
+
+    return fg_thread_send(fg, ifilter->index, fg->thread_frame);
+}
+
+int fg_thread_send_control(FilterGraph *fg, enum FilterGraphControl ctl)
+{
+    av_frame_unref(fg->thread_frame);
+    return fg_thread_send(fg, fg->nb_inputs + ctl, fg->thread_frame);
+}
+
+void fg_thread_wait(FilterGraph *fg)
+{
+    pthread_mutex_lock(&fg->progress_lock);
+    while (fg->progress == fg->wait_progress)
+        pthread_cond_wait(&fg->progress_cond, &fg->progress_lock);
+    pthread_mutex_unlock(&fg->progress_lock);
+}
+
+void fg_thread_close_output(FilterGraph *fg, int output_idx)
+{
+    tq_receive_finish(fg->queue_out, output_idx);
+}
+
+int fg_thread_receive(FilterGraph *fg, int *output_idx, AVFrame *frame, int block)
+{
+    int ret;
+
+    ret = block ? tq_receive(fg->queue_out, output_idx, frame) :
+                  tq_receive_nonblock(fg->queue_out, output_idx, frame);
+    if (ret == AVERROR(EAGAIN))
+        return ret;
+
+    if (ret < 0) {
+        /* the thread terminated, finishing all its outputs */
+        if (*output_idx >= 0 && *output_idx < fg->nb_outputs)
+            return AVERROR_EOF;
+        return fg->thread_err < 0 ? fg->thread_err : AVERROR_BUG;
+    }
+
+    if (*output_idx < fg->nb_outputs && !frame->buf[0])
+        return AVERROR_EOF;
+
+    return 0;
+}
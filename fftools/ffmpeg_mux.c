@@ -30,6 +30,7 @@
 #include "libavutil/intreadwrite.h"
 #include "libavutil/log.h"
 #include "libavutil/mem.h"
+#include "libavutil/time.h"
 #include "libavutil/timestamp.h"
 #include "libavutil/thread.h"
 
@@ -128,6 +129,7 @@ static int write_packet(Muxer *mux, OutputStream *ost, AVPacket *pkt)
 
     ost->data_size_mux += pkt->size;
     atomic_fetch_add(&ost->packets_written, 1);
+    stage_stats_add_output(&mux->of.mux_stats, NULL);
 
     pkt->stream_index = ost->index;
 
@@ -203,6 +205,7 @@ static void *muxer_thread(void *arg)
 
     while (1) {
         OutputStream *ost;
+        int64_t start;
         int stream_idx;
 
         ret = tq_receive(mux->tq, &stream_idx, pkt);
@@ -213,8 +216,11 @@ static void *muxer_thread(void *arg)
             break;
         }
 
+        start = av_gettime_relative();
+
         ost = of->streams[stream_idx];
         ret = sync_queue_process(mux, ost, ret < 0 ? NULL : pkt);
+        stage_stats_add_busy(&of->mux_stats, start);
         av_packet_unref(pkt);
         if (ret == AVERROR_EOF)
             tq_receive_finish(mux->tq, stream_idx);
@@ -644,6 +650,8 @@ static void ost_free(OutputStream **post)
         return;
     ms = ms_from_ost(ost);
 
+    enc_thread_stop(ost);
+
     if (ost->logfile) {
         if (fclose(ost->logfile))
             av_log(NULL, AV_LOG_ERROR,
@@ -731,6 +739,16 @@ void of_close(OutputFile **pof)
     av_freep(pof);
 }
 
+void of_queue_occupancy(OutputFile *of, size_t *nb_queued, size_t *queue_size)
+{
+    Muxer *mux = mux_from_of(of);
+
+    if (mux->tq)
+        tq_occupancy(mux->tq, nb_queued, queue_size);
+    else
+        *nb_queued = *queue_size = 0;
+}
+
 int64_t of_filesize(OutputFile *of)
 {
     Muxer *mux = mux_from_of(of);
@@ -45,6 +45,7 @@
 #include "libavutil/bprint.h"
 #include "libavutil/channel_layout.h"
 #include "libavutil/display.h"
+#include "libavutil/executor.h"
 #include "libavutil/intreadwrite.h"
 #include "libavutil/fifo.h"
 #include "libavutil/mathematics.h"
@@ -85,6 +86,12 @@ int stdin_interaction = 1;
 float max_error_rate  = 2.0/3;
 char *filter_nbthreads;
 int filter_complex_nbthreads = 0;
+int filtergraph_threads = 0;
+int filter_frame_threads = 0;
+int filter_profile = 0;
+int encoder_threads = 0;
+int decoder_threads = 0;
+AVExecutor *executor;
 int vstats_version = 2;
 int auto_conversion_filters = 1;
 int64_t stats_period = 500000;
@@ -298,6 +305,19 @@ static int opt_filter_threads(void *optctx, const char *opt, const char *arg)
     return 0;
 }
 
+static int opt_executor_threads(void *optctx, const char *opt, const char *arg)
+{
+    int nb_threads = parse_number_or_die(opt, arg, OPT_INT, 0, INT_MAX);
+
+    av_executor_free(&executor);
+    executor = av_executor_alloc(nb_threads);
+    if (!executor) {
+        av_log(NULL, AV_LOG_FATAL, "Could not create the shared thread pool\n");
+        return AVERROR(ENOSYS);
+    }
+    return 0;
+}
+
 static int opt_abort_on(void *optctx, const char *opt, const char *arg)
 {
     static const AVOption opts[] = {
@@ -1313,7 +1333,7 @@ fail:
     return ret;
 }
 
-static int opt_progress(void *optctx, const char *opt, const char *arg)
+static int open_report_url(AVIOContext **pavio, const char *desc, const char *arg)
 {
     AVIOContext *avio = NULL;
     int ret;
@@ -1322,14 +1342,25 @@ static int opt_progress(void *optctx, const char *opt, const char *arg)
         arg = "pipe:";
     ret = avio_open2(&avio, arg, AVIO_FLAG_WRITE, &int_cb, NULL);
     if (ret < 0) {
-        av_log(NULL, AV_LOG_ERROR, "Failed to open progress URL \"%s\": %s\n",
-               arg, av_err2str(ret));
+        av_log(NULL, AV_LOG_ERROR, "Failed to open %s URL \"%s\": %s\n",
+               desc, arg, av_err2str(ret));
         return ret;
     }
-    progress_avio = avio;
+    avio_closep(pavio);
+    *pavio = avio;
     return 0;
 }
 
+static int opt_progress(void *optctx, const char *opt, const char *arg)
+{
+    return open_report_url(&progress_avio, "progress", arg);
+}
+
+static int opt_stage_stats(void *optctx, const char *opt, const char *arg)
+{
+    return open_report_url(&stage_stats_avio, "stage statistics", arg);
+}
+
 int opt_timelimit(void *optctx, const char *opt, const char *arg)
 {
 #if HAVE_SETRLIMIT
@@ -1428,6 +1459,8 @@ const OptionDef options[] = {
       "add timings for each task" },
     { "progress",       HAS_ARG | OPT_EXPERT,                        { .func_arg = opt_progress },
       "write program-readable progress information", "url" },
+    { "stage_stats",    HAS_ARG | OPT_EXPERT,                        { .func_arg = opt_stage_stats },
+      "write per-stage pipeline statistics as JSON lines", "url" },
     { "stdin",          OPT_BOOL | OPT_EXPERT,                       { &stdin_interaction },
       "enable or disable interaction on standard input" },
     { "timelimit",      HAS_ARG | OPT_EXPERT,                        { .func_arg = opt_timelimit },
@@ -1512,10 +1545,16 @@ const OptionDef options[] = {
         "read complex filtergraph description from a file", "filename" },
     { "auto_conversion_filters", OPT_BOOL | OPT_EXPERT,              { &auto_conversion_filters },
         "enable automatic conversion filters globally" },
+    { "filtergraph_threads", OPT_BOOL | OPT_EXPERT,                  { &filtergraph_threads },
+        "run each filtergraph in a separate thread" },
+    { "filter_frame_threads", OPT_BOOL | OPT_EXPERT,                 { &filter_frame_threads },
+        "run the frames of supporting filters in parallel" },
+    { "filter_profile", OPT_BOOL | OPT_EXPERT,                       { &filter_profile },
+        "print the processing statistics of every filter at exit" },
     { "stats",          OPT_BOOL,                                    { &print_stats },
         "print progress report during encoding", },
     { "stats_period",    HAS_ARG | OPT_EXPERT,                       { .func_arg = opt_stats_period },
-        "set the period at which ffmpeg updates stats and -progress output", "time" },
+        "set the period at which ffmpeg updates stats, -progress and -stage_stats output", "time" },
     { "attach",         HAS_ARG | OPT_PERFILE | OPT_EXPERT |
                         OPT_OUTPUT,                                  { .func_arg = opt_attach },
         "add an attachment to the output file", "filename" },
@@ -1537,6 +1576,12 @@ const OptionDef options[] = {
     { "thread_queue_size", HAS_ARG | OPT_INT | OPT_OFFSET | OPT_EXPERT | OPT_INPUT | OPT_OUTPUT,
                                                                      { .off = OFFSET(thread_queue_size) },
         "set the maximum number of queued packets from the demuxer" },
+    { "encoder_threads", OPT_BOOL | OPT_EXPERT,                      { &encoder_threads },
+        "run each encoder in a separate thread" },
+    { "decoder_threads", OPT_BOOL | OPT_EXPERT,                      { &decoder_threads },
+        "run each decoder in a separate thread" },
+    { "executor_threads", HAS_ARG | OPT_EXPERT,                      { .func_arg = opt_executor_threads },
+        "run the slice threads of all codecs, filters and scalers in one shared pool", "count" },
     { "find_stream_info", OPT_BOOL | OPT_INPUT | OPT_EXPERT | OPT_OFFSET, { .off = OFFSET(find_stream_info) },
         "read and decode the streams to fill missing information with heuristics" },
     { "bits_per_raw_sample", OPT_INT | HAS_ARG | OPT_EXPERT | OPT_SPEC | OPT_OUTPUT,
@@ -1082,6 +1082,11 @@ int opt_cpucount(void *optctx, const char *opt, const char *arg)
     return ret;
 }
 
+int opt_cpuautotune(void *optctx, const char *opt, const char *arg)
+{
+    return av_cpu_set_autotune(1, *arg ? arg : NULL);
+}
+
 static void expand_filename_template(AVBPrint *bp, const char *template,
                                      struct tm *tm)
 {
@@ -31,7 +31,8 @@ typedef struct ThreadQueue ThreadQueue;
  * @param nb_streams number of streams for which a distinct EOF state is
  *                   maintained
  * @param queue_size number of items that can be stored in the queue without
- *                   blocking
+ *                   blocking; 0 makes the queue grow as needed, so that sending
+ *                   never blocks
  * @param obj_pool object pool that will be used to allocate items stored in the
  *                 queue; the pool becomes owned by the queue
  * @param callback that moves the contents between two data pointers
@@ -48,11 +49,17 @@ void         tq_free(ThreadQueue **tq);
  *             untouched
  * @return
  * - 0 the item was successfully sent
- * - AVERROR(ENOMEM) could not allocate an item for writing to the FIFO
+ * - AVERROR(ENOMEM) could not allocate an item for writing to the FIFO, or
+ *                   could not grow an unbounded FIFO
  * - AVERROR(EINVAL) the sending side has previously been marked as finished
  * - AVERROR_EOF the receiving side has marked the given stream as finished
  */
 int tq_send(ThreadQueue *tq, unsigned int stream_idx, void *data);
+/**
+ * Same as tq_send(), but return AVERROR(EAGAIN) instead of blocking when the
+ * queue is full.
+ */
+int tq_send_nonblock(ThreadQueue *tq, unsigned int stream_idx, void *data);
 /**
  * Mark the given stream finished from the sending side.
  */
@@ -73,9 +80,23 @@ void tq_send_finish(ThreadQueue *tq, unsigned int stream_idx);
  *   for each stream. When *stream_idx is -1, all streams are done.
  */
 int tq_receive(ThreadQueue *tq, int *stream_idx, void *data);
+/**
+ * Same as tq_receive(), but return AVERROR(EAGAIN) instead of blocking when
+ * no item is available and not all streams are finished.
+ */
+int tq_receive_nonblock(ThreadQueue *tq, int *stream_idx, void *data);
 /**
  * Mark the given stream finished from the receiving side.
  */
 void tq_receive_finish(ThreadQueue *tq, unsigned int stream_idx);
 
+/**
+ * Get the current occupancy of the queue.
+ *
+ * @param nb_queued the number of items stored in the queue will be written here
+ * @param queue_size the number of items that can be stored without blocking
+ *                   will be written here, 0 for an unbounded queue
+ */
+void tq_occupancy(ThreadQueue *tq, size_t *nb_queued, size_t *queue_size);
+
 #endif // FFTOOLS_THREAD_QUEUE_H
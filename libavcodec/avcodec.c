@@ -465,6 +465,7 @@ av_cold int avcodec_close(AVCodecContext *avctx)
         av_packet_free(&avci->in_pkt);
         av_frame_free(&avci->in_frame);
         av_frame_free(&avci->recon_frame);
+        av_frame_pool_free(&avci->frame_pool);
 
         av_buffer_unref(&avci->pool);
 
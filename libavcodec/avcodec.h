@@ -2057,6 +2057,20 @@ typedef struct AVCodecContext {
      *             The decoder can then override during decoding as needed.
      */
     AVChannelLayout ch_layout;
+
+    /**
+     * If set, the slice threading jobs of the codec run on this executor,
+     * which may be shared with other codecs and filter graphs, instead of
+     * threads owned by the codec. thread_count then limits the number of jobs
+     * running concurrently, 0 deriving it from the number of threads of the
+     * executor. Frame threading still uses its own threads.
+     *
+     * The executor must outlive the codec context.
+     *
+     * - encoding: Set by user.
+     * - decoding: Set by user.
+     */
+    struct AVExecutor *executor;
 } AVCodecContext;
 
 /**
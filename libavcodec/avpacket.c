@@ -26,6 +26,7 @@
 #include "libavutil/mathematics.h"
 #include "libavutil/mem.h"
 #include "libavutil/rational.h"
+#include "libavutil/thread.h"
 
 #include "defs.h"
 #include "packet.h"
@@ -79,6 +80,76 @@ void av_packet_free(AVPacket **pkt)
     av_freep(pkt);
 }
 
+struct AVPacketPool {
+    AVMutex      mutex;
+    AVPacket   **pkts;
+    unsigned int nb_pkts;
+    unsigned int pkts_allocated;
+};
+
+AVPacketPool *av_packet_pool_alloc(void)
+{
+    AVPacketPool *pool = av_mallocz(sizeof(*pool));
+
+    if (!pool)
+        return NULL;
+
+    if (ff_mutex_init(&pool->mutex, NULL)) {
+        av_free(pool);
+        return NULL;
+    }
+
+    return pool;
+}
+
+void av_packet_pool_free(AVPacketPool **ppool)
+{
+    AVPacketPool *pool = *ppool;
+
+    if (!pool)
+        return;
+
+    for (unsigned int i = 0; i < pool->nb_pkts; i++)
+        av_packet_free(&pool->pkts[i]);
+    av_freep(&pool->pkts);
+    ff_mutex_destroy(&pool->mutex);
+    av_freep(ppool);
+}
+
+AVPacket *av_packet_pool_get(AVPacketPool *pool)
+{
+    AVPacket *pkt = NULL;
+
+    ff_mutex_lock(&pool->mutex);
+    if (pool->nb_pkts)
+        pkt = pool->pkts[--pool->nb_pkts];
+    ff_mutex_unlock(&pool->mutex);
+
+    return pkt ? pkt : av_packet_alloc();
+}
+
+void av_packet_pool_release(AVPacketPool *pool, AVPacket **pkt)
+{
+    void *tmp;
+
+    if (!*pkt)
+        return;
+
+    av_packet_unref(*pkt);
+
+    ff_mutex_lock(&pool->mutex);
+    tmp = av_fast_realloc(pool->pkts, &pool->pkts_allocated,
+                          (pool->nb_pkts + 1) * sizeof(*pool->pkts));
+    if (tmp) {
+        pool->pkts = tmp;
+        pool->pkts[pool->nb_pkts++] = *pkt;
+        *pkt = NULL;
+    }
+    ff_mutex_unlock(&pool->mutex);
+
+    av_packet_free(pkt);
+}
+
 static int packet_alloc(AVBufferRef **buf, int size)
 {
     int ret;
@@ -533,28 +604,36 @@ void av_packet_rescale_ts(AVPacket *pkt, AVRational src_tb, AVRational dst_tb)
         pkt->duration = av_rescale_q(pkt->duration, src_tb, dst_tb);
 }
 
+static void recycle_entry(PacketList *list, PacketListEntry *pktl)
+{
+    pktl->next     = list->recycled;
+    list->recycled = pktl;
+}
+
 int avpriv_packet_list_put(PacketList *packet_buffer,
                            AVPacket      *pkt,
                            int (*copy)(AVPacket *dst, const AVPacket *src),
                            int flags)
 {
-    PacketListEntry *pktl = av_malloc(sizeof(*pktl));
+    PacketListEntry *pktl = packet_buffer->recycled;
     int ret;
 
-    if (!pktl)
+    if (pktl)
+        packet_buffer->recycled = pktl->next;
+    else if (!(pktl = av_malloc(sizeof(*pktl))))
         return AVERROR(ENOMEM);
 
     if (copy) {
         get_packet_defaults(&pktl->pkt);
         ret = copy(&pktl->pkt, pkt);
         if (ret < 0) {
-            av_free(pktl);
+            recycle_entry(packet_buffer, pktl);
             return ret;
         }
     } else {
         ret = av_packet_make_refcounted(pkt);
         if (ret < 0) {
-            av_free(pktl);
+            recycle_entry(packet_buffer, pktl);
             return ret;
         }
         av_packet_move_ref(&pktl->pkt, pkt);
@@ -582,7 +661,7 @@ int avpriv_packet_list_get(PacketList *pkt_buffer,
     pkt_buffer->head = pktl->next;
     if (!pkt_buffer->head)
         pkt_buffer->tail = NULL;
-    av_freep(&pktl);
+    recycle_entry(pkt_buffer, pktl);
     return 0;
 }
 
@@ -596,7 +675,13 @@ void avpriv_packet_list_free(PacketList *pkt_buf)
         av_packet_unref(&pktl->pkt);
         av_freep(&pktl);
     }
-    pkt_buf->head = pkt_buf->tail = NULL;
+    tmp = pkt_buf->recycled;
+    while (tmp) {
+        PacketListEntry *pktl = tmp;
+        tmp = pktl->next;
+        av_freep(&pktl);
+    }
+    pkt_buf->head = pkt_buf->tail = pkt_buf->recycled = NULL;
 }
 
 int ff_side_data_set_encoder_stats(AVPacket *pkt, int quality, int64_t *error, int error_count, int pict_type)
@@ -1530,6 +1530,7 @@ fail:
 
 static int reget_buffer_internal(AVCodecContext *avctx, AVFrame *frame, int flags)
 {
+    AVCodecInternal *avci = avctx->internal;
     AVFrame *tmp;
     int ret;
 
@@ -1547,7 +1548,9 @@ static int reget_buffer_internal(AVCodecContext *avctx, AVFrame *frame, int flag
     if ((flags & FF_REGET_BUFFER_FLAG_READONLY) || av_frame_is_writable(frame))
         return ff_decode_frame_props(avctx, frame);
 
-    tmp = av_frame_alloc();
+    if (!avci->frame_pool && !(avci->frame_pool = av_frame_pool_alloc()))
+        return AVERROR(ENOMEM);
+    tmp = av_frame_pool_get(avci->frame_pool);
     if (!tmp)
         return AVERROR(ENOMEM);
 
@@ -1555,12 +1558,12 @@ static int reget_buffer_internal(AVCodecContext *avctx, AVFrame *frame, int flag
 
     ret = ff_get_buffer(avctx, frame, AV_GET_BUFFER_FLAG_REF);
     if (ret < 0) {
-        av_frame_free(&tmp);
+        av_frame_pool_release(avci->frame_pool, &tmp);
         return ret;
     }
 
     av_frame_copy(frame, tmp);
-    av_frame_free(&tmp);
+    av_frame_pool_release(avci->frame_pool, &tmp);
 
     return 0;
 }
@@ -90,6 +90,12 @@ typedef struct AVCodecInternal {
     AVPacket *last_pkt_props;
     struct AVFifo *pkt_props;
 
+    /**
+     * Recycled temporary frames, e.g. for ff_reget_buffer(). Allocated on
+     * first use.
+     */
+    struct AVFramePool *frame_pool;
+
     /**
      * temporary buffer used for encoders to store their bitstream
      */
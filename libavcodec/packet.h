@@ -493,6 +493,50 @@ AVPacket *av_packet_clone(const AVPacket *src);
  */
 void av_packet_free(AVPacket **pkt);
 
+/**
+ * A pool of AVPacket structures, for recycling the packets themselves
+ * instead of allocating and freeing one for every packet processed. The pool
+ * keeps the AVPacket structures only, not their data buffers.
+ *
+ * The functions operating on a pool may be called from several threads
+ * simultaneously.
+ */
+typedef struct AVPacketPool AVPacketPool;
+
+/**
+ * Allocate an empty pool of packets. It must be freed with
+ * av_packet_pool_free().
+ *
+ * @return the pool or NULL on failure
+ */
+AVPacketPool *av_packet_pool_alloc(void);
+
+/**
+ * Free a pool and all the packets in it. The packets taken from the pool and
+ * not released yet are not affected, they must then be freed with
+ * av_packet_free().
+ *
+ * @param pool pointer to the pool to be freed. It will be set to NULL.
+ */
+void av_packet_pool_free(AVPacketPool **pool);
+
+/**
+ * Take a packet from the pool, or allocate a new one if the pool is empty.
+ * The packet has its fields set to default values, as if allocated with
+ * av_packet_alloc().
+ *
+ * @return the packet or NULL on failure
+ */
+AVPacket *av_packet_pool_get(AVPacketPool *pool);
+
+/**
+ * Unreference a packet and return it to the pool. Any packet allocated with
+ * av_packet_alloc() may be released to a pool.
+ *
+ * @param pkt pointer to the packet to be released. It will be set to NULL.
+ */
+void av_packet_pool_release(AVPacketPool *pool, AVPacket **pkt);
+
 #if FF_API_INIT_PACKET
 /**
  * Initialize optional fields of a packet with default values.
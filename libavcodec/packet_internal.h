@@ -30,6 +30,11 @@ typedef struct PacketListEntry {
 
 typedef struct PacketList {
     PacketListEntry *head, *tail;
+    /**
+     * Entries removed from the list, reused by the next insertions instead
+     * of allocating new ones. Freed by avpriv_packet_list_free().
+     */
+    PacketListEntry *recycled;
 } PacketList;
 
 /**
@@ -62,7 +67,8 @@ int avpriv_packet_list_put(PacketList *list, AVPacket *pkt,
 int avpriv_packet_list_get(PacketList *list, AVPacket *pkt);
 
 /**
- * Wipe the list and unref all the packets in it.
+ * Wipe the list and unref all the packets in it. This also frees the
+ * recycled entries.
  */
 void avpriv_packet_list_free(PacketList *list);
 
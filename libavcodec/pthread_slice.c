@@ -144,7 +144,8 @@ int ff_slice_thread_init(AVCodecContext *avctx)
         thread_count = avctx->thread_count = 1;
 
     if (!thread_count) {
-        int nb_cpus = av_cpu_count();
+        int nb_cpus = avctx->executor ? av_executor_nb_threads(avctx->executor)
+                                      : av_cpu_count();
         if  (avctx->height)
             nb_cpus = FFMIN(nb_cpus, (avctx->height+15)/16);
         // use number of cores + 1 as thread count if there is more than one
@@ -161,7 +162,8 @@ int ff_slice_thread_init(AVCodecContext *avctx)
 
     avctx->internal->thread_ctx = c = av_mallocz(sizeof(*c));
     mainfunc = ffcodec(avctx->codec)->caps_internal & FF_CODEC_CAP_SLICE_THREAD_HAS_MF ? &main_function : NULL;
-    if (!c || (thread_count = avpriv_slicethread_create(&c->thread, avctx, worker_func, mainfunc, thread_count)) <= 1) {
+    if (!c || (thread_count = avpriv_slicethread_create_executor(&c->thread, avctx, worker_func, mainfunc,
+                                                                 thread_count, avctx->executor)) <= 1) {
         if (c)
             avpriv_slicethread_free(&c->thread);
         av_freep(&avctx->internal->thread_ctx);
@@ -181,6 +183,17 @@ int av_cold ff_slice_thread_init_progress(AVCodecContext *avctx)
     SliceThreadContext *const p = avctx->internal->thread_ctx;
     int err, i = 0, thread_count = avctx->thread_count;
 
+    /* the jobs wait for the progress of each other, which requires them to
+     * run concurrently, so they cannot run on a shared executor */
+    if (avctx->executor) {
+        void (*mainfunc)(void *) = ffcodec(avctx->codec)->caps_internal & FF_CODEC_CAP_SLICE_THREAD_HAS_MF ?
+                                   &main_function : NULL;
+        avpriv_slicethread_free(&p->thread);
+        err = avpriv_slicethread_create(&p->thread, avctx, worker_func, mainfunc, thread_count);
+        if (err < 0)
+            return err;
+    }
+
     p->progress = av_calloc(thread_count, sizeof(*p->progress));
     if (!p->progress) {
         err = AVERROR(ENOMEM);
@@ -126,7 +126,26 @@ int main(void)
     }
     /*clean up*/
     av_packet_free(&avpkt_clone);
-    av_packet_free(&avpkt);
+
+    /* test that av_packet_pool_get() returns the packets released to it */
+    {
+        AVPacketPool *pool = av_packet_pool_alloc();
+        AVPacket *pooled, *released = avpkt;
+
+        if (!pool) {
+            av_log(NULL, AV_LOG_ERROR, "av_packet_pool_alloc failed\n");
+            return 1;
+        }
+        av_packet_pool_release(pool, &avpkt);
+        pooled = av_packet_pool_get(pool);
+        if (avpkt || pooled != released || pooled->data ||
+            pooled->side_data_elems || pooled->pts != AV_NOPTS_VALUE) {
+            printf("av_packet_pool_get failed to return a blank recycled packet\n");
+            ret = 1;
+        }
+        av_packet_pool_release(pool, &pooled);
+        av_packet_pool_free(&pool);
+    }
 
 
     return ret;
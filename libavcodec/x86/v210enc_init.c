@@ -17,6 +17,7 @@
  */
 
 #include "libavutil/attributes.h"
+#include "libavutil/mem.h"
 #include "libavutil/x86/cpu.h"
 #include "libavcodec/v210enc.h"
 
@@ -38,6 +39,60 @@ void ff_v210_planar_pack_10_avx2(const uint16_t *y, const uint16_t *u,
                                  const uint16_t *v, uint8_t *dst,
                                  ptrdiff_t width);
 
+#define BENCH_WIDTH 1920
+
+typedef struct PackLine8Bench {
+    uint8_t y[BENCH_WIDTH];
+    uint8_t u[BENCH_WIDTH / 2];
+    uint8_t v[BENCH_WIDTH / 2];
+    uint8_t dst[BENCH_WIDTH * 8 / 3];
+} PackLine8Bench;
+
+static void bench_pack_line_8(void *opaque, void *func)
+{
+    PackLine8Bench *b = opaque;
+    void (*pack_line)(const uint8_t *y, const uint8_t *u, const uint8_t *v,
+                      uint8_t *dst, ptrdiff_t width) = func;
+
+    pack_line(b->y, b->u, b->v, b->dst, BENCH_WIDTH);
+}
+
+/* The wider versions are not faster on every CPU that supports them. */
+static av_cold void autotune_pack_line_8(V210EncContext *s, int cpu_flags)
+{
+    const char *names[5];
+    void *funcs[5];
+    int sample_factors[5], nb = 0, i;
+    PackLine8Bench *b;
+
+#define CANDIDATE(ext, factor)                              \
+    do {                                                    \
+        names[nb]          = #ext;                          \
+        funcs[nb]          = ff_v210_planar_pack_8_ ## ext; \
+        sample_factors[nb] = factor;                        \
+        nb++;                                               \
+    } while (0)
+
+    if (EXTERNAL_SSSE3(cpu_flags))
+        CANDIDATE(ssse3, 2);
+    if (EXTERNAL_AVX(cpu_flags))
+        CANDIDATE(avx, 2);
+    if (EXTERNAL_AVX2(cpu_flags))
+        CANDIDATE(avx2, 2);
+    if (EXTERNAL_AVX512(cpu_flags))
+        CANDIDATE(avx512, 2);
+    if (EXTERNAL_AVX512ICL(cpu_flags))
+        CANDIDATE(avx512icl, 4);
+    if (nb < 2 || !(b = av_mallocz(sizeof(*b))))
+        return;
+
+    i = avpriv_cpu_autotune("v210enc.pack_line_8", names, funcs, nb,
+                            bench_pack_line_8, b);
+    s->pack_line_8     = funcs[i];
+    s->sample_factor_8 = sample_factors[i];
+    av_free(b);
+}
+
 av_cold void ff_v210enc_init_x86(V210EncContext *s)
 {
     int cpu_flags = av_get_cpu_flags();
@@ -66,4 +121,7 @@ av_cold void ff_v210enc_init_x86(V210EncContext *s)
         s->sample_factor_8  = 4;
         s->pack_line_8      = ff_v210_planar_pack_8_avx512icl;
     }
+
+    if (avpriv_cpu_autotune_enabled())
+        autotune_pack_line_8(s, cpu_flags);
 }
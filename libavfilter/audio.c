@@ -28,6 +28,7 @@
 #include "avfilter.h"
 #include "framepool.h"
 #include "internal.h"
+#include "thread.h"
 
 AVFrame *ff_null_get_audio_buffer(AVFilterLink *link, int nb_samples)
 {
@@ -37,6 +38,7 @@ AVFrame *ff_null_get_audio_buffer(AVFilterLink *link, int nb_samples)
 AVFrame *ff_default_get_audio_buffer(AVFilterLink *link, int nb_samples)
 {
     AVFrame *frame = NULL;
+    FFBufferCache *buffer_cache = link->dst->graph ? link->dst->graph->internal->buffer_cache : NULL;
     int channels = link->ch_layout.nb_channels;
 #if FF_API_OLD_CHANNEL_LAYOUT
 FF_DISABLE_DEPRECATION_WARNINGS
@@ -48,7 +50,7 @@ FF_ENABLE_DEPRECATION_WARNINGS
 #endif
 
     if (!link->frame_pool) {
-        link->frame_pool = ff_frame_pool_audio_init(av_buffer_allocz, channels,
+        link->frame_pool = ff_frame_pool_audio_init(av_buffer_allocz, buffer_cache, channels,
                                                     nb_samples, link->format, align);
         if (!link->frame_pool)
             return NULL;
@@ -68,7 +70,7 @@ FF_ENABLE_DEPRECATION_WARNINGS
             pool_format != link->format || pool_align != align) {
 
             ff_frame_pool_uninit((FFFramePool **)&link->frame_pool);
-            link->frame_pool = ff_frame_pool_audio_init(av_buffer_allocz, channels,
+            link->frame_pool = ff_frame_pool_audio_init(av_buffer_allocz, buffer_cache, channels,
                                                         nb_samples, link->format, align);
             if (!link->frame_pool)
                 return NULL;
@@ -101,11 +103,26 @@ AVFrame *ff_get_audio_buffer(AVFilterLink *link, int nb_samples)
 {
     AVFrame *ret = NULL;
 
-    if (link->dstpad->get_buffer.audio)
-        ret = link->dstpad->get_buffer.audio(link, nb_samples);
-
-    if (!ret)
+    /* The links of frame-threaded filters can be used from several threads:
+     * bypass the get_buffer() callbacks, which could run concurrently with
+     * the other callbacks of their filter, and serialize the allocations. */
+    if (ff_filter_frame_threaded(link->src) || ff_filter_frame_threaded(link->dst)) {
+        ff_graph_frame_thread_alloc_lock(link->dst->graph);
         ret = ff_default_get_audio_buffer(link, nb_samples);
+        ff_graph_frame_thread_alloc_unlock(link->dst->graph);
+    } else {
+        if (link->dstpad->get_buffer.audio) {
+            link->dst->internal->get_buffer_depth++;
+            ret = link->dstpad->get_buffer.audio(link, nb_samples);
+            link->dst->internal->get_buffer_depth--;
+        }
+
+        if (!ret)
+            ret = ff_default_get_audio_buffer(link, nb_samples);
+    }
+
+    if (ret)
+        ff_filter_profile_alloc(link, ret);
 
     return ret;
 }
@@ -28,11 +28,13 @@
 #include "libavutil/eval.h"
 #include "libavutil/frame.h"
 #include "libavutil/hwcontext.h"
+#include "libavutil/imgutils.h"
 #include "libavutil/internal.h"
 #include "libavutil/opt.h"
 #include "libavutil/pixdesc.h"
 #include "libavutil/rational.h"
 #include "libavutil/samplefmt.h"
+#include "libavutil/time.h"
 
 #define FF_INTERNAL_FIELDS 1
 #include "framequeue.h"
@@ -43,6 +45,7 @@
 #include "formats.h"
 #include "framepool.h"
 #include "internal.h"
+#include "thread.h"
 
 static void tlog_ref(void *ctx, AVFrame *ref, int end)
 {
@@ -541,6 +544,8 @@ void ff_update_link_current_pts(AVFilterLink *link, int64_t pts)
 
 int avfilter_process_command(AVFilterContext *filter, const char *cmd, const char *arg, char *res, int res_len, int flags)
 {
+    int ret, err;
+
     if(!strcmp(cmd, "ping")){
         char local_res[256] = {0};
 
@@ -553,11 +558,14 @@ int avfilter_process_command(AVFilterContext *filter, const char *cmd, const cha
             av_log(filter, AV_LOG_INFO, "%s", res);
         return 0;
     }else if(!strcmp(cmd, "enable")) {
-        return set_enable_expr(filter, arg);
+        ret = set_enable_expr(filter, arg);
     }else if(filter->filter->process_command) {
-        return filter->filter->process_command(filter, cmd, arg, res, res_len, flags);
-    }
-    return AVERROR(ENOSYS);
+        ret = filter->filter->process_command(filter, cmd, arg, res, res_len, flags);
+    }else
+        return AVERROR(ENOSYS);
+
+    err = ff_filter_graph_refuse(filter);
+    return ret < 0 ? ret : err;
 }
 
 #if FF_API_PAD_COUNT
@@ -616,8 +624,9 @@ static const AVClass *filter_child_class_iterate(void **iter)
 #define TFLAGS AV_OPT_FLAG_FILTERING_PARAM|AV_OPT_FLAG_RUNTIME_PARAM
 static const AVOption avfilter_options[] = {
     { "thread_type", "Allowed thread types", OFFSET(thread_type), AV_OPT_TYPE_FLAGS,
-        { .i64 = AVFILTER_THREAD_SLICE }, 0, INT_MAX, FLAGS, "thread_type" },
+        { .i64 = AVFILTER_THREAD_SLICE | AVFILTER_THREAD_FRAME }, 0, INT_MAX, FLAGS, "thread_type" },
         { "slice", NULL, 0, AV_OPT_TYPE_CONST, { .i64 = AVFILTER_THREAD_SLICE }, .flags = FLAGS, .unit = "thread_type" },
+        { "frame", NULL, 0, AV_OPT_TYPE_CONST, { .i64 = AVFILTER_THREAD_FRAME }, .flags = FLAGS, .unit = "thread_type" },
     { "enable", "set enable expression", OFFSET(enable_str), AV_OPT_TYPE_STRING, {.str=NULL}, .flags = TFLAGS },
     { "threads", "Allowed number of threads", OFFSET(nb_threads), AV_OPT_TYPE_INT,
         { .i64 = 0 }, 0, INT_MAX, FLAGS },
@@ -728,8 +737,13 @@ static void free_link(AVFilterLink *link)
     if (!link)
         return;
 
-    if (link->src)
+    if (link->src) {
+        if (link->nb_copies)
+            av_log(link->dst, AV_LOG_VERBOSE,
+                   "Copied %"PRId64" frames (%"PRId64" KiB) from %s to make them writable\n",
+                   link->nb_copies, link->bytes_copied >> 10, link->src->name);
         link->src->outputs[link->srcpad - link->src->output_pads] = NULL;
+    }
     if (link->dst)
         link->dst->inputs[link->dstpad - link->dst->input_pads] = NULL;
 
@@ -885,7 +899,7 @@ int ff_filter_process_command(AVFilterContext *ctx, const char *cmd,
 
 int avfilter_init_dict(AVFilterContext *ctx, AVDictionary **options)
 {
-    int ret = 0;
+    int thread_type, ret = 0;
 
     ret = av_opt_set_dict(ctx, options);
     if (ret < 0) {
@@ -893,14 +907,17 @@ int avfilter_init_dict(AVFilterContext *ctx, AVDictionary **options)
         return ret;
     }
 
+    thread_type = ctx->thread_type & ctx->graph->thread_type;
+    ctx->thread_type = 0;
     if (ctx->filter->flags & AVFILTER_FLAG_SLICE_THREADS &&
-        ctx->thread_type & ctx->graph->thread_type & AVFILTER_THREAD_SLICE &&
+        thread_type & AVFILTER_THREAD_SLICE &&
         ctx->graph->internal->thread_execute) {
-        ctx->thread_type       = AVFILTER_THREAD_SLICE;
+        ctx->thread_type      |= AVFILTER_THREAD_SLICE;
         ctx->internal->execute = ctx->graph->internal->thread_execute;
-    } else {
-        ctx->thread_type = 0;
     }
+    if (ctx->filter->flags & AVFILTER_FLAG_FRAME_THREADS &&
+        thread_type & AVFILTER_THREAD_FRAME && !ctx->filter->activate)
+        ctx->thread_type |= AVFILTER_THREAD_FRAME;
 
     if (ctx->filter->priv_class) {
         ret = av_opt_set_dict2(ctx->priv, options, AV_OPT_SEARCH_CHILDREN);
@@ -994,9 +1011,13 @@ static int ff_filter_frame_framed(AVFilterLink *link, AVFrame *frame)
     ff_inlink_process_commands(link, frame);
     dstctx->is_disabled = !ff_inlink_evaluate_timeline_at_frame(link, frame);
 
-    if (dstctx->is_disabled &&
-        (dstctx->filter->flags & AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC))
+    if ((dstctx->is_disabled &&
+         (dstctx->filter->flags & AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC)) ||
+        dstctx->internal->fused)
         filter_frame = default_filter_frame;
+    /* frame_count_out is updated by the frame thread when it is done */
+    if (filter_frame != default_filter_frame && ff_filter_frame_threaded(dstctx))
+        return ff_graph_frame_thread_submit(link, frame, filter_frame);
     ret = filter_frame(link, frame);
     link->frame_count_out++;
     return ret;
@@ -1006,8 +1027,9 @@ fail:
     return ret;
 }
 
-int ff_filter_frame(AVFilterLink *link, AVFrame *frame)
+static int filter_frame_to_link(AVFilterLink *link, AVFrame *frame)
 {
+    unsigned priority;
     int ret;
     FF_TPRINTF_START(NULL, filter_frame); ff_tlog_link(NULL, link, 1); ff_tlog(NULL, " "); tlog_ref(NULL, frame, 1);
 
@@ -1037,6 +1059,13 @@ int ff_filter_frame(AVFilterLink *link, AVFrame *frame)
         }
     }
 
+    /* A filter wanting writable frames gets a shared frame after the other
+       filters holding a reference to it ran and possibly released it: the
+       last one then gets it without a copy. */
+    priority = link->dstpad->flags & (AVFILTERPAD_FLAG_NEEDS_WRITABLE |
+                                      AVFILTERPAD_FLAG_PREFERS_WRITABLE) &&
+               !av_frame_is_writable(frame) ? 150 : 300;
+
     link->frame_blocked_in = link->frame_wanted_out = 0;
     link->frame_count_in++;
     link->sample_count_in += frame->nb_samples;
@@ -1046,7 +1075,7 @@ int ff_filter_frame(AVFilterLink *link, AVFrame *frame)
         av_frame_free(&frame);
         return ret;
     }
-    ff_filter_set_ready(link->dst, 300);
+    ff_filter_set_ready(link->dst, priority);
     return 0;
 
 error:
@@ -1054,6 +1083,18 @@ error:
     return AVERROR_PATCHWELCOME;
 }
 
+int ff_filter_frame(AVFilterLink *link, AVFrame *frame)
+{
+    int ret;
+
+    /* the source filter may be running in a frame thread */
+    ff_filter_frame_thread_lock(link->src);
+    ret = filter_frame_to_link(link, frame);
+    ff_filter_frame_thread_unlock(link->src);
+
+    return ret;
+}
+
 static int samples_ready(AVFilterLink *link, unsigned min)
 {
     return ff_framequeue_queued_frames(&link->fifo) &&
@@ -1152,6 +1193,15 @@ static int ff_filter_frame_to_filter(AVFilterLink *link)
     return ret;
 }
 
+void ff_filter_frame_thread_done(AVFilterLink *link, int ret)
+{
+    link->frame_count_out++;
+    if (ret < 0 && ret != link->status_out)
+        ff_avfilter_link_set_out_status(link, ret, AV_NOPTS_VALUE);
+    else
+        ff_filter_set_ready(link->dst, 300);
+}
+
 static int forward_status_change(AVFilterContext *filter, AVFilterLink *in)
 {
     unsigned out = 0, progress = 0;
@@ -1340,16 +1390,61 @@ static int ff_filter_activate_default(AVFilterContext *filter)
      [buffersrc1][testsrc1][buffersrc2][testsrc2]concat=v=2).
  */
 
+void ff_filter_profile_call(AVFilterContext *ctx, int64_t start, int64_t blocked)
+{
+    AVFilterProfile *p = &ctx->internal->profile;
+
+    p->nb_calls++;
+    p->time         += av_gettime_relative() - start;
+    p->time_blocked += blocked;
+}
+
+void ff_filter_profile_alloc(AVFilterLink *link, const AVFrame *frame)
+{
+    AVFilterProfile *p = &link->src->internal->profile;
+
+    if (!link->graph || !link->graph->profile ||
+        link->src->internal->get_buffer_depth)
+        return;
+    for (int i = 0; i < FF_ARRAY_ELEMS(frame->buf) && frame->buf[i]; i++)
+        p->bytes_alloc += frame->buf[i]->size;
+    for (int i = 0; i < frame->nb_extended_buf; i++)
+        p->bytes_alloc += frame->extended_buf[i]->size;
+}
+
+const AVFilterProfile *avfilter_get_profile(AVFilterContext *ctx)
+{
+    AVFilterProfile *p = &ctx->internal->profile;
+
+    if (!ctx->graph || !ctx->graph->profile)
+        return NULL;
+
+    p->frames_in = p->frames_out = 0;
+    for (unsigned i = 0; i < ctx->nb_inputs; i++)
+        p->frames_in  += ctx->inputs[i]->frame_count_out;
+    for (unsigned i = 0; i < ctx->nb_outputs; i++)
+        p->frames_out += ctx->outputs[i]->frame_count_in;
+    return p;
+}
+
 int ff_filter_activate(AVFilterContext *filter)
 {
+    int64_t start = 0;
     int ret;
+    /* the frame threads account for the filter_frame() callbacks they run */
+    int profile = filter->graph->profile &&
+                  (filter->filter->activate || !ff_filter_frame_threaded(filter));
 
     /* Generic timeline support is not yet implemented but should be easy */
     av_assert1(!(filter->filter->flags & AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC &&
                  filter->filter->activate));
     filter->ready = 0;
+    if (profile)
+        start = av_gettime_relative();
     ret = filter->filter->activate ? filter->filter->activate(filter) :
           ff_filter_activate_default(filter);
+    if (profile)
+        ff_filter_profile_call(filter, start, 0);
     if (ret == FFERROR_NOT_READY)
         ret = 0;
     return ret;
@@ -1449,7 +1544,7 @@ int ff_inlink_make_frame_writable(AVFilterLink *link, AVFrame **rframe)
 {
     AVFrame *frame = *rframe;
     AVFrame *out;
-    int ret;
+    int ret, size;
 
     if (av_frame_is_writable(frame))
         return 0;
@@ -1480,6 +1575,18 @@ int ff_inlink_make_frame_writable(AVFilterLink *link, AVFrame **rframe)
         return ret;
     }
 
+    size = link->type == AVMEDIA_TYPE_VIDEO ?
+           av_image_get_buffer_size(frame->format, frame->width, frame->height, 1) :
+           av_samples_get_buffer_size(NULL, frame->ch_layout.nb_channels,
+                                      frame->nb_samples, frame->format, 1);
+    link->nb_copies++;
+    link->bytes_copied += FFMAX(size, 0);
+    if (link->graph && link->graph->profile) {
+        AVFilterProfile *p = &link->dst->internal->profile;
+        p->nb_copies++;
+        p->bytes_copied += FFMAX(size, 0);
+    }
+
     av_frame_free(&frame);
     *rframe = out;
     return 0;
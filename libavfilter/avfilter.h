@@ -141,6 +141,15 @@ enum AVMediaType avfilter_pad_get_type(const AVFilterPad *pads, int pad_idx);
  *   received by the filter on one of its inputs.
  */
 #define AVFILTER_FLAG_METADATA_ONLY         (1 << 3)
+/**
+ * The filter supports frame threading: the filter_frame() callbacks of its
+ * inputs may run in a worker thread, concurrently with other filters of the
+ * graph. The callbacks of a given instance are never run concurrently with
+ * each other or with any other callback of the same instance.
+ *
+ * Only filters without an activate() callback may set this flag.
+ */
+#define AVFILTER_FLAG_FRAME_THREADS         (1 << 4)
 /**
  * Some filters support a generic "enable" expression option that can be used
  * to enable or disable a filter in the timeline. Filters supporting this
@@ -397,6 +406,37 @@ typedef struct AVFilter {
      * activation.
      */
     int (*activate)(AVFilterContext *ctx);
+
+    /**
+     * Pointwise video filters, which change every component of the pixels
+     * through a function of its value only, may set this callback so that
+     * the graph can fuse runs of them into a single pass over the frames.
+     *
+     * Replace every value in the table lut with the result of the filter for
+     * it. Only called once the input link is configured.
+     *
+     * @param comp index of the component in the AVPixFmtDescriptor of the
+     *             input format
+     * @param lut  table to update
+     * @param nb   number of entries in the table, 1 << depth of the component
+     * @return 0 on success, a negative AVERROR code if the filter is not
+     *         pointwise with its current options, the table is then unused
+     */
+    int (*map_lut)(AVFilterContext *ctx, int comp, uint16_t *lut, int nb);
+
+    /**
+     * Pointwise video filters applying a lookup table to every component may
+     * set this callback, in addition to map_lut(), so that the tables of the
+     * filters following them can be composed into theirs.
+     *
+     * The tables returned can be modified by the graph, so they must be
+     * computed again by the config_props() callback of the input pad, and their
+     * values must not exceed the maximum value of the component.
+     *
+     * @return the table of at least 1 << depth entries applied to the
+     *         component comp, or NULL if the component is left unchanged
+     */
+    uint16_t *(*get_lut)(AVFilterContext *ctx, int comp);
 } AVFilter;
 
 /**
@@ -408,6 +448,10 @@ unsigned avfilter_filter_pad_count(const AVFilter *filter, int is_output);
  * Process multiple parts of the frame concurrently.
  */
 #define AVFILTER_THREAD_SLICE (1 << 0)
+/**
+ * Process successive frames in different filters concurrently.
+ */
+#define AVFILTER_THREAD_FRAME (1 << 1)
 
 typedef struct AVFilterInternal AVFilterInternal;
 
@@ -724,6 +768,12 @@ struct AVFilterLink {
      */
     int status_out;
 
+    /**
+     * Number of frames copied by ff_inlink_make_frame_writable() for the
+     * destination filter, and their total size in bytes.
+     */
+    int64_t nb_copies, bytes_copied;
+
 #endif /* FF_INTERNAL_FIELDS */
 
 };
@@ -893,6 +943,13 @@ typedef struct AVFilterGraph {
      * bit AND with AVFilterContext.thread_type to get the final mask used for
      * determining allowed threading types. I.e. a threading type needs to be
      * set in both to be allowed.
+     *
+     * AVFILTER_THREAD_FRAME is not set by default. When it is set, frames sent
+     * with AV_BUFFERSRC_FLAG_PUSH may still be processed in worker threads when
+     * av_buffersrc_add_frame_flags() returns, so the resulting output frames
+     * may only be available from the buffersinks on later calls. Closing a
+     * buffersrc with AV_BUFFERSRC_FLAG_PUSH and requesting frames without
+     * AV_BUFFERSINK_FLAG_NO_REQUEST still wait for all the pending work.
      */
     int thread_type;
 
@@ -931,6 +988,36 @@ typedef struct AVFilterGraph {
 
     char *aresample_swr_opts; ///< swr options to use for the auto-inserted aresample filters, Access ONLY through AVOptions
 
+    /**
+     * If nonzero, the processing done by every filter is measured, see
+     * avfilter_get_profile(). Must be set before configuring the graph.
+     *
+     * Access ONLY through AVOptions or set it right after allocating the graph.
+     */
+    int profile;
+
+    /**
+     * Maximum total size in bytes of the frame buffers allocated by the
+     * filters of the graph, in use or kept for reuse. The buffers are shared
+     * by all the links. When the size is exceeded, buffers which are not in
+     * use are freed instead of being kept. 0 means no limit.
+     *
+     * Must be set before configuring the graph.
+     */
+    int64_t max_frame_pool_size;
+
+    /**
+     * If set, the jobs of the filters with slice threading capability run on
+     * this executor, which may be shared with other graphs and codecs,
+     * instead of threads owned by the graph. nb_threads then limits the
+     * number of jobs of a filter running concurrently, 0 meaning the number
+     * of threads of the executor plus the calling thread.
+     *
+     * May be set by the caller right after allocating the graph and before
+     * adding any filters to it. The executor must outlive the graph.
+     */
+    struct AVExecutor *executor;
+
     /**
      * Private fields
      *
@@ -1176,6 +1263,108 @@ int avfilter_graph_queue_command(AVFilterGraph *graph, const char *target, const
  */
 char *avfilter_graph_dump(AVFilterGraph *graph, const char *options);
 
+/**
+ * Statistics of the processing done by a filter, collected when
+ * AVFilterGraph.profile is set.
+ *
+ * @note The size of this struct is not part of the public ABI, new fields
+ *       may be added at the end with a minor version bump.
+ */
+typedef struct AVFilterProfile {
+    /**
+     * Number of times the filter was activated, or had its filter_frame()
+     * callback run in a frame thread.
+     */
+    int64_t nb_calls;
+    /**
+     * Total time spent processing, in microseconds.
+     */
+    int64_t time;
+    /**
+     * Total time the frames sent to a frame-threaded filter waited for a
+     * thread to process them, in microseconds. Always 0 for other filters.
+     */
+    int64_t time_blocked;
+    /**
+     * Number of frames consumed on all the inputs.
+     */
+    int64_t frames_in;
+    /**
+     * Number of frames output on all the outputs.
+     */
+    int64_t frames_out;
+    /**
+     * Total size in bytes of the frame buffers obtained for the outputs.
+     */
+    int64_t bytes_alloc;
+    /**
+     * Number of input frames copied because the filter needed them writable
+     * while they were shared, e.g. by the outputs of a split filter.
+     *
+     * Only the copies made by libavfilter for the filters with writable
+     * input pads are counted. Filters making their frames writable with
+     * av_frame_make_writable() themselves are not covered.
+     */
+    int64_t nb_copies;
+    /**
+     * Total size in bytes of the data of the copied frames.
+     */
+    int64_t bytes_copied;
+} AVFilterProfile;
+
+/**
+ * Get the processing statistics of a filter.
+ *
+ * The statistics are only collected when AVFilterGraph.profile is set. They
+ * are updated while the graph runs, so the caller should not expect them to
+ * be consistent with each other while frame threads are active.
+ *
+ * @return the statistics, valid until the filter is freed, or NULL if the
+ *         graph of the filter is not profiled
+ */
+const AVFilterProfile *avfilter_get_profile(AVFilterContext *ctx);
+
+/**
+ * Statistics of the frame buffers shared by the links of a graph.
+ *
+ * @note The size of this struct is not part of the public ABI, new fields
+ *       may be added at the end with a minor version bump.
+ */
+typedef struct AVFilterPoolStats {
+    /**
+     * Number of buffers reused.
+     */
+    int64_t hits;
+    /**
+     * Number of buffers allocated.
+     */
+    int64_t misses;
+    /**
+     * Number of buffers freed to respect AVFilterGraph.max_frame_pool_size.
+     */
+    int64_t trimmed;
+    /**
+     * Total size in bytes of the buffers, in use or kept for reuse.
+     */
+    int64_t size;
+    /**
+     * Total size in bytes of the buffers kept for reuse.
+     */
+    int64_t idle_size;
+    /**
+     * Maximum of size reached so far.
+     */
+    int64_t peak_size;
+} AVFilterPoolStats;
+
+/**
+ * Get the statistics of the frame buffers of a graph.
+ *
+ * @return a snapshot of the statistics, valid until the next call for the
+ *         same graph or until the graph is freed
+ */
+const AVFilterPoolStats *avfilter_graph_get_pool_stats(AVFilterGraph *graph);
+
 /**
  * Request a frame on the oldest sink link.
  *
@@ -25,6 +25,7 @@
 #include <string.h>
 
 #include "libavutil/avassert.h"
+#include "libavutil/avstring.h"
 #include "libavutil/bprint.h"
 #include "libavutil/channel_layout.h"
 #include "libavutil/imgutils.h"
@@ -37,6 +38,7 @@
 #include "avfilter.h"
 #include "buffersink.h"
 #include "formats.h"
+#include "framepool.h"
 #include "internal.h"
 #include "thread.h"
 
@@ -48,6 +50,7 @@ static const AVOption filtergraph_options[] = {
     { "thread_type", "Allowed thread types", OFFSET(thread_type), AV_OPT_TYPE_FLAGS,
         { .i64 = AVFILTER_THREAD_SLICE }, 0, INT_MAX, F|V|A, "thread_type" },
         { "slice", NULL, 0, AV_OPT_TYPE_CONST, { .i64 = AVFILTER_THREAD_SLICE }, .flags = F|V|A, .unit = "thread_type" },
+        { "frame", NULL, 0, AV_OPT_TYPE_CONST, { .i64 = AVFILTER_THREAD_FRAME }, .flags = F|V|A, .unit = "thread_type" },
     { "threads",     "Maximum number of threads", OFFSET(nb_threads), AV_OPT_TYPE_INT,
         { .i64 = 0 }, 0, INT_MAX, F|V|A, "threads"},
         {"auto", "autodetect a suitable number of threads to use", 0, AV_OPT_TYPE_CONST, {.i64 = 0 }, .flags = F|V|A, .unit = "threads"},
@@ -55,6 +58,10 @@ static const AVOption filtergraph_options[] = {
         AV_OPT_TYPE_STRING, {.str = NULL}, 0, 0, F|V },
     {"aresample_swr_opts"   , "default aresample filter options"    , OFFSET(aresample_swr_opts)    ,
         AV_OPT_TYPE_STRING, {.str = NULL}, 0, 0, F|A },
+    { "profile",     "Measure the processing done by every filter", OFFSET(profile), AV_OPT_TYPE_BOOL,
+        { .i64 = 0 }, 0, 1, F|V|A },
+    { "max_frame_pool_size", "Maximum size in bytes of the frame buffers", OFFSET(max_frame_pool_size), AV_OPT_TYPE_INT64,
+        { .i64 = 0 }, 0, INT64_MAX, F|V|A },
     { NULL },
 };
 
@@ -77,6 +84,55 @@ int ff_graph_thread_init(AVFilterGraph *graph)
     graph->nb_threads  = 1;
     return 0;
 }
+
+int ff_graph_frame_thread_init(AVFilterGraph *graph)
+{
+    return 0;
+}
+
+void ff_graph_frame_thread_free(AVFilterGraph *graph)
+{
+}
+
+void ff_graph_frame_thread_lock(AVFilterGraph *graph)
+{
+}
+
+void ff_graph_frame_thread_unlock(AVFilterGraph *graph)
+{
+}
+
+int ff_graph_frame_thread_submit(AVFilterLink *link, AVFrame *frame,
+                                 int (*filter_frame)(AVFilterLink *, AVFrame *))
+{
+    return filter_frame(link, frame);
+}
+
+int ff_graph_frame_thread_wait(AVFilterGraph *graph, AVFilterContext *filter)
+{
+    return AVERROR(EAGAIN);
+}
+
+int ff_graph_frame_thread_worker(AVFilterGraph *graph)
+{
+    return 0;
+}
+
+void ff_filter_frame_thread_lock(AVFilterContext *filter)
+{
+}
+
+void ff_filter_frame_thread_unlock(AVFilterContext *filter)
+{
+}
+
+void ff_graph_frame_thread_alloc_lock(AVFilterGraph *graph)
+{
+}
+
+void ff_graph_frame_thread_alloc_unlock(AVFilterGraph *graph)
+{
+}
 #endif
 
 AVFilterGraph *avfilter_graph_alloc(void)
@@ -91,6 +147,13 @@ AVFilterGraph *avfilter_graph_alloc(void)
         return NULL;
     }
 
+    ret->internal->buffer_cache = ff_buffer_cache_alloc();
+    if (!ret->internal->buffer_cache) {
+        av_freep(&ret->internal);
+        av_freep(&ret);
+        return NULL;
+    }
+
     ret->av_class = &filtergraph_class;
     av_opt_set_defaults(ret);
     ff_framequeue_global_init(&ret->internal->frame_queues);
@@ -121,10 +184,13 @@ void avfilter_graph_free(AVFilterGraph **graph)
     if (!*graph)
         return;
 
+    ff_graph_frame_thread_free(*graph);
+
     while ((*graph)->nb_filters)
         avfilter_free((*graph)->filters[0]);
 
     ff_graph_thread_free(*graph);
+    ff_buffer_cache_unref(&(*graph)->internal->buffer_cache);
 
     av_freep(&(*graph)->sink_links);
 
@@ -496,6 +562,7 @@ static int query_formats(AVFilterGraph *graph, void *log_ctx)
                 ret = avfilter_graph_create_filter(&convert, filter, inst_name, opts, NULL, graph);
                 if (ret < 0)
                     return ret;
+                convert->internal->auto_inserted = 1;
                 if ((ret = avfilter_insert_filter(link, convert, 0, 0)) < 0)
                     return ret;
 
@@ -1040,6 +1107,281 @@ static void swap_sample_fmts(AVFilterGraph *graph)
 
 }
 
+/* Costs of the pixel formats chosen around conversion filters, in bits of
+ * memory traffic per pixel. Losses of precision get costs much larger than
+ * any traffic, so that a lossless choice is always preferred. */
+#define FMT_COST_CONVERSION 16
+#define FMT_COST_INFINITE   (INT_MAX / 8)
+
+static const struct {
+    unsigned loss;
+    int cost;
+    const char *name;
+} pix_fmt_losses[] = {
+    { FF_LOSS_DEPTH,      1024, "depth"      },
+    { FF_LOSS_RESOLUTION, 1024, "resolution" },
+    { FF_LOSS_COLORSPACE,  256, "colorspace" },
+    { FF_LOSS_ALPHA,      4096, "alpha"      },
+    { FF_LOSS_CHROMA,     4096, "chroma"     },
+    { FF_LOSS_COLORQUANT, 4096, "colorquant" },
+};
+
+static int pix_fmt_bits(enum AVPixelFormat fmt)
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(fmt);
+    return desc ? av_get_padded_bits_per_pixel(desc) : 0;
+}
+
+static int pix_fmt_conversion_cost(enum AVPixelFormat src, enum AVPixelFormat dst)
+{
+    const AVPixFmtDescriptor *src_desc = av_pix_fmt_desc_get(src);
+    const AVPixFmtDescriptor *dst_desc = av_pix_fmt_desc_get(dst);
+    int loss, cost;
+
+    if (src == dst)
+        return 0;
+    if (!src_desc || !dst_desc ||
+        (src_desc->flags | dst_desc->flags) & AV_PIX_FMT_FLAG_HWACCEL)
+        return FMT_COST_INFINITE;
+
+    loss = av_get_pix_fmt_loss(dst, src, 1);
+    if (loss < 0)
+        return FMT_COST_INFINITE;
+
+    cost = FMT_COST_CONVERSION + pix_fmt_bits(src) + pix_fmt_bits(dst);
+    for (int i = 0; i < FF_ARRAY_ELEMS(pix_fmt_losses); i++)
+        if (loss & pix_fmt_losses[i].loss)
+            cost += pix_fmt_losses[i].cost;
+    return cost;
+}
+
+static int is_conversion_filter(AVFilterContext *f)
+{
+    const AVFilterNegotiation *neg;
+
+    if (f->nb_inputs != 1 || f->nb_outputs != 1 ||
+        f->inputs[0]->type != AVMEDIA_TYPE_VIDEO ||
+        f->outputs[0]->type != AVMEDIA_TYPE_VIDEO)
+        return 0;
+    neg = ff_filter_get_negotiation(f->inputs[0]);
+    return !strcmp(f->filter->name, neg->conversion_filter);
+}
+
+/**
+ * A list of pixel formats shared by some links, still to be reduced to one.
+ */
+typedef struct FormatChoice {
+    AVFilterFormats *formats;
+    int nb_links;
+    int pick;       ///< index of the chosen format, -1 if not chosen yet
+} FormatChoice;
+
+/**
+ * The formats on both sides of a conversion filter: the index of a choice,
+ * or -1 with the single format of the list.
+ */
+typedef struct FormatConversion {
+    int choice[2];
+    enum AVPixelFormat fixed[2];
+} FormatConversion;
+
+typedef struct FormatCostModel {
+    FormatChoice     *choices;
+    unsigned       nb_choices;
+    FormatConversion *convs;
+    unsigned       nb_convs;
+} FormatCostModel;
+
+static int conversion_format(const FormatCostModel *m, const FormatConversion *conv,
+                             int side, int choice, int pick)
+{
+    const FormatChoice *c;
+
+    if (conv->choice[side] < 0)
+        return conv->fixed[side];
+    c = &m->choices[conv->choice[side]];
+    if (conv->choice[side] == choice)
+        return c->formats->formats[pick];
+    return c->pick < 0 ? AV_PIX_FMT_NONE : c->formats->formats[c->pick];
+}
+
+/**
+ * Cost of picking a format for a choice, given the current picks of the
+ * other ones, ignoring the conversion skip and the ones not chosen yet.
+ */
+static int64_t choice_cost(const FormatCostModel *m, int choice, int pick, int skip)
+{
+    const FormatChoice *c = &m->choices[choice];
+    /* every frame is written and read once on every link */
+    int64_t cost = 2LL * c->nb_links * pix_fmt_bits(c->formats->formats[pick]);
+
+    for (int i = 0; i < m->nb_convs; i++) {
+        const FormatConversion *conv = &m->convs[i];
+        int src, dst;
+
+        if (i == skip || (conv->choice[0] != choice && conv->choice[1] != choice))
+            continue;
+        src = conversion_format(m, conv, 0, choice, pick);
+        dst = conversion_format(m, conv, 1, choice, pick);
+        if (src != AV_PIX_FMT_NONE && dst != AV_PIX_FMT_NONE)
+            cost += pix_fmt_conversion_cost(src, dst);
+    }
+    return cost;
+}
+
+static int pick_cheapest(const FormatCostModel *m, int choice)
+{
+    const FormatChoice *c = &m->choices[choice];
+    int64_t best_cost = INT64_MAX;
+    int best = c->pick;
+
+    if (best >= 0)
+        best_cost = choice_cost(m, choice, best, -1);
+    for (int i = 0; i < c->formats->nb_formats; i++) {
+        int64_t cost = choice_cost(m, choice, i, -1);
+        if (cost < best_cost) {
+            best_cost = cost;
+            best      = i;
+        }
+    }
+    return best;
+}
+
+/**
+ * Pick the formats on both sides of a conversion at once, which is needed to
+ * get out of choices that are only locally optimal.
+ */
+static int pick_cheapest_pair(FormatCostModel *m, int conv_idx)
+{
+    const FormatConversion *conv = &m->convs[conv_idx];
+    FormatChoice *a = &m->choices[conv->choice[0]];
+    FormatChoice *b = &m->choices[conv->choice[1]];
+    int64_t best_cost;
+    int best_a = a->pick, best_b = b->pick;
+
+    best_cost = choice_cost(m, conv->choice[0], a->pick, conv_idx) +
+                choice_cost(m, conv->choice[1], b->pick, conv_idx) +
+                pix_fmt_conversion_cost(a->formats->formats[a->pick],
+                                        b->formats->formats[b->pick]);
+
+    for (int i = 0; i < a->formats->nb_formats; i++) {
+        int64_t cost_a = choice_cost(m, conv->choice[0], i, conv_idx);
+        for (int j = 0; j < b->formats->nb_formats; j++) {
+            int64_t cost = cost_a + choice_cost(m, conv->choice[1], j, conv_idx) +
+                           pix_fmt_conversion_cost(a->formats->formats[i],
+                                                   b->formats->formats[j]);
+            if (cost < best_cost) {
+                best_cost = cost;
+                best_a    = i;
+                best_b    = j;
+            }
+        }
+    }
+
+    if (best_a == a->pick && best_b == b->pick)
+        return 0;
+    a->pick = best_a;
+    b->pick = best_b;
+    return 1;
+}
+
+static int add_format_choice(FormatCostModel *m, AVFilterGraph *graph,
+                             AVFilterFormats *formats)
+{
+    FormatChoice *c;
+
+    for (int i = 0; i < m->nb_choices; i++)
+        if (m->choices[i].formats == formats)
+            return i;
+
+    c = av_dynarray2_add((void **)&m->choices, &m->nb_choices, sizeof(*c), NULL);
+    if (!c)
+        return AVERROR(ENOMEM);
+    c->formats  = formats;
+    c->nb_links = 0;
+    c->pick     = -1;
+    for (int i = 0; i < graph->nb_filters; i++) {
+        AVFilterContext *f = graph->filters[i];
+        for (int j = 0; j < f->nb_outputs; j++)
+            c->nb_links += f->outputs[j]->incfg.formats == formats;
+    }
+    return c - m->choices;
+}
+
+/**
+ * Choose the pixel formats on both sides of the automatically inserted
+ * conversion filters so that the total estimated cost of the conversions and
+ * of the traffic on the links is minimal. Only the lists pick_formats() found
+ * no reference for are chosen, the first format would be picked otherwise.
+ */
+static int pick_conversion_formats(AVFilterGraph *graph)
+{
+    FormatCostModel m = { 0 };
+    int ret = 0, changed, iter = 0;
+
+    for (int i = 0; i < graph->nb_filters; i++) {
+        AVFilterContext *f = graph->filters[i];
+        AVFilterLink *links[2];
+        FormatConversion *conv;
+
+        if (!f->internal->auto_inserted || !is_conversion_filter(f))
+            continue;
+        links[0] = f->inputs[0];
+        links[1] = f->outputs[0];
+        if (!links[0]->incfg.formats || !links[1]->incfg.formats)
+            continue;
+
+        conv = av_dynarray2_add((void **)&m.convs, &m.nb_convs, sizeof(*conv), NULL);
+        if (!conv) {
+            ret = AVERROR(ENOMEM);
+            goto end;
+        }
+        for (int side = 0; side < 2; side++) {
+            AVFilterFormats *formats = links[side]->incfg.formats;
+
+            conv->choice[side] = -1;
+            conv->fixed[side]  = formats->nb_formats ? formats->formats[0] : AV_PIX_FMT_NONE;
+            if (formats->nb_formats > 1) {
+                ret = add_format_choice(&m, graph, formats);
+                if (ret < 0)
+                    goto end;
+                conv->choice[side] = ret;
+            }
+        }
+    }
+
+    for (int i = 0; i < m.nb_choices; i++)
+        m.choices[i].pick = pick_cheapest(&m, i);
+
+    do {
+        changed = 0;
+        for (int i = 0; i < m.nb_choices; i++) {
+            int pick = pick_cheapest(&m, i);
+            changed |= pick != m.choices[i].pick;
+            m.choices[i].pick = pick;
+        }
+        for (int i = 0; i < m.nb_convs; i++)
+            if (m.convs[i].choice[0] >= 0 && m.convs[i].choice[1] >= 0 &&
+                m.convs[i].choice[0] != m.convs[i].choice[1])
+                changed |= pick_cheapest_pair(&m, i);
+    } while (changed && ++iter < 16);
+
+    for (int i = 0; i < m.nb_choices; i++) {
+        FormatChoice *c = &m.choices[i];
+        av_log(graph, AV_LOG_DEBUG, "picking %s out of %d for %d links\n",
+               av_get_pix_fmt_name(c->formats->formats[c->pick]),
+               c->formats->nb_formats, c->nb_links);
+        c->formats->formats[0]  = c->formats->formats[c->pick];
+        c->formats->nb_formats  = 1;
+    }
+    ret = 0;
+
+end:
+    av_freep(&m.choices);
+    av_freep(&m.convs);
+    return ret;
+}
+
 static int pick_formats(AVFilterGraph *graph)
 {
     int i, j, ret;
@@ -1079,6 +1421,9 @@ static int pick_formats(AVFilterGraph *graph)
         }
     }while(change);
 
+    if ((ret = pick_conversion_formats(graph)) < 0)
+        return ret;
+
     for (i = 0; i < graph->nb_filters; i++) {
         AVFilterContext *filter = graph->filters[i];
 
@@ -1164,6 +1509,205 @@ static int graph_config_pointers(AVFilterGraph *graph, void *log_ctx)
     return 0;
 }
 
+/**
+ * Check whether a filter can be part of a run of fused filters, i.e. it has a
+ * single video input and output with the same properties, and no timeline.
+ */
+static int filter_is_fusable(AVFilterContext *f)
+{
+    AVFilterLink *inlink, *outlink;
+
+    if (f->nb_inputs != 1 || f->nb_outputs != 1 || f->enable_str ||
+        !f->filter->map_lut || f->filter->activate)
+        return 0;
+
+    inlink  = f->inputs[0];
+    outlink = f->outputs[0];
+    return inlink->type == AVMEDIA_TYPE_VIDEO &&
+           inlink->format == outlink->format &&
+           inlink->w == outlink->w && inlink->h == outlink->h;
+}
+
+static void fuse_run(AVFilterContext *head)
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(head->outputs[0]->format);
+    uint16_t *lut[4], *tmp[4] = { NULL };
+    AVFilterContext *f;
+
+    for (int comp = 0; comp < desc->nb_components; comp++) {
+        lut[comp] = head->filter->get_lut(head, comp);
+        tmp[comp] = av_malloc_array(1 << desc->comp[comp].depth, sizeof(*tmp[comp]));
+        if (!lut[comp] || !tmp[comp])
+            goto end;
+    }
+
+    /* the tables are mapped into copies first, so that they are left
+     * unchanged if the filter is not pointwise with its current options */
+    for (f = head->outputs[0]->dst; filter_is_fusable(f) && !f->internal->fused;
+         f = f->outputs[0]->dst) {
+        int ret = 0;
+
+        for (int comp = 0; comp < desc->nb_components && ret >= 0; comp++) {
+            int nb = 1 << desc->comp[comp].depth;
+
+            memcpy(tmp[comp], lut[comp], nb * sizeof(*tmp[comp]));
+            ret = f->filter->map_lut(f, comp, tmp[comp], nb);
+        }
+        if (ret < 0)
+            break;
+
+        for (int comp = 0; comp < desc->nb_components; comp++)
+            memcpy(lut[comp], tmp[comp],
+                   (1 << desc->comp[comp].depth) * sizeof(*lut[comp]));
+        f->internal->fused = 1;
+        av_log(f, AV_LOG_VERBOSE, "Fused into %s\n", head->name);
+    }
+
+end:
+    for (int comp = 0; comp < desc->nb_components; comp++)
+        av_freep(&tmp[comp]);
+}
+
+void ff_filter_graph_fuse(AVFilterGraph *graph)
+{
+    for (unsigned i = 0; i < graph->nb_filters; i++) {
+        AVFilterContext *f = graph->filters[i];
+
+        if (f->filter->get_lut && filter_is_fusable(f) && !f->internal->fused)
+            fuse_run(f);
+    }
+}
+
+static int refuse_run(AVFilterContext *head)
+{
+    AVFilterContext *f;
+    int ret = 0;
+
+    /* the runs may have been fused in any order, so the tables of all the
+     * filters which can be heads are computed again */
+    for (f = head; ; f = f->outputs[0]->dst) {
+        f->internal->fused = 0;
+        if (f->filter->get_lut) {
+            int err = f->inputs[0]->dstpad->config_props(f->inputs[0]);
+            if (err < 0)
+                ret = err;
+        }
+        if (f->nb_outputs != 1 || !f->outputs[0]->dst->internal->fused)
+            break;
+    }
+
+    if (ret >= 0)
+        ff_filter_graph_fuse(head->graph);
+
+    return ret;
+}
+
+int ff_filter_graph_refuse(AVFilterContext *filter)
+{
+    AVFilterGraph *graph = filter->graph;
+    AVFilterContext *head = filter;
+    int ret;
+
+    if (!graph || filter->nb_outputs != 1 || !filter->outputs[0] ||
+        (!filter->internal->fused && !filter->outputs[0]->dst->internal->fused))
+        return 0;
+
+    while (head->internal->fused)
+        head = head->inputs[0]->src;
+
+    /* A frame thread already holds the lock, and must not wait for the tables
+     * of the head to be unused: the run is then fused again once the job of
+     * the head is done. The old tables apply to the frame being filtered. */
+    if (ff_graph_frame_thread_worker(graph)) {
+        if (!head->internal->frame_thread_busy)
+            return refuse_run(head);
+        filter->internal->refuse_pending = 1;
+        graph->internal->refuse_pending  = 1;
+        return 0;
+    }
+
+    ff_graph_frame_thread_lock(graph);
+    /* the tables of the head may be in use by a frame thread */
+    ff_graph_frame_thread_wait(graph, head);
+    ret = refuse_run(head);
+    ff_graph_frame_thread_unlock(graph);
+
+    return ret;
+}
+
+void ff_filter_graph_refuse_pending(AVFilterGraph *graph)
+{
+    graph->internal->refuse_pending = 0;
+
+    for (unsigned i = 0; i < graph->nb_filters; i++) {
+        AVFilterContext *f = graph->filters[i];
+        int ret;
+
+        if (!f->internal->refuse_pending)
+            continue;
+        f->internal->refuse_pending = 0;
+
+        ret = ff_filter_graph_refuse(f);
+        if (ret < 0)
+            av_log(f, AV_LOG_ERROR, "Error fusing the filter again: %s\n",
+                   av_err2str(ret));
+    }
+}
+
+/**
+ * Log the pixel format conversions done by the graph with their estimated
+ * memory traffic per frame and the precision they lose.
+ */
+static void graph_dump_conversions(AVFilterGraph *graph)
+{
+    int64_t total = 0;
+    int nb_convs = 0;
+
+    if (av_log_get_level() < AV_LOG_VERBOSE)
+        return;
+
+    for (int i = 0; i < graph->nb_filters; i++) {
+        AVFilterContext *f = graph->filters[i];
+        AVFilterLink *in, *out;
+        char losses[128] = "";
+        int64_t bytes;
+        int loss;
+
+        if (!is_conversion_filter(f))
+            continue;
+        in  = f->inputs[0];
+        out = f->outputs[0];
+        if (in->format == out->format)
+            continue;
+
+        bytes = ((int64_t)in->w  * in->h  * pix_fmt_bits(in->format) +
+                 (int64_t)out->w * out->h * pix_fmt_bits(out->format)) / 8;
+        loss  = av_get_pix_fmt_loss(out->format, in->format, 1);
+        for (int j = 0; loss > 0 && j < FF_ARRAY_ELEMS(pix_fmt_losses); j++) {
+            if (loss & pix_fmt_losses[j].loss) {
+                av_strlcat(losses, *losses ? "," : " losing ", sizeof(losses));
+                av_strlcat(losses, pix_fmt_losses[j].name, sizeof(losses));
+            }
+        }
+        av_log(f, AV_LOG_VERBOSE, "Converting %s to %s, %"PRId64" KiB per frame%s\n",
+               av_get_pix_fmt_name(in->format), av_get_pix_fmt_name(out->format),
+               bytes >> 10, losses);
+        total += bytes;
+        nb_convs++;
+    }
+
+    if (nb_convs)
+        av_log(graph, AV_LOG_VERBOSE, "%d pixel format conversions, %"PRId64" KiB per frame\n",
+               nb_convs, total >> 10);
+}
+
+const AVFilterPoolStats *avfilter_graph_get_pool_stats(AVFilterGraph *graph)
+{
+    ff_buffer_cache_get_stats(graph->internal->buffer_cache,
+                              &graph->internal->pool_stats);
+    return &graph->internal->pool_stats;
+}
+
 int avfilter_graph_config(AVFilterGraph *graphctx, void *log_ctx)
 {
     int ret;
@@ -1174,23 +1718,26 @@ int avfilter_graph_config(AVFilterGraph *graphctx, void *log_ctx)
         return ret;
     if ((ret = graph_config_links(graphctx, log_ctx)))
         return ret;
+    graph_dump_conversions(graphctx);
     if ((ret = graph_check_links(graphctx, log_ctx)))
         return ret;
     if ((ret = graph_config_pointers(graphctx, log_ctx)))
         return ret;
+    ff_buffer_cache_set_max_size(graphctx->internal->buffer_cache,
+                                 graphctx->max_frame_pool_size);
+    ff_filter_graph_fuse(graphctx);
+    if ((ret = ff_graph_frame_thread_init(graphctx)))
+        return ret;
 
     return 0;
 }
 
-int avfilter_graph_send_command(AVFilterGraph *graph, const char *target, const char *cmd, const char *arg, char *res, int res_len, int flags)
+static int graph_send_command(AVFilterGraph *graph, const char *target, const char *cmd, const char *arg, char *res, int res_len, int flags)
 {
     int i, r = AVERROR(ENOSYS);
 
-    if (!graph)
-        return r;
-
     if ((flags & AVFILTER_CMD_FLAG_ONE) && !(flags & AVFILTER_CMD_FLAG_FAST)) {
-        r = avfilter_graph_send_command(graph, target, cmd, arg, res, res_len, flags | AVFILTER_CMD_FLAG_FAST);
+        r = graph_send_command(graph, target, cmd, arg, res, res_len, flags | AVFILTER_CMD_FLAG_FAST);
         if (r != AVERROR(ENOSYS))
             return r;
     }
@@ -1201,6 +1748,8 @@ int avfilter_graph_send_command(AVFilterGraph *graph, const char *target, const
     for (i = 0; i < graph->nb_filters; i++) {
         AVFilterContext *filter = graph->filters[i];
         if (!strcmp(target, "all") || (filter->name && !strcmp(target, filter->name)) || !strcmp(target, filter->filter->name)) {
+            /* the filter must not be processing a frame concurrently */
+            ff_graph_frame_thread_wait(graph, filter);
             r = avfilter_process_command(filter, cmd, arg, res, res_len, flags);
             if (r != AVERROR(ENOSYS)) {
                 if ((flags & AVFILTER_CMD_FLAG_ONE) || r < 0)
@@ -1212,12 +1761,23 @@ int avfilter_graph_send_command(AVFilterGraph *graph, const char *target, const
     return r;
 }
 
-int avfilter_graph_queue_command(AVFilterGraph *graph, const char *target, const char *command, const char *arg, int flags, double ts)
+int avfilter_graph_send_command(AVFilterGraph *graph, const char *target, const char *cmd, const char *arg, char *res, int res_len, int flags)
 {
-    int i;
+    int ret;
 
-    if(!graph)
-        return 0;
+    if (!graph)
+        return AVERROR(ENOSYS);
+
+    ff_graph_frame_thread_lock(graph);
+    ret = graph_send_command(graph, target, cmd, arg, res, res_len, flags);
+    ff_graph_frame_thread_unlock(graph);
+
+    return ret;
+}
+
+static int graph_queue_command(AVFilterGraph *graph, const char *target, const char *command, const char *arg, int flags, double ts)
+{
+    int i;
 
     for (i = 0; i < graph->nb_filters; i++) {
         AVFilterContext *filter = graph->filters[i];
@@ -1243,6 +1803,20 @@ int avfilter_graph_queue_command(AVFilterGraph *graph, const char *target, const
     return 0;
 }
 
+int avfilter_graph_queue_command(AVFilterGraph *graph, const char *target, const char *command, const char *arg, int flags, double ts)
+{
+    int ret;
+
+    if(!graph)
+        return 0;
+
+    ff_graph_frame_thread_lock(graph);
+    ret = graph_queue_command(graph, target, command, arg, flags, ts);
+    ff_graph_frame_thread_unlock(graph);
+
+    return ret;
+}
+
 static void heap_bubble_up(AVFilterGraph *graph,
                            AVFilterLink *link, int index)
 {
@@ -1292,7 +1866,7 @@ void ff_avfilter_graph_update_heap(AVFilterGraph *graph, AVFilterLink *link)
     heap_bubble_down(graph, link, link->age_index);
 }
 
-int avfilter_graph_request_oldest(AVFilterGraph *graph)
+static int graph_request_oldest(AVFilterGraph *graph)
 {
     AVFilterLink *oldest = graph->sink_links[0];
     int64_t frame_count;
@@ -1337,17 +1911,47 @@ int avfilter_graph_request_oldest(AVFilterGraph *graph)
     return 0;
 }
 
-int ff_filter_graph_run_once(AVFilterGraph *graph)
+int avfilter_graph_request_oldest(AVFilterGraph *graph)
+{
+    int ret;
+
+    ff_graph_frame_thread_lock(graph);
+    ret = graph_request_oldest(graph);
+    ff_graph_frame_thread_unlock(graph);
+
+    return ret;
+}
+
+static int graph_run_once(AVFilterGraph *graph, int wait)
 {
     AVFilterContext *filter;
     unsigned i;
+    int ret;
 
     av_assert0(graph->nb_filters);
-    filter = graph->filters[0];
-    for (i = 1; i < graph->nb_filters; i++)
-        if (graph->filters[i]->ready > filter->ready)
-            filter = graph->filters[i];
-    if (!filter->ready)
-        return AVERROR(EAGAIN);
-    return ff_filter_activate(filter);
+    while (1) {
+        /* filters busy in frame threads are activated again when done */
+        filter = NULL;
+        for (i = 0; i < graph->nb_filters; i++)
+            if (!graph->filters[i]->internal->frame_thread_busy &&
+                (!filter || graph->filters[i]->ready > filter->ready))
+                filter = graph->filters[i];
+        if (filter && filter->ready)
+            return ff_filter_activate(filter);
+        if (!wait)
+            return AVERROR(EAGAIN);
+        ret = ff_graph_frame_thread_wait(graph, NULL);
+        if (ret < 0)
+            return ret;
+    }
+}
+
+int ff_filter_graph_run_once(AVFilterGraph *graph)
+{
+    return graph_run_once(graph, 1);
+}
+
+int ff_filter_graph_run_ready(AVFilterGraph *graph)
+{
+    return graph_run_once(graph, 0);
 }
@@ -38,6 +38,7 @@
 #include "buffersink.h"
 #include "filters.h"
 #include "internal.h"
+#include "thread.h"
 
 typedef struct BufferSinkContext {
     const AVClass *class;
@@ -110,7 +111,7 @@ static int return_or_keep_frame(BufferSinkContext *buf, AVFrame *out, AVFrame *i
     }
 }
 
-static int get_frame_internal(AVFilterContext *ctx, AVFrame *frame, int flags, int samples)
+static int get_frame_locked(AVFilterContext *ctx, AVFrame *frame, int flags, int samples)
 {
     BufferSinkContext *buf = ctx->priv;
     AVFilterLink *inlink = ctx->inputs[0];
@@ -143,6 +144,17 @@ static int get_frame_internal(AVFilterContext *ctx, AVFrame *frame, int flags, i
     }
 }
 
+static int get_frame_internal(AVFilterContext *ctx, AVFrame *frame, int flags, int samples)
+{
+    int ret;
+
+    ff_graph_frame_thread_lock(ctx->graph);
+    ret = get_frame_locked(ctx, frame, flags, samples);
+    ff_graph_frame_thread_unlock(ctx->graph);
+
+    return ret;
+}
+
 int attribute_align_arg av_buffersink_get_frame_flags(AVFilterContext *ctx, AVFrame *frame, int flags)
 {
     return get_frame_internal(ctx, frame, flags, ctx->inputs[0]->min_samples);
@@ -38,6 +38,7 @@
 #include "buffersrc.h"
 #include "formats.h"
 #include "internal.h"
+#include "thread.h"
 #include "video.h"
 
 typedef struct BufferSourceContext {
@@ -161,12 +162,15 @@ int attribute_align_arg av_buffersrc_add_frame(AVFilterContext *ctx, AVFrame *fr
     return av_buffersrc_add_frame_flags(ctx, frame, 0);
 }
 
-static int push_frame(AVFilterGraph *graph)
+static int push_frame(AVFilterGraph *graph, int wait)
 {
     int ret;
 
     while (1) {
-        ret = ff_filter_graph_run_once(graph);
+        /* when frame threading, only wait for the work in progress in the
+         * frame threads to finish at EOF */
+        ret = wait ? ff_filter_graph_run_once(graph) :
+                     ff_filter_graph_run_ready(graph);
         if (ret == AVERROR(EAGAIN))
             break;
         if (ret < 0)
@@ -175,7 +179,7 @@ static int push_frame(AVFilterGraph *graph)
     return 0;
 }
 
-int attribute_align_arg av_buffersrc_add_frame_flags(AVFilterContext *ctx, AVFrame *frame, int flags)
+static int add_frame(AVFilterContext *ctx, AVFrame *frame, int flags)
 {
     BufferSourceContext *s = ctx->priv;
     AVFrame *copy;
@@ -255,7 +259,7 @@ FF_ENABLE_DEPRECATION_WARNINGS
         return ret;
 
     if ((flags & AV_BUFFERSRC_FLAG_PUSH)) {
-        ret = push_frame(ctx->graph);
+        ret = push_frame(ctx->graph, 0);
         if (ret < 0)
             return ret;
     }
@@ -263,13 +267,32 @@ FF_ENABLE_DEPRECATION_WARNINGS
     return 0;
 }
 
+int attribute_align_arg av_buffersrc_add_frame_flags(AVFilterContext *ctx, AVFrame *frame, int flags)
+{
+    int ret;
+
+    ff_graph_frame_thread_lock(ctx->graph);
+    ret = add_frame(ctx, frame, flags);
+    ff_graph_frame_thread_unlock(ctx->graph);
+
+    return ret;
+}
+
 int av_buffersrc_close(AVFilterContext *ctx, int64_t pts, unsigned flags)
 {
     BufferSourceContext *s = ctx->priv;
+    int ret = 0;
+
+    ff_graph_frame_thread_lock(ctx->graph);
 
     s->eof = 1;
     ff_avfilter_link_set_in_status(ctx->outputs[0], AVERROR_EOF, pts);
-    return (flags & AV_BUFFERSRC_FLAG_PUSH) ? push_frame(ctx->graph) : 0;
+    if (flags & AV_BUFFERSRC_FLAG_PUSH)
+        ret = push_frame(ctx->graph, 1);
+
+    ff_graph_frame_thread_unlock(ctx->graph);
+
+    return ret;
 }
 
 static av_cold int init_video(AVFilterContext *ctx)
@@ -78,6 +78,7 @@ enum {
     MODE_TIME_DELTA = 1 << 13,
     MODE_FC_DELTA = 1 << 14,
     MODE_SC_DELTA = 1 << 15,
+    MODE_PROFILE = 1 << 16,
 };
 
 #define OFFSET(x) offsetof(GraphMonitorContext, x)
@@ -110,6 +111,7 @@ static const AVOption graphmonitor_options[] = {
         { "sample_count_in",  NULL, 0, AV_OPT_TYPE_CONST, {.i64=MODE_SCOUT},   0, 0, VF, "flags" },
         { "sample_count_out", NULL, 0, AV_OPT_TYPE_CONST, {.i64=MODE_SCIN},    0, 0, VF, "flags" },
         { "sample_count_delta",NULL,0, AV_OPT_TYPE_CONST, {.i64=MODE_SC_DELTA},0, 0, VF, "flags" },
+        { "profile",          NULL, 0, AV_OPT_TYPE_CONST, {.i64=MODE_PROFILE}, 0, 0, VF, "flags" },
     { "rate", "set video rate", OFFSET(frame_rate), AV_OPT_TYPE_VIDEO_RATE, {.str = "25"}, 0, INT_MAX, VF },
     { "r",    "set video rate", OFFSET(frame_rate), AV_OPT_TYPE_VIDEO_RATE, {.str = "25"}, 0, INT_MAX, VF },
     { NULL }
@@ -351,6 +353,18 @@ static int create_frame(AVFilterContext *ctx, int64_t pts)
         drawtext(out, xpos, ypos, filter->name, s->white);
         xpos += strlen(filter->name) * 8 + 10;
         drawtext(out, xpos, ypos, filter->filter->name, s->white);
+        xpos += strlen(filter->filter->name) * 8;
+        if (s->flags & MODE_PROFILE) {
+            const AVFilterProfile *p = avfilter_get_profile(filter);
+
+            if (p) {
+                snprintf(buffer, sizeof(buffer)-1,
+                         " | calls: %"PRId64" | time: %.3f | blocked: %.3f | alloc: %"PRId64" KiB | copies: %"PRId64,
+                         p->nb_calls, p->time / 1000000., p->time_blocked / 1000000.,
+                         p->bytes_alloc >> 10, p->nb_copies);
+                drawtext(out, xpos, ypos, buffer, s->white);
+            }
+        }
         ypos += 10;
         for (int j = 0; j < filter->nb_inputs; j++) {
             AVFilterLink *l = filter->inputs[j];
@@ -18,6 +18,8 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <stdatomic.h>
+
 #include "framepool.h"
 #include "libavutil/avassert.h"
 #include "libavutil/avutil.h"
@@ -26,6 +28,316 @@
 #include "libavutil/imgutils.h"
 #include "libavutil/mem.h"
 #include "libavutil/pixfmt.h"
+#include "libavutil/thread.h"
+
+typedef struct CacheBucket CacheBucket;
+
+/* a buffer of a bucket, allocated once and kept with it while idle */
+typedef struct CacheEntry {
+    CacheBucket *bucket;
+    AVBufferRef *buf;
+} CacheEntry;
+
+struct CacheBucket {
+    /* set once, protected by the lock of the cache while linked */
+    CacheBucket *next;
+    FFBufferCache *cache;
+    size_t size;
+    AVBufferRef* (*alloc)(size_t size);
+
+    /* one for every pool using the bucket and every buffer in use; only
+     * incremented from 0 and decremented to 0 with the lock of the cache */
+    atomic_uint refcount;
+
+    /* protects all the fields below */
+    AVMutex lock;
+    CacheEntry **idle;
+    int nb_idle;
+    int64_t hits;
+    int64_t misses;
+    int64_t trimmed;
+};
+
+struct FFBufferCache {
+    /* protects the list of buckets and the fields below it */
+    AVMutex lock;
+    CacheBucket *buckets;
+    /* one for the owner, one for every bucket */
+    unsigned refcount;
+    /* counters of the pruned buckets */
+    AVFilterPoolStats stats;
+
+    atomic_int closed;
+    atomic_size_t max_size;
+    atomic_size_t size;
+    atomic_size_t peak_size;
+};
+
+FFBufferCache *ff_buffer_cache_alloc(void)
+{
+    FFBufferCache *cache = av_mallocz(sizeof(*cache));
+    if (!cache)
+        return NULL;
+
+    if (ff_mutex_init(&cache->lock, NULL)) {
+        av_free(cache);
+        return NULL;
+    }
+    cache->refcount = 1;
+    atomic_init(&cache->closed, 0);
+    atomic_init(&cache->max_size, 0);
+    atomic_init(&cache->size, 0);
+    atomic_init(&cache->peak_size, 0);
+
+    return cache;
+}
+
+static void cache_destroy(FFBufferCache *cache)
+{
+    ff_mutex_destroy(&cache->lock);
+    av_free(cache);
+}
+
+/* must be called with the lock of the bucket */
+static void bucket_free_idle(CacheBucket *b)
+{
+    CacheEntry *e = b->idle[--b->nb_idle];
+
+    av_buffer_unref(&e->buf);
+    av_free(e);
+    atomic_fetch_sub(&b->cache->size, b->size);
+}
+
+/* Unlink and free the bucket if it is unused and has no idle buffers, so that
+ * the list only holds the sizes still in use. Must be called with the lock of
+ * the cache. Returns 1 if the cache is to be destroyed. */
+static int bucket_prune(FFBufferCache *cache, CacheBucket *b)
+{
+    CacheBucket **pb;
+
+    if (atomic_load(&b->refcount) || b->nb_idle)
+        return 0;
+
+    for (pb = &cache->buckets; *pb != b; pb = &(*pb)->next)
+        ;
+    *pb = b->next;
+
+    cache->stats.hits    += b->hits;
+    cache->stats.misses  += b->misses;
+    cache->stats.trimmed += b->trimmed;
+
+    ff_mutex_destroy(&b->lock);
+    av_free(b->idle);
+    av_free(b);
+
+    return !--cache->refcount;
+}
+
+/* free idle buffers until the total size fits, to make room for the sizes
+ * in use now; must be called with the lock of the cache */
+static int cache_trim(FFBufferCache *cache)
+{
+    size_t max_size = atomic_load(&cache->max_size);
+    CacheBucket *b, *next;
+    int destroy = 0;
+
+    for (b = cache->buckets; b; b = next) {
+        next = b->next;
+
+        ff_mutex_lock(&b->lock);
+        while (b->nb_idle && max_size && atomic_load(&cache->size) > max_size) {
+            bucket_free_idle(b);
+            b->trimmed++;
+        }
+        ff_mutex_unlock(&b->lock);
+
+        destroy |= bucket_prune(cache, b);
+    }
+    return destroy;
+}
+
+/* Get the bucket of the buffers of the given size and allocator, with a new
+ * reference to it. */
+static CacheBucket *bucket_get(FFBufferCache *cache, size_t size,
+                               AVBufferRef* (*alloc)(size_t size))
+{
+    CacheBucket *b;
+
+    ff_mutex_lock(&cache->lock);
+
+    for (b = cache->buckets; b; b = b->next)
+        if (b->size == size && b->alloc == alloc)
+            break;
+    if (!b) {
+        b = av_mallocz(sizeof(*b));
+        if (!b)
+            goto end;
+        if (ff_mutex_init(&b->lock, NULL)) {
+            av_freep(&b);
+            goto end;
+        }
+        b->cache = cache;
+        b->size  = size;
+        b->alloc = alloc;
+        atomic_init(&b->refcount, 0);
+        b->next  = cache->buckets;
+        cache->buckets = b;
+        cache->refcount++;
+    }
+    atomic_fetch_add(&b->refcount, 1);
+
+end:
+    ff_mutex_unlock(&cache->lock);
+    return b;
+}
+
+static void bucket_unref(CacheBucket *b)
+{
+    FFBufferCache *cache = b->cache;
+    unsigned refcount = atomic_load(&b->refcount);
+    int destroy = 0;
+
+    /* the bucket stays in use, no need for the lock of the cache */
+    while (refcount > 1)
+        if (atomic_compare_exchange_weak(&b->refcount, &refcount, refcount - 1))
+            return;
+
+    ff_mutex_lock(&cache->lock);
+    if (atomic_fetch_sub(&b->refcount, 1) == 1)
+        destroy = bucket_prune(cache, b);
+    ff_mutex_unlock(&cache->lock);
+
+    if (destroy)
+        cache_destroy(cache);
+}
+
+static void cache_release(void *opaque, uint8_t *data)
+{
+    CacheEntry *e = opaque;
+    CacheBucket *b = e->bucket;
+    FFBufferCache *cache = b->cache;
+    size_t max_size = atomic_load(&cache->max_size);
+    int closed = atomic_load(&cache->closed);
+
+    ff_mutex_lock(&b->lock);
+    if (closed || (max_size && atomic_load(&cache->size) > max_size) ||
+        av_dynarray_add_nofree(&b->idle, &b->nb_idle, e) < 0) {
+        av_buffer_unref(&e->buf);
+        av_free(e);
+        atomic_fetch_sub(&cache->size, b->size);
+        b->trimmed += !closed;
+    }
+    ff_mutex_unlock(&b->lock);
+
+    bucket_unref(b);
+}
+
+static AVBufferRef *cache_get(CacheBucket *b)
+{
+    FFBufferCache *cache = b->cache;
+    AVBufferRef *buf;
+    CacheEntry *e = NULL;
+
+    ff_mutex_lock(&b->lock);
+    if (b->nb_idle) {
+        e = b->idle[--b->nb_idle];
+        b->hits++;
+    }
+    ff_mutex_unlock(&b->lock);
+
+    if (!e) {
+        size_t max_size = atomic_load(&cache->max_size);
+        size_t size, peak_size;
+
+        e = av_mallocz(sizeof(*e));
+        if (!e)
+            return NULL;
+        e->bucket = b;
+        e->buf    = b->alloc ? b->alloc(b->size) : av_buffer_alloc(b->size);
+        if (!e->buf) {
+            av_free(e);
+            return NULL;
+        }
+
+        size      = atomic_fetch_add(&cache->size, b->size) + b->size;
+        peak_size = atomic_load(&cache->peak_size);
+        while (size > peak_size &&
+               !atomic_compare_exchange_weak(&cache->peak_size, &peak_size, size))
+            ;
+
+        ff_mutex_lock(&b->lock);
+        b->misses++;
+        ff_mutex_unlock(&b->lock);
+
+        /* the bucket is in use, the trimming cannot destroy the cache */
+        if (max_size && size > max_size) {
+            ff_mutex_lock(&cache->lock);
+            cache_trim(cache);
+            ff_mutex_unlock(&cache->lock);
+        }
+    }
+    atomic_fetch_add(&b->refcount, 1);
+
+    buf = av_buffer_create(e->buf->data, b->size, cache_release, e, 0);
+    if (!buf)
+        cache_release(e, NULL);
+    return buf;
+}
+
+void ff_buffer_cache_unref(FFBufferCache **pcache)
+{
+    FFBufferCache *cache = *pcache;
+    CacheBucket *b, *next;
+    int destroy = 0;
+
+    if (!cache)
+        return;
+    *pcache = NULL;
+
+    ff_mutex_lock(&cache->lock);
+    atomic_store(&cache->closed, 1);
+    for (b = cache->buckets; b; b = next) {
+        next = b->next;
+
+        ff_mutex_lock(&b->lock);
+        while (b->nb_idle)
+            bucket_free_idle(b);
+        ff_mutex_unlock(&b->lock);
+
+        destroy |= bucket_prune(cache, b);
+    }
+    destroy |= !--cache->refcount;
+    ff_mutex_unlock(&cache->lock);
+
+    if (destroy)
+        cache_destroy(cache);
+}
+
+void ff_buffer_cache_set_max_size(FFBufferCache *cache, int64_t max_size)
+{
+    ff_mutex_lock(&cache->lock);
+    atomic_store(&cache->max_size, FFMIN((uint64_t)max_size, SIZE_MAX));
+    /* the owner holds a reference, the cache cannot be destroyed here */
+    cache_trim(cache);
+    ff_mutex_unlock(&cache->lock);
+}
+
+void ff_buffer_cache_get_stats(FFBufferCache *cache, AVFilterPoolStats *stats)
+{
+    ff_mutex_lock(&cache->lock);
+    *stats = cache->stats;
+    for (CacheBucket *b = cache->buckets; b; b = b->next) {
+        ff_mutex_lock(&b->lock);
+        stats->hits      += b->hits;
+        stats->misses    += b->misses;
+        stats->trimmed   += b->trimmed;
+        stats->idle_size += (int64_t)b->nb_idle * b->size;
+        ff_mutex_unlock(&b->lock);
+    }
+    ff_mutex_unlock(&cache->lock);
+    stats->size      = atomic_load(&cache->size);
+    stats->peak_size = atomic_load(&cache->peak_size);
+}
 
 struct FFFramePool {
 
@@ -46,9 +358,22 @@ struct FFFramePool {
     int linesize[4];
     AVBufferPool *pools[4];
 
+    /* buffers come from the buckets of the cache instead of the pools if
+     * set */
+    FFBufferCache *cache;
+    CacheBucket *buckets[4];
+    size_t sizes[4];
 };
 
+static AVBufferRef *pool_get_buffer(FFFramePool *pool, int i)
+{
+    if (pool->cache)
+        return cache_get(pool->buckets[i]);
+    return av_buffer_pool_get(pool->pools[i]);
+}
+
 FFFramePool *ff_frame_pool_video_init(AVBufferRef* (*alloc)(size_t size),
+                                      FFBufferCache *cache,
                                       int width,
                                       int height,
                                       enum AVPixelFormat format,
@@ -96,11 +421,16 @@ FFFramePool *ff_frame_pool_video_init(AVBufferRef* (*alloc)(size_t size),
         goto fail;
     }
 
+    pool->cache = cache;
     for (i = 0; i < 4 && sizes[i]; i++) {
         if (sizes[i] > SIZE_MAX - align)
             goto fail;
-        pool->pools[i] = av_buffer_pool_init(sizes[i] + align, alloc);
-        if (!pool->pools[i])
+        pool->sizes[i] = sizes[i] + align;
+        if (cache)
+            pool->buckets[i] = bucket_get(cache, pool->sizes[i], alloc);
+        else
+            pool->pools[i] = av_buffer_pool_init(pool->sizes[i], alloc);
+        if (!pool->buckets[i] && !pool->pools[i])
             goto fail;
     }
 
@@ -112,6 +442,7 @@ fail:
 }
 
 FFFramePool *ff_frame_pool_audio_init(AVBufferRef* (*alloc)(size_t size),
+                                      FFBufferCache *cache,
                                       int channels,
                                       int nb_samples,
                                       enum AVSampleFormat format,
@@ -138,8 +469,13 @@ FFFramePool *ff_frame_pool_audio_init(AVBufferRef* (*alloc)(size_t size),
     if (ret < 0)
         goto fail;
 
-    pool->pools[0] = av_buffer_pool_init(pool->linesize[0], NULL);
-    if (!pool->pools[0])
+    pool->cache    = cache;
+    pool->sizes[0] = pool->linesize[0];
+    if (cache)
+        pool->buckets[0] = bucket_get(cache, pool->sizes[0], alloc);
+    else
+        pool->pools[0] = av_buffer_pool_init(pool->sizes[0], alloc);
+    if (!pool->buckets[0] && !pool->pools[0])
         goto fail;
 
     return pool;
@@ -211,10 +547,10 @@ AVFrame *ff_frame_pool_get(FFFramePool *pool)
 
         for (i = 0; i < 4; i++) {
             frame->linesize[i] = pool->linesize[i];
-            if (!pool->pools[i])
+            if (!pool->sizes[i])
                 break;
 
-            frame->buf[i] = av_buffer_pool_get(pool->pools[i]);
+            frame->buf[i] = pool_get_buffer(pool, i);
             if (!frame->buf[i])
                 goto fail;
 
@@ -257,13 +593,13 @@ FF_ENABLE_DEPRECATION_WARNINGS
         }
 
         for (i = 0; i < FFMIN(pool->planes, AV_NUM_DATA_POINTERS); i++) {
-            frame->buf[i] = av_buffer_pool_get(pool->pools[0]);
+            frame->buf[i] = pool_get_buffer(pool, 0);
             if (!frame->buf[i])
                 goto fail;
             frame->extended_data[i] = frame->data[i] = frame->buf[i]->data;
         }
         for (i = 0; i < frame->nb_extended_buf; i++) {
-            frame->extended_buf[i] = av_buffer_pool_get(pool->pools[0]);
+            frame->extended_buf[i] = pool_get_buffer(pool, 0);
             if (!frame->extended_buf[i])
                 goto fail;
             frame->extended_data[i + AV_NUM_DATA_POINTERS] = frame->extended_buf[i]->data;
@@ -289,6 +625,8 @@ void ff_frame_pool_uninit(FFFramePool **pool)
 
     for (i = 0; i < 4; i++) {
         av_buffer_pool_uninit(&(*pool)->pools[i]);
+        if ((*pool)->buckets[i])
+            bucket_unref((*pool)->buckets[i]);
     }
 
     av_freep(pool);
@@ -25,6 +25,48 @@
 #include "libavutil/frame.h"
 #include "libavutil/internal.h"
 
+#include "avfilter.h"
+
+/**
+ * Buffer cache shared by the frame pools of a graph. Buffers of the same size
+ * and allocator are reused across all the pools using the cache. Each size
+ * has its own lock, and is dropped once it is unused and has no idle buffers
+ * left. This structure is opaque,
+ * it is allocated with ff_buffer_cache_alloc() and released with
+ * ff_buffer_cache_unref(). It stays alive until all the buffers obtained from
+ * it are freed.
+ */
+typedef struct FFBufferCache FFBufferCache;
+
+/**
+ * Allocate a buffer cache.
+ *
+ * @return the new cache on success, NULL on error.
+ */
+FFBufferCache *ff_buffer_cache_alloc(void);
+
+/**
+ * Release the reference to the cache held by its owner. The idle buffers are
+ * freed, and so are the buffers still in use when they get released.
+ *
+ * @param cache pointer to the cache to be released. It will be set to NULL.
+ */
+void ff_buffer_cache_unref(FFBufferCache **cache);
+
+/**
+ * Set the maximum total size of the buffers of the cache, in use or idle.
+ * Idle buffers are freed instead of being kept when it is exceeded. Buffers
+ * are still allocated when they are needed.
+ *
+ * @param max_size maximum size in bytes, 0 for no limit
+ */
+void ff_buffer_cache_set_max_size(FFBufferCache *cache, int64_t max_size);
+
+/**
+ * Get a snapshot of the statistics of the cache.
+ */
+void ff_buffer_cache_get_stats(FFBufferCache *cache, AVFilterPoolStats *stats);
+
 /**
  * Frame pool. This structure is opaque and not meant to be accessed
  * directly. It is allocated with ff_frame_pool_init() and freed with
@@ -38,6 +80,9 @@ typedef struct FFFramePool FFFramePool;
  * @param alloc a function that will be used to allocate new frame buffers when
  * the pool is empty. May be NULL, then the default allocator will be used
  * (av_buffer_alloc()).
+ * @param cache if not NULL, the frame buffers are obtained from this cache,
+ * which allocates them with alloc and only reuses them for pools with the
+ * same alloc. The cache must outlive the pool.
  * @param width width of each frame in this pool
  * @param height height of each frame in this pool
  * @param format format of each frame in this pool
@@ -45,6 +90,7 @@ typedef struct FFFramePool FFFramePool;
  * @return newly created video frame pool on success, NULL on error.
  */
 FFFramePool *ff_frame_pool_video_init(AVBufferRef* (*alloc)(size_t size),
+                                      FFBufferCache *cache,
                                       int width,
                                       int height,
                                       enum AVPixelFormat format,
@@ -56,6 +102,9 @@ FFFramePool *ff_frame_pool_video_init(AVBufferRef* (*alloc)(size_t size),
  * @param alloc a function that will be used to allocate new frame buffers when
  * the pool is empty. May be NULL, then the default allocator will be used
  * (av_buffer_alloc()).
+ * @param cache if not NULL, the frame buffers are obtained from this cache,
+ * which allocates them with alloc and only reuses them for pools with the
+ * same alloc. The cache must outlive the pool.
  * @param channels channels of each frame in this pool
  * @param nb_samples number of samples of each frame in this pool
  * @param format format of each frame in this pool
@@ -63,6 +112,7 @@ FFFramePool *ff_frame_pool_video_init(AVBufferRef* (*alloc)(size_t size),
  * @return newly created audio frame pool on success, NULL on error.
  */
 FFFramePool *ff_frame_pool_audio_init(AVBufferRef* (*alloc)(size_t size),
+                                      FFBufferCache *cache,
                                       int channels,
                                       int samples,
                                       enum AVSampleFormat format,
@@ -72,6 +72,14 @@ struct AVFilterPad {
      */
 #define AVFILTERPAD_FLAG_FREE_NAME                       (1 << 1)
 
+    /**
+     * The filter processes the frames from its input link in place when
+     * they are writable, and outputs new frames otherwise.
+     *
+     * input pads only.
+     */
+#define AVFILTERPAD_FLAG_PREFERS_WRITABLE                (1 << 2)
+
     /**
      * A combination of AVFILTERPAD_FLAG_* flags.
      */
@@ -133,12 +141,43 @@ struct AVFilterGraphInternal {
     void *thread;
     avfilter_execute_func *thread_execute;
     FFFrameQueueGlobal frame_queues;
+    /* frame threading context, NULL when frame threading is not used */
+    void *frame_thread;
+    /* buffers of the frame pools of all the links */
+    struct FFBufferCache *buffer_cache;
+    AVFilterPoolStats pool_stats;
+    /* set when ff_filter_graph_refuse() was deferred for some filters */
+    int refuse_pending;
 };
 
 struct AVFilterInternal {
     avfilter_execute_func *execute;
+    /* set while a filter_frame() callback runs in a frame thread */
+    int frame_thread_busy;
+    /* set when the lookup table of the filter has been composed into the one
+     * of the preceding filter, frames are then passed through unchanged */
+    int fused;
+    /* set when the run the filter belongs to must be fused again, after a
+     * command was processed in a frame thread while the head of the run was
+     * busy */
+    int refuse_pending;
+    /* only updated when the graph is profiled */
+    AVFilterProfile profile;
+    /* nesting level of the get_buffer() callbacks of the filter */
+    int get_buffer_depth;
+    /* set for the conversion filters inserted by query_formats() */
+    int auto_inserted;
 };
 
+/**
+ * Check whether the filter_frame() callbacks of a filter run in frame threads.
+ */
+static av_always_inline int ff_filter_frame_threaded(const AVFilterContext *ctx)
+{
+    return ctx->thread_type & AVFILTER_THREAD_FRAME &&
+           ctx->graph->internal->frame_thread;
+}
+
 static av_always_inline int ff_filter_execute(AVFilterContext *ctx, avfilter_action_func *func,
                                               void *arg, int *ret, int nb_jobs)
 {
@@ -358,6 +397,43 @@ AVFilterContext *ff_filter_alloc(const AVFilter *filter, const char *inst_name);
 
 int ff_filter_activate(AVFilterContext *filter);
 
+/**
+ * Account to the profile of a filter a call which started processing at time
+ * start, after waiting blocked microseconds for a thread.
+ */
+void ff_filter_profile_call(AVFilterContext *ctx, int64_t start, int64_t blocked);
+
+/**
+ * Account to the profile of the source of a link a frame obtained for it,
+ * unless it was requested by a get_buffer() callback of the source, on behalf
+ * of a filter further upstream.
+ */
+void ff_filter_profile_alloc(AVFilterLink *link, const AVFrame *frame);
+
+/**
+ * Update the link state after a filter_frame() callback run in a frame thread
+ * returned ret, like it is done after the synchronous calls.
+ */
+void ff_filter_frame_thread_done(AVFilterLink *link, int ret);
+
+/**
+ * Fuse the runs of pointwise filters of a configured graph, by composing the
+ * lookup tables of each filter of a run into the first one.
+ */
+void ff_filter_graph_fuse(AVFilterGraph *graph);
+
+/**
+ * Restore the runs of fused filters a filter belongs to after its parameters
+ * changed, and fuse them again.
+ */
+int ff_filter_graph_refuse(AVFilterContext *filter);
+
+/**
+ * Run the ff_filter_graph_refuse() calls deferred by frame threads. Must be
+ * called with the graph locked.
+ */
+void ff_filter_graph_refuse_pending(AVFilterGraph *graph);
+
 /**
  * Remove a filter from a graph;
  */
@@ -371,9 +447,19 @@ void ff_filter_graph_remove_filter(AVFilterGraph *graph, AVFilterContext *filter
 
 /**
  * Run one round of processing on a filter graph.
+ *
+ * When no filter can be activated but some are busy in frame threads, wait
+ * for one of them to finish.
  */
 int ff_filter_graph_run_once(AVFilterGraph *graph);
 
+/**
+ * Same as ff_filter_graph_run_once(), but return AVERROR(EAGAIN) instead of
+ * waiting when the only filters that could make progress are busy in frame
+ * threads.
+ */
+int ff_filter_graph_run_ready(AVFilterGraph *graph);
+
 /**
  * Get number of threads for current filter instance.
  * This number is always same or less than graph->nb_threads.
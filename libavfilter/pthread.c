@@ -23,12 +23,19 @@
 
 #include <stddef.h>
 
+#include "libavutil/cpu.h"
 #include "libavutil/error.h"
+#include "libavutil/fifo.h"
+#include "libavutil/frame.h"
+#include "libavutil/log.h"
 #include "libavutil/macros.h"
 #include "libavutil/mem.h"
 #include "libavutil/slicethread.h"
+#include "libavutil/thread.h"
+#include "libavutil/time.h"
 
 #include "avfilter.h"
+#include "filters.h"
 #include "internal.h"
 #include "thread.h"
 
@@ -37,6 +44,9 @@ typedef struct ThreadContext {
     AVSliceThread *thread;
     avfilter_action_func *func;
 
+    /* serializes execute calls made from different frame threads */
+    pthread_mutex_t execute_lock;
+
     /* per-execute parameters */
     AVFilterContext *ctx;
     void *arg;
@@ -54,6 +64,7 @@ static void worker_func(void *priv, int jobnr, int threadnr, int nb_jobs, int nb
 static void slice_thread_uninit(ThreadContext *c)
 {
     avpriv_slicethread_free(&c->thread);
+    pthread_mutex_destroy(&c->execute_lock);
 }
 
 static int thread_execute(AVFilterContext *ctx, avfilter_action_func *func,
@@ -63,20 +74,33 @@ static int thread_execute(AVFilterContext *ctx, avfilter_action_func *func,
 
     if (nb_jobs <= 0)
         return 0;
+
+    pthread_mutex_lock(&c->execute_lock);
+
     c->ctx         = ctx;
     c->arg         = arg;
     c->func        = func;
     c->rets        = ret;
 
     avpriv_slicethread_execute(c->thread, nb_jobs, 0);
+
+    pthread_mutex_unlock(&c->execute_lock);
     return 0;
 }
 
-static int thread_init_internal(ThreadContext *c, int nb_threads)
+static int thread_init_internal(ThreadContext *c, int nb_threads,
+                                AVExecutor *executor)
 {
-    nb_threads = avpriv_slicethread_create(&c->thread, c, worker_func, NULL, nb_threads);
-    if (nb_threads <= 1)
+    int ret = pthread_mutex_init(&c->execute_lock, NULL);
+    if (ret)
+        return AVERROR(ret);
+
+    nb_threads = avpriv_slicethread_create_executor(&c->thread, c, worker_func, NULL,
+                                                    nb_threads, executor);
+    if (nb_threads <= 1) {
         avpriv_slicethread_free(&c->thread);
+        pthread_mutex_destroy(&c->execute_lock);
+    }
     return FFMAX(nb_threads, 1);
 }
 
@@ -93,7 +117,8 @@ int ff_graph_thread_init(AVFilterGraph *graph)
     if (!graph->internal->thread)
         return AVERROR(ENOMEM);
 
-    ret = thread_init_internal(graph->internal->thread, graph->nb_threads);
+    ret = thread_init_internal(graph->internal->thread, graph->nb_threads,
+                               graph->executor);
     if (ret <= 1) {
         av_freep(&graph->internal->thread);
         graph->thread_type = 0;
@@ -113,3 +138,337 @@ void ff_graph_thread_free(AVFilterGraph *graph)
         slice_thread_uninit(graph->internal->thread);
     av_freep(&graph->internal->thread);
 }
+
+typedef struct FrameThreadJob {
+    AVFilterLink *link;
+    AVFrame      *frame;
+    int (*filter_frame)(AVFilterLink *link, AVFrame *frame);
+    /* time the job was submitted, when the graph is profiled */
+    int64_t       submitted;
+} FrameThreadJob;
+
+typedef struct FrameThreadContext {
+    AVFilterGraph *graph;
+
+    pthread_t *workers;
+    int     nb_workers;
+
+    /* protects the state of the graph and all the fields below */
+    pthread_mutex_t lock;
+    pthread_cond_t  job_cond;
+    pthread_cond_t  done_cond;
+
+    AVFifo  *jobs;
+    /* number of jobs queued or running */
+    unsigned nb_pending;
+    /* number of jobs finished so far */
+    uint64_t nb_done;
+    int      exit;
+
+    /* nesting level of ff_graph_frame_thread_lock(); only accessed by the
+     * thread using the public API */
+    int      lock_depth;
+    /* set while a frame thread runs filter code without releasing the lock,
+     * see ff_graph_frame_thread_worker() */
+    int      worker_locked;
+
+    pthread_mutex_t alloc_lock;
+} FrameThreadContext;
+
+static int filter_has_queued_frames(AVFilterContext *ctx)
+{
+    for (unsigned i = 0; i < ctx->nb_inputs; i++)
+        if (!ctx->inputs[i]->min_samples && ff_inlink_queued_frames(ctx->inputs[i]))
+            return 1;
+    return 0;
+}
+
+/* Hand the frames that became available to idle frame-threaded filters,
+ * without waiting for the caller to run the graph again. Other filters are
+ * only ever activated from the caller's thread. */
+static void activate_idle_filters(FrameThreadContext *c)
+{
+    AVFilterGraph *graph = c->graph;
+
+    while (!c->exit) {
+        AVFilterContext *filter = NULL;
+        int ret;
+
+        for (unsigned i = 0; i < graph->nb_filters; i++) {
+            AVFilterContext *f = graph->filters[i];
+            if (ff_filter_frame_threaded(f) && !f->internal->frame_thread_busy &&
+                f->ready && filter_has_queued_frames(f)) {
+                filter = f;
+                break;
+            }
+        }
+        if (!filter)
+            break;
+
+        c->worker_locked = 1;
+        ret = ff_filter_activate(filter);
+        c->worker_locked = 0;
+        if (ret < 0) {
+            av_log(filter, AV_LOG_ERROR, "Error activating filter: %s\n",
+                   av_err2str(ret));
+            break;
+        }
+    }
+}
+
+static void *frame_worker(void *arg)
+{
+    FrameThreadContext *c = arg;
+
+    pthread_mutex_lock(&c->lock);
+
+    while (1) {
+        FrameThreadJob job;
+        int64_t start = 0;
+        int ret;
+
+        /* the queued jobs are always run before exiting */
+        while (av_fifo_read(c->jobs, &job, 1) < 0) {
+            if (c->exit)
+                goto finish;
+            pthread_cond_wait(&c->job_cond, &c->lock);
+        }
+
+        pthread_mutex_unlock(&c->lock);
+        if (job.submitted)
+            start = av_gettime_relative();
+        ret = job.filter_frame(job.link, job.frame);
+        pthread_mutex_lock(&c->lock);
+
+        if (job.submitted)
+            ff_filter_profile_call(job.link->dst, start, start - job.submitted);
+
+        job.link->dst->internal->frame_thread_busy = 0;
+        ff_filter_frame_thread_done(job.link, ret);
+
+        c->nb_pending--;
+        c->nb_done++;
+
+        /* the job may have been the one delaying a run to be fused again */
+        if (c->graph->internal->refuse_pending) {
+            c->worker_locked = 1;
+            ff_filter_graph_refuse_pending(c->graph);
+            c->worker_locked = 0;
+        }
+
+        activate_idle_filters(c);
+
+        pthread_cond_broadcast(&c->done_cond);
+    }
+
+finish:
+    pthread_mutex_unlock(&c->lock);
+    return NULL;
+}
+
+int ff_graph_frame_thread_init(AVFilterGraph *graph)
+{
+    FrameThreadContext *c;
+    int nb_filters = 0, nb_workers, ret;
+
+    if (graph->internal->frame_thread)
+        return 0;
+
+    for (unsigned i = 0; i < graph->nb_filters; i++)
+        nb_filters += !!(graph->filters[i]->thread_type & AVFILTER_THREAD_FRAME);
+    if (!nb_filters)
+        return 0;
+
+    nb_workers = graph->nb_threads > 0 ? graph->nb_threads : av_cpu_count();
+    nb_workers = av_clip(nb_workers, 1, nb_filters);
+
+    c = av_mallocz(sizeof(*c));
+    if (!c)
+        return AVERROR(ENOMEM);
+    c->graph = graph;
+
+    c->workers = av_calloc(nb_workers, sizeof(*c->workers));
+    /* every filter has at most one job pending */
+    c->jobs    = av_fifo_alloc2(nb_filters, sizeof(FrameThreadJob), AV_FIFO_FLAG_AUTO_GROW);
+    if (!c->workers || !c->jobs) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+
+    if ((ret = pthread_mutex_init(&c->lock, NULL))) {
+        ret = AVERROR(ret);
+        goto fail;
+    }
+    if ((ret = pthread_mutex_init(&c->alloc_lock, NULL))) {
+        pthread_mutex_destroy(&c->lock);
+        ret = AVERROR(ret);
+        goto fail;
+    }
+    if ((ret = pthread_cond_init(&c->job_cond, NULL))) {
+        pthread_mutex_destroy(&c->alloc_lock);
+        pthread_mutex_destroy(&c->lock);
+        ret = AVERROR(ret);
+        goto fail;
+    }
+    if ((ret = pthread_cond_init(&c->done_cond, NULL))) {
+        pthread_cond_destroy(&c->job_cond);
+        pthread_mutex_destroy(&c->alloc_lock);
+        pthread_mutex_destroy(&c->lock);
+        ret = AVERROR(ret);
+        goto fail;
+    }
+
+    graph->internal->frame_thread = c;
+
+    for (; c->nb_workers < nb_workers; c->nb_workers++) {
+        ret = pthread_create(&c->workers[c->nb_workers], NULL, frame_worker, c);
+        if (ret) {
+            ff_graph_frame_thread_free(graph);
+            return AVERROR(ret);
+        }
+    }
+
+    av_log(graph, AV_LOG_VERBOSE, "Using %d frame threads for %d filters\n",
+           nb_workers, nb_filters);
+
+    return 0;
+fail:
+    av_fifo_freep2(&c->jobs);
+    av_freep(&c->workers);
+    av_freep(&c);
+    return ret;
+}
+
+void ff_graph_frame_thread_free(AVFilterGraph *graph)
+{
+    FrameThreadContext *c = graph->internal->frame_thread;
+
+    if (!c)
+        return;
+
+    pthread_mutex_lock(&c->lock);
+    c->exit = 1;
+    pthread_cond_broadcast(&c->job_cond);
+    pthread_mutex_unlock(&c->lock);
+
+    for (int i = 0; i < c->nb_workers; i++)
+        pthread_join(c->workers[i], NULL);
+
+    pthread_cond_destroy(&c->done_cond);
+    pthread_cond_destroy(&c->job_cond);
+    pthread_mutex_destroy(&c->alloc_lock);
+    pthread_mutex_destroy(&c->lock);
+
+    av_fifo_freep2(&c->jobs);
+    av_freep(&c->workers);
+    av_freep(&graph->internal->frame_thread);
+}
+
+void ff_graph_frame_thread_lock(AVFilterGraph *graph)
+{
+    FrameThreadContext *c = graph->internal->frame_thread;
+
+    if (c && !c->lock_depth++) {
+        pthread_mutex_lock(&c->lock);
+        if (graph->internal->refuse_pending)
+            ff_filter_graph_refuse_pending(graph);
+    }
+}
+
+void ff_graph_frame_thread_unlock(AVFilterGraph *graph)
+{
+    FrameThreadContext *c = graph->internal->frame_thread;
+
+    if (c && !--c->lock_depth)
+        pthread_mutex_unlock(&c->lock);
+}
+
+int ff_graph_frame_thread_submit(AVFilterLink *link, AVFrame *frame,
+                                 int (*filter_frame)(AVFilterLink *, AVFrame *))
+{
+    FrameThreadContext *c = link->dst->graph->internal->frame_thread;
+    FrameThreadJob job = { .link = link, .frame = frame, .filter_frame = filter_frame };
+    int ret;
+
+    if (link->graph->profile)
+        job.submitted = av_gettime_relative();
+
+    ret = av_fifo_write(c->jobs, &job, 1);
+    if (ret < 0) {
+        av_frame_free(&frame);
+        return ret;
+    }
+
+    link->dst->internal->frame_thread_busy = 1;
+    c->nb_pending++;
+
+    pthread_cond_signal(&c->job_cond);
+
+    return 0;
+}
+
+int ff_graph_frame_thread_wait(AVFilterGraph *graph, AVFilterContext *filter)
+{
+    FrameThreadContext *c = graph->internal->frame_thread;
+    uint64_t nb_done;
+
+    if (!c)
+        return AVERROR(EAGAIN);
+
+    if (filter) {
+        if (!filter->internal->frame_thread_busy)
+            return AVERROR(EAGAIN);
+        while (filter->internal->frame_thread_busy)
+            pthread_cond_wait(&c->done_cond, &c->lock);
+        return 0;
+    }
+
+    if (!c->nb_pending)
+        return AVERROR(EAGAIN);
+
+    nb_done = c->nb_done;
+    while (c->nb_done == nb_done)
+        pthread_cond_wait(&c->done_cond, &c->lock);
+
+    return 0;
+}
+
+int ff_graph_frame_thread_worker(AVFilterGraph *graph)
+{
+    FrameThreadContext *c = graph->internal->frame_thread;
+
+    /* only read while holding the lock, so it is set for the worker only */
+    return c && c->worker_locked;
+}
+
+void ff_filter_frame_thread_lock(AVFilterContext *filter)
+{
+    if (filter->internal->frame_thread_busy) {
+        FrameThreadContext *c = filter->graph->internal->frame_thread;
+        pthread_mutex_lock(&c->lock);
+    }
+}
+
+void ff_filter_frame_thread_unlock(AVFilterContext *filter)
+{
+    if (filter->internal->frame_thread_busy) {
+        FrameThreadContext *c = filter->graph->internal->frame_thread;
+        pthread_mutex_unlock(&c->lock);
+    }
+}
+
+void ff_graph_frame_thread_alloc_lock(AVFilterGraph *graph)
+{
+    FrameThreadContext *c = graph->internal->frame_thread;
+
+    if (c)
+        pthread_mutex_lock(&c->alloc_lock);
+}
+
+void ff_graph_frame_thread_alloc_unlock(AVFilterGraph *graph)
+{
+    FrameThreadContext *c = graph->internal->frame_thread;
+
+    if (c)
+        pthread_mutex_unlock(&c->alloc_lock);
+}
@@ -0,0 +1,128 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Check that the filters working in place after a split filter run after
+ * the other consumers of the shared frames, so that they get the frames
+ * without copying them when the others do not keep them.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/error.h"
+#include "libavutil/frame.h"
+#include "libavutil/macros.h"
+#include "libavfilter/avfilter.h"
+#include "libavfilter/buffersink.h"
+
+#define SOURCE "testsrc=size=64x64:rate=25:duration=1,format=yuv420p,split"
+
+#define NB_FRAMES 25
+
+/* keep: keep the output frames until the end, so that the frames shared with
+ * the buffer sink are still referenced */
+static void test(const char *desc, int keep)
+{
+    AVFilterGraph *graph = avfilter_graph_alloc();
+    AVFilterInOut *inputs = NULL, *outputs = NULL;
+    AVFilterContext *sink;
+    AVFrame *frames[NB_FRAMES + 1] = { NULL };
+    int ret, nb_frames = 0;
+
+    printf("%s%s\n", desc, keep ? " (output kept)" : "");
+
+    if (!graph) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    graph->nb_threads = 1;
+    graph->profile    = 1;
+
+    ret = avfilter_graph_parse2(graph, desc, &inputs, &outputs);
+    if (ret < 0)
+        goto end;
+    if (inputs || outputs) {
+        ret = AVERROR(EINVAL);
+        goto end;
+    }
+    ret = avfilter_graph_config(graph, NULL);
+    if (ret < 0)
+        goto end;
+
+    sink = avfilter_graph_get_filter(graph, "buffersink@out");
+    for (;;) {
+        AVFrame **frame = &frames[keep ? FFMIN(nb_frames, NB_FRAMES) : 0];
+
+        av_frame_free(frame);
+        if (!(*frame = av_frame_alloc())) {
+            ret = AVERROR(ENOMEM);
+            goto end;
+        }
+        if ((ret = av_buffersink_get_frame(sink, *frame)) < 0)
+            break;
+        nb_frames++;
+    }
+    if (ret != AVERROR_EOF)
+        goto end;
+    ret = 0;
+
+    printf("  %d frames output\n", nb_frames);
+    for (unsigned i = 0; i < graph->nb_filters; i++) {
+        AVFilterContext *ctx = graph->filters[i];
+        const AVFilterProfile *p = avfilter_get_profile(ctx);
+
+        if (!strchr(ctx->name, '@') || !strcmp(ctx->name, "buffersink@out"))
+            continue;
+        /* the sizes of the buffers depend on the CPU, only tell whether
+         * the frames were processed in place */
+        printf("  %s: %"PRId64" frames in, %"PRId64" copied, %s\n", ctx->name,
+               p->frames_in, p->nb_copies,
+               p->bytes_alloc ? "new output frames" : "in place");
+    }
+
+end:
+    if (ret < 0)
+        printf("  error %s\n", av_err2str(ret));
+    avfilter_inout_free(&inputs);
+    avfilter_inout_free(&outputs);
+    avfilter_graph_free(&graph);
+    for (int i = 0; i <= NB_FRAMES; i++)
+        av_frame_free(&frames[i]);
+}
+
+int main(void)
+{
+    av_log_set_level(AV_LOG_ERROR);
+
+    /* the other output drops its reference first, so the frames are
+     * processed in place */
+    test(SOURCE "[a][b];[a]negate@n1,nullsink;[b]buffersink@out", 0);
+    test(SOURCE "[a][b];[a]drawbox@d1,nullsink;[b]buffersink@out", 0);
+    test(SOURCE "[a][b];[a]negate@n1,buffersink@out;[b]nullsink", 0);
+    test(SOURCE "[a][b];[a]drawbox@d1,buffersink@out;[b]nullsink", 0);
+    /* only the filter running first needs another buffer */
+    test(SOURCE "[a][b];[a]negate@n1,buffersink@out;[b]negate@n2,nullsink", 0);
+    test(SOURCE "[a][b];[a]drawbox@d1,buffersink@out;[b]drawbox@d2,nullsink", 0);
+    /* the other output keeps its reference */
+    test(SOURCE "[a][b];[a]negate@n1,nullsink;[b]buffersink@out", 1);
+    test(SOURCE "[a][b];[a]drawbox@d1,nullsink;[b]buffersink@out", 1);
+
+    return 0;
+}
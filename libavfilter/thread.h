@@ -25,4 +25,61 @@ int ff_graph_thread_init(AVFilterGraph *graph);
 
 void ff_graph_thread_free(AVFilterGraph *graph);
 
+/**
+ * Start the frame threads of a configured graph, if frame threading is
+ * enabled for any of its filters.
+ */
+int ff_graph_frame_thread_init(AVFilterGraph *graph);
+
+/**
+ * Wait for all the pending frame thread jobs and stop the frame threads.
+ */
+void ff_graph_frame_thread_free(AVFilterGraph *graph);
+
+/**
+ * Lock the graph state against concurrent access from frame threads. Must be
+ * called by all the public entry points that access the graph state once it
+ * is configured. Calls may be nested.
+ */
+void ff_graph_frame_thread_lock(AVFilterGraph *graph);
+void ff_graph_frame_thread_unlock(AVFilterGraph *graph);
+
+/**
+ * Run filter_frame(link, frame) in a frame thread. Must be called with the
+ * graph locked.
+ */
+int ff_graph_frame_thread_submit(AVFilterLink *link, AVFrame *frame,
+                                 int (*filter_frame)(AVFilterLink *, AVFrame *));
+
+/**
+ * Wait until a frame thread job finishes, or until all jobs of filter are
+ * finished if it is not NULL. Must be called with the graph locked.
+ *
+ * @return 0 when a job finished, AVERROR(EAGAIN) if there was no job to
+ *         wait for
+ */
+int ff_graph_frame_thread_wait(AVFilterGraph *graph, AVFilterContext *filter);
+
+/**
+ * Check whether the caller is a frame thread running filter code outside of
+ * a job, e.g. activating a filter. It then holds the graph lock without having
+ * called ff_graph_frame_thread_lock(), and must not wait for frame thread jobs.
+ */
+int ff_graph_frame_thread_worker(AVFilterGraph *graph);
+
+/**
+ * Lock the graph state from within a frame thread job of filter, around the
+ * calls made by its filter_frame() callback that access the graph state.
+ * No-op if filter is not currently running in a frame thread.
+ */
+void ff_filter_frame_thread_lock(AVFilterContext *filter);
+void ff_filter_frame_thread_unlock(AVFilterContext *filter);
+
+/**
+ * Serialize frame buffer allocations on the links of a graph with frame
+ * threads. No-op if the graph has no frame threads.
+ */
+void ff_graph_frame_thread_alloc_lock(AVFilterGraph *graph);
+void ff_graph_frame_thread_alloc_unlock(AVFilterGraph *graph);
+
 #endif /* AVFILTER_THREAD_H */
@@ -31,7 +31,7 @@
 
 #include "version_major.h"
 
-#define LIBAVFILTER_VERSION_MINOR  50
+#define LIBAVFILTER_VERSION_MINOR  55
 #define LIBAVFILTER_VERSION_MICRO 100
 
 
@@ -481,6 +481,7 @@ static const AVFilterPad colorchannelmixer_inputs[] = {
     {
         .name         = "default",
         .type         = AVMEDIA_TYPE_VIDEO,
+        .flags        = AVFILTERPAD_FLAG_PREFERS_WRITABLE,
         .filter_frame = filter_frame,
     },
 };
@@ -489,10 +489,40 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *in)
     return ff_filter_frame(outlink, out);
 }
 
+static int map_lut(AVFilterContext *ctx, int comp, uint16_t *lut, int nb)
+{
+    ColorLevelsContext *s = ctx->priv;
+    const Range *r = &s->range[comp];
+    const int max = s->bpp == 1 ? UINT8_MAX : UINT16_MAX;
+    int imin = lrint(r->in_min  * max);
+    int imax = lrint(r->in_max  * max);
+    int omin = lrint(r->out_min * max);
+    int omax = lrint(r->out_max * max);
+    float coeff;
+
+    /* the automatic levels depend on the frame, and preserving the color
+     * depends on all the components of the pixel */
+    if (imin < 0 || imax < 0 || s->preserve_color > 0)
+        return AVERROR(ENOSYS);
+
+    coeff = (omax - omin) / (double)(imax - imin);
+
+    for (int i = 0; i < nb; i++) {
+        if (s->depth == 8)
+            lut[i] = av_clip_uint8((lut[i] - imin) * coeff + omin);
+        else if (s->depth == 16)
+            lut[i] = av_clip_uint16((lut[i] - imin) * coeff + omin);
+        else
+            lut[i] = av_clip_uintp2((lut[i] - imin) * coeff + omin, s->depth);
+    }
+    return 0;
+}
+
 static const AVFilterPad colorlevels_inputs[] = {
     {
         .name         = "default",
         .type         = AVMEDIA_TYPE_VIDEO,
+        .flags        = AVFILTERPAD_FLAG_PREFERS_WRITABLE,
         .filter_frame = filter_frame,
         .config_props = config_input,
     },
@@ -527,4 +557,5 @@ const AVFilter ff_vf_colorlevels = {
                    AV_PIX_FMT_GBRP16, AV_PIX_FMT_GBRAP16),
     .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC | AVFILTER_FLAG_SLICE_THREADS,
     .process_command = ff_filter_process_command,
+    .map_lut       = map_lut,
 };
@@ -996,10 +996,30 @@ static av_cold void curves_uninit(AVFilterContext *ctx)
         av_freep(&curves->graph[i]);
 }
 
+static int map_lut(AVFilterContext *ctx, int comp, uint16_t *lut, int nb)
+{
+    CurvesContext *curves = ctx->priv;
+
+    /* the alpha component is left unchanged */
+    if (comp >= NB_COMP)
+        return 0;
+    for (int i = 0; i < nb; i++)
+        lut[i] = curves->graph[comp][lut[i]];
+    return 0;
+}
+
+static uint16_t *get_lut(AVFilterContext *ctx, int comp)
+{
+    CurvesContext *curves = ctx->priv;
+
+    return comp < NB_COMP ? curves->graph[comp] : NULL;
+}
+
 static const AVFilterPad curves_inputs[] = {
     {
         .name         = "default",
         .type         = AVMEDIA_TYPE_VIDEO,
+        .flags        = AVFILTERPAD_FLAG_PREFERS_WRITABLE,
         .filter_frame = filter_frame,
         .config_props = config_input,
     },
@@ -1036,4 +1056,6 @@ const AVFilter ff_vf_curves = {
     .priv_class    = &curves_class,
     .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC | AVFILTER_FLAG_SLICE_THREADS,
     .process_command = process_command,
+    .map_lut       = map_lut,
+    .get_lut       = get_lut,
 };
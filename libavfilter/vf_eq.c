@@ -298,6 +298,27 @@ static int process_command(AVFilterContext *ctx, const char *cmd, const char *ar
     else return AVERROR(ENOSYS);
 }
 
+static int map_lut(AVFilterContext *ctx, int comp, uint16_t *lut, int nb)
+{
+    EQContext *eq = ctx->priv;
+    EQParameters *param = &eq->param[comp];
+    uint8_t src[256], dst[256];
+
+    /* the expressions may give other values for each frame */
+    if (eq->eval_mode == EVAL_MODE_FRAME)
+        return AVERROR(ENOSYS);
+    /* the alpha plane is copied unchanged */
+    if (comp == 3 || !param->adjust)
+        return 0;
+
+    for (int i = 0; i < 256; i++)
+        src[i] = i;
+    param->adjust(param, dst, sizeof(dst), src, sizeof(src), 256, 1);
+    for (int i = 0; i < nb; i++)
+        lut[i] = dst[lut[i]];
+    return 0;
+}
+
 static const AVFilterPad eq_inputs[] = {
     {
         .name = "default",
@@ -354,4 +375,5 @@ const AVFilter ff_vf_eq = {
     .init            = initialize,
     .uninit          = uninit,
     .flags           = AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC,
+    .map_lut         = map_lut,
 };
@@ -29,6 +29,7 @@
 #include "libavutil/avassert.h"
 #include "libavutil/avstring.h"
 #include "libavutil/eval.h"
+#include "libavutil/mem.h"
 #include "libavutil/opt.h"
 #include "libavutil/pixdesc.h"
 #include "internal.h"
@@ -62,6 +63,10 @@ typedef struct GEQContext {
 
     double *pixel_sums[NB_PLANES];
     int needs_sum[NB_PLANES];
+
+    int nb_threads;
+    double *xs;                 ///< X of every pixel of a row
+    double *rows;               ///< evaluated row of each thread
 } GEQContext;
 
 enum { Y = 0, U, V, A, G, B, R };
@@ -377,6 +382,18 @@ static int geq_config_props(AVFilterLink *inlink)
     geq->vsub = desc->log2_chroma_h;
     geq->bps = desc->comp[0].depth;
     geq->planes = desc->nb_components;
+
+    /* the planes are at most as wide as the frame */
+    geq->nb_threads = FFMIN(MAX_NB_THREADS, ff_filter_get_nb_threads(inlink->dst));
+    av_freep(&geq->xs);
+    av_freep(&geq->rows);
+    geq->xs   = av_malloc_array(inlink->w, sizeof(*geq->xs));
+    geq->rows = av_malloc_array(inlink->w, geq->nb_threads * sizeof(*geq->rows));
+    if (!geq->xs || !geq->rows)
+        return AVERROR(ENOMEM);
+    for (int x = 0; x < inlink->w; x++)
+        geq->xs[x] = x;
+
     return 0;
 }
 
@@ -397,9 +414,14 @@ static int slice_geq_filter(AVFilterContext *ctx, void *arg, int jobnr, int nb_j
     const int linesize = td->linesize;
     const int slice_start = (height *  jobnr) / nb_jobs;
     const int slice_end = (height * (jobnr+1)) / nb_jobs;
+    AVExpr *e = geq->e[plane][jobnr];
     int x, y;
 
+    /* X varies along the rows, the whole rows are evaluated at once */
+    double *res = geq->rows + (size_t)jobnr * ctx->inputs[0]->w;
+    const double *arrays[VAR_VARS_NB] = { [VAR_X] = geq->xs };
     double values[VAR_VARS_NB];
+
     values[VAR_W] = geq->values[VAR_W];
     values[VAR_H] = geq->values[VAR_H];
     values[VAR_N] = geq->values[VAR_N];
@@ -411,31 +433,27 @@ static int slice_geq_filter(AVFilterContext *ctx, void *arg, int jobnr, int nb_j
         uint8_t *ptr = geq->dst + linesize * slice_start;
         for (y = slice_start; y < slice_end; y++) {
             values[VAR_Y] = y;
-
-            for (x = 0; x < width; x++) {
-                values[VAR_X] = x;
-                ptr[x] = av_expr_eval(geq->e[plane][jobnr], values, geq);
-            }
+            av_expr_eval_array(e, res, width, values, arrays, geq);
+            for (x = 0; x < width; x++)
+                ptr[x] = res[x];
             ptr += linesize;
         }
     } else if (geq->bps <= 16) {
         uint16_t *ptr16 = geq->dst16 + (linesize/2) * slice_start;
         for (y = slice_start; y < slice_end; y++) {
             values[VAR_Y] = y;
-            for (x = 0; x < width; x++) {
-                values[VAR_X] = x;
-                ptr16[x] = av_expr_eval(geq->e[plane][jobnr], values, geq);
-            }
+            av_expr_eval_array(e, res, width, values, arrays, geq);
+            for (x = 0; x < width; x++)
+                ptr16[x] = res[x];
             ptr16 += linesize/2;
         }
     } else {
         float *ptr32 = geq->dst32 + (linesize/4) * slice_start;
         for (y = slice_start; y < slice_end; y++) {
             values[VAR_Y] = y;
-            for (x = 0; x < width; x++) {
-                values[VAR_X] = x;
-                ptr32[x] = av_expr_eval(geq->e[plane][jobnr], values, geq);
-            }
+            av_expr_eval_array(e, res, width, values, arrays, geq);
+            for (x = 0; x < width; x++)
+                ptr32[x] = res[x];
             ptr32 += linesize/4;
         }
     }
@@ -447,7 +465,6 @@ static int geq_filter_frame(AVFilterLink *inlink, AVFrame *in)
 {
     int plane;
     AVFilterContext *ctx = inlink->dst;
-    const int nb_threads = FFMIN(MAX_NB_THREADS, ff_filter_get_nb_threads(ctx));
     GEQContext *geq = ctx->priv;
     AVFilterLink *outlink = inlink->dst->outputs[0];
     AVFrame *out;
@@ -487,7 +504,7 @@ static int geq_filter_frame(AVFilterLink *inlink, AVFrame *in)
             calculate_sums(geq, plane, width, height);
 
         ff_filter_execute(ctx, slice_geq_filter, &td,
-                          NULL, FFMIN(height, nb_threads));
+                          NULL, FFMIN(height, geq->nb_threads));
     }
 
     av_frame_free(&geq->picref);
@@ -504,6 +521,8 @@ static av_cold void geq_uninit(AVFilterContext *ctx)
             av_expr_free(geq->e[i][j]);
     for (i = 0; i < NB_PLANES; i++)
         av_freep(&geq->pixel_sums);
+    av_freep(&geq->xs);
+    av_freep(&geq->rows);
 }
 
 static const AVFilterPad geq_inputs[] = {
@@ -166,5 +166,6 @@ const AVFilter ff_vf_hflip = {
     FILTER_INPUTS(avfilter_vf_hflip_inputs),
     FILTER_OUTPUTS(avfilter_vf_hflip_outputs),
     FILTER_QUERY_FUNC(query_formats),
-    .flags         = AVFILTER_FLAG_SLICE_THREADS | AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC,
+    .flags         = AVFILTER_FLAG_SLICE_THREADS | AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC |
+                     AVFILTER_FLAG_FRAME_THREADS,
 };
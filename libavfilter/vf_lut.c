@@ -575,9 +575,39 @@ static int process_command(AVFilterContext *ctx, const char *cmd, const char *ar
     return config_props(ctx->inputs[0]);
 }
 
+/* index of the table applied to a component, by plane or position in the
+ * packed pixels like the lut[] filling in config_props() */
+static int lut_index(AVFilterContext *ctx, int comp)
+{
+    LutContext *s = ctx->priv;
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(ctx->inputs[0]->format);
+
+    if (s->is_rgb && !s->is_planar)
+        return desc->comp[comp].offset >> s->is_16bit;
+    return desc->comp[comp].plane;
+}
+
+static int map_lut(AVFilterContext *ctx, int comp, uint16_t *lut, int nb)
+{
+    LutContext *s = ctx->priv;
+    const uint16_t *tab = s->lut[lut_index(ctx, comp)];
+
+    for (int i = 0; i < nb; i++)
+        lut[i] = tab[lut[i]];
+    return 0;
+}
+
+static uint16_t *get_lut(AVFilterContext *ctx, int comp)
+{
+    LutContext *s = ctx->priv;
+
+    return s->lut[lut_index(ctx, comp)];
+}
+
 static const AVFilterPad inputs[] = {
     { .name         = "default",
       .type         = AVMEDIA_TYPE_VIDEO,
+      .flags        = AVFILTERPAD_FLAG_PREFERS_WRITABLE,
       .filter_frame = filter_frame,
       .config_props = config_props,
     },
@@ -600,8 +630,11 @@ static const AVFilterPad outputs[] = {
         FILTER_OUTPUTS(outputs),                                        \
         FILTER_QUERY_FUNC(query_formats),                               \
         .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC |       \
-                         AVFILTER_FLAG_SLICE_THREADS,                   \
+                         AVFILTER_FLAG_SLICE_THREADS |                  \
+                         AVFILTER_FLAG_FRAME_THREADS,                   \
         .process_command = process_command,                             \
+        .map_lut       = map_lut,                                       \
+        .get_lut       = get_lut,                                       \
     }
 
 AVFILTER_DEFINE_CLASS_EXT(lut, "lut/lutyuv/lutrgb", options);
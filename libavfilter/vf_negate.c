@@ -346,10 +346,28 @@ static int process_command(AVFilterContext *ctx, const char *cmd, const char *ar
     return ret;
 }
 
+static int map_lut(AVFilterContext *ctx, int comp, uint16_t *lut, int nb)
+{
+    NegateContext *s = ctx->priv;
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(ctx->inputs[0]->format);
+    const AVComponentDescriptor *c = &desc->comp[comp];
+
+    if (!(desc->flags & AV_PIX_FMT_FLAG_PLANAR) && desc->nb_components > 1) {
+        if (!(s->components & (1 << (c->offset >> (c->depth > 8)))))
+            return 0;
+    } else if (!(s->planes & (1 << c->plane)))
+        return 0;
+
+    for (int i = 0; i < nb; i++)
+        lut[i] = s->max - lut[i];
+    return 0;
+}
+
 static const AVFilterPad inputs[] = {
     {
         .name         = "default",
         .type         = AVMEDIA_TYPE_VIDEO,
+        .flags        = AVFILTERPAD_FLAG_PREFERS_WRITABLE,
         .filter_frame = filter_frame,
         .config_props = config_input,
     },
@@ -372,4 +390,5 @@ const AVFilter ff_vf_negate = {
     FILTER_PIXFMTS_ARRAY(pix_fmts),
     .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC | AVFILTER_FLAG_SLICE_THREADS,
     .process_command = process_command,
+    .map_lut       = map_lut,
 };
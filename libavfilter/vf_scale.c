@@ -544,6 +544,7 @@ static int config_props(AVFilterLink *outlink)
             av_opt_set_int(s, "param0", scale->param[0], 0);
             av_opt_set_int(s, "param1", scale->param[1], 0);
             av_opt_set_int(s, "threads", ff_filter_get_nb_threads(ctx), 0);
+            sws_set_executor(s, ctx->graph->executor);
             if (scale->in_range != AVCOL_RANGE_UNSPECIFIED)
                 av_opt_set_int(s, "src_range",
                                scale->in_range == AVCOL_RANGE_JPEG, 0);
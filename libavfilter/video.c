@@ -31,6 +31,7 @@
 #include "avfilter.h"
 #include "framepool.h"
 #include "internal.h"
+#include "thread.h"
 #include "video.h"
 
 AVFrame *ff_null_get_video_buffer(AVFilterLink *link, int w, int h)
@@ -41,6 +42,7 @@ AVFrame *ff_null_get_video_buffer(AVFilterLink *link, int w, int h)
 AVFrame *ff_default_get_video_buffer2(AVFilterLink *link, int w, int h, int align)
 {
     AVFrame *frame = NULL;
+    FFBufferCache *buffer_cache = link->dst->graph ? link->dst->graph->internal->buffer_cache : NULL;
     int pool_width = 0;
     int pool_height = 0;
     int pool_align = 0;
@@ -62,7 +64,7 @@ AVFrame *ff_default_get_video_buffer2(AVFilterLink *link, int w, int h, int alig
     }
 
     if (!link->frame_pool) {
-        link->frame_pool = ff_frame_pool_video_init(av_buffer_allocz, w, h,
+        link->frame_pool = ff_frame_pool_video_init(av_buffer_allocz, buffer_cache, w, h,
                                                     link->format, align);
         if (!link->frame_pool)
             return NULL;
@@ -77,7 +79,7 @@ AVFrame *ff_default_get_video_buffer2(AVFilterLink *link, int w, int h, int alig
             pool_format != link->format || pool_align != align) {
 
             ff_frame_pool_uninit((FFFramePool **)&link->frame_pool);
-            link->frame_pool = ff_frame_pool_video_init(av_buffer_allocz, w, h,
+            link->frame_pool = ff_frame_pool_video_init(av_buffer_allocz, buffer_cache, w, h,
                                                         link->format, align);
             if (!link->frame_pool)
                 return NULL;
@@ -104,11 +106,26 @@ AVFrame *ff_get_video_buffer(AVFilterLink *link, int w, int h)
 
     FF_TPRINTF_START(NULL, get_video_buffer); ff_tlog_link(NULL, link, 1);
 
-    if (link->dstpad->get_buffer.video)
-        ret = link->dstpad->get_buffer.video(link, w, h);
-
-    if (!ret)
+    /* The links of frame-threaded filters can be used from several threads:
+     * bypass the get_buffer() callbacks, which could run concurrently with
+     * the other callbacks of their filter, and serialize the allocations. */
+    if (ff_filter_frame_threaded(link->src) || ff_filter_frame_threaded(link->dst)) {
+        ff_graph_frame_thread_alloc_lock(link->dst->graph);
         ret = ff_default_get_video_buffer(link, w, h);
+        ff_graph_frame_thread_alloc_unlock(link->dst->graph);
+    } else {
+        if (link->dstpad->get_buffer.video) {
+            link->dst->internal->get_buffer_depth++;
+            ret = link->dstpad->get_buffer.video(link, w, h);
+            link->dst->internal->get_buffer_depth--;
+        }
+
+        if (!ret)
+            ret = ff_default_get_video_buffer(link, w, h);
+    }
+
+    if (ret)
+        ff_filter_profile_alloc(link, ret);
 
     return ret;
 }
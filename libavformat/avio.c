@@ -654,6 +654,21 @@ int ffurl_get_short_seek(URLContext *h)
     return h->prot->url_get_short_seek(h);
 }
 
+int ffurl_get_mapping(URLContext *h, AVBufferRef **buf)
+{
+    if (!h || !h->prot || !h->prot->url_get_mapping)
+        return AVERROR(ENOSYS);
+    return h->prot->url_get_mapping(h, buf);
+}
+
+int ffurl_map_range(URLContext *h, int64_t pos, int size, int padding,
+                    AVBufferRef **buf)
+{
+    if (!h || !h->prot || !h->prot->url_map_range)
+        return AVERROR(ENOSYS);
+    return h->prot->url_map_range(h, pos, size, padding, buf);
+}
+
 int ffurl_shutdown(URLContext *h, int flags)
 {
     if (!h || !h->prot || !h->prot->url_shutdown)
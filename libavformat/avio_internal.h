@@ -22,6 +22,7 @@
 #include "avio.h"
 #include "url.h"
 
+#include "libavutil/buffer.h"
 #include "libavutil/log.h"
 
 extern const AVClass ff_avio_class;
@@ -77,6 +78,29 @@ typedef struct FFIOContext {
      * is updated each time a successful writeout ends up further position-wise
      */
     int64_t written_output_size;
+
+    /**
+     * Set if the buffer is allocated and freed by libavformat itself,
+     * so that parts of it can be handed out by ffio_read_ref().
+     */
+    int own_buffer;
+
+    /**
+     * Reference to buffer, created by the first ffio_read_ref().
+     * While other references to it exist, its first buffer_ref_end bytes
+     * must not be modified; the buffer is replaced instead.
+     */
+    AVBufferRef *buffer_ref;
+    int buffer_ref_end;
+
+    /**
+     * Size of the resource if buffer_ref is a memory mapping of all of it,
+     * 0 otherwise. The buffer is then a window into the mapping.
+     */
+    int64_t map_size;
+    int map_advice;             ///< access pattern last announced for the mapping
+    int map_short_runs;         ///< far seeks in a row after little reading
+    int64_t map_run_start;      ///< target of the last far seek
 } FFIOContext;
 
 static av_always_inline FFIOContext *ffiocontext(AVIOContext *ctx)
@@ -111,6 +135,26 @@ void ffio_init_context(FFIOContext *s,
  */
 int ffio_read_indirect(AVIOContext *s, unsigned char *buf, int size, const unsigned char **data);
 
+/**
+ * Read size bytes from AVIOContext as a reference to the underlying buffer,
+ * avoiding a copy.
+ *
+ * This only succeeds if the buffer is owned by libavformat and the requested
+ * bytes are the last ones in it, or can be read into it up to their end, so
+ * that the AV_INPUT_BUFFER_PADDING_SIZE bytes following them can be zeroed.
+ * Packets followed by more buffered data are not referenced. The data must
+ * not be modified.
+ *
+ * @param s    IO context
+ * @param buf  set to a new reference whose data points to the bytes read,
+ *             with size including the padding
+ * @param size number of bytes requested
+ * @return size on success, AVERROR(EAGAIN) if the data can not be
+ *         referenced, in which case nothing was consumed, or another
+ *         AVERROR code on failure
+ */
+int ffio_read_ref(AVIOContext *s, AVBufferRef **buf, int size);
+
 void ffio_fill(AVIOContext *s, int b, int64_t count);
 
 static av_always_inline void ffio_wfourcc(AVIOContext *pb, const uint8_t *s)
@@ -19,6 +19,17 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#define _DEFAULT_SOURCE // needed for madvise()
+
+#include "config.h"
+
+#if HAVE_MADVISE
+#include <sys/mman.h>
+#endif
+#if HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
 #include "libavutil/bprint.h"
 #include "libavutil/crc.h"
 #include "libavutil/dict.h"
@@ -43,6 +54,32 @@
  */
 #define SHORT_SEEK_THRESHOLD 32768
 
+/**
+ * Size of the part of a memory mapping that the buffer covers at a time,
+ * small enough for the int buffer offsets.
+ */
+#define MAP_WINDOW (1 << 30)
+
+/* Seeks farther than MAP_FAR_SEEK with less than MAP_SEQ_RUN bytes read in
+ * between are taken as random access to the mapping, reads of at least
+ * MAP_WILLNEED bytes outside of sequential access are prefetched. */
+#define MAP_FAR_SEEK (1 << 20)
+#define MAP_SEQ_RUN  (8 << 20)
+#define MAP_WILLNEED (64 << 10)
+
+/**
+ * Smallest read referenced from a memory mapping. Mapping a range on its own
+ * costs a few system calls and page faults, smaller reads are copied.
+ */
+#define MAP_REF_MIN (256 << 10)
+
+enum MapAdvice {
+    MAP_ADVICE_NORMAL,
+    MAP_ADVICE_SEQUENTIAL,
+    MAP_ADVICE_RANDOM,
+    MAP_ADVICE_WILLNEED,
+};
+
 static void *ff_avio_child_next(void *obj, void *prev)
 {
     AVIOContext *s = obj;
@@ -259,6 +296,67 @@ void avio_flush(AVIOContext *s)
         avio_seek(s, seekback, SEEK_CUR);
 }
 
+static void map_advise(FFIOContext *ctx, enum MapAdvice advice,
+                       int64_t pos, int64_t size)
+{
+#if HAVE_MADVISE
+    static const int advices[] = {
+        [MAP_ADVICE_NORMAL]     = MADV_NORMAL,
+        [MAP_ADVICE_SEQUENTIAL] = MADV_SEQUENTIAL,
+        [MAP_ADVICE_RANDOM]     = MADV_RANDOM,
+        [MAP_ADVICE_WILLNEED]   = MADV_WILLNEED,
+    };
+    int64_t start = pos & ~(int64_t)(sysconf(_SC_PAGESIZE) - 1);
+
+    madvise(ctx->buffer_ref->data + start, pos + size - start, advices[advice]);
+#endif
+}
+
+static void map_set_advice(FFIOContext *ctx, enum MapAdvice advice)
+{
+    if (ctx->map_advice == advice)
+        return;
+    ctx->map_advice = advice;
+    map_advise(ctx, advice, 0, ctx->map_size);
+}
+
+/**
+ * Switch off readahead when the demuxer keeps jumping around in the
+ * mapping, and back on when it reads more than a few bytes in between.
+ */
+static void map_seek_hint(FFIOContext *ctx, int64_t from, int64_t to)
+{
+    if (FFABS(to - from) < MAP_FAR_SEEK)
+        return;
+
+    if (FFABS(from - ctx->map_run_start) < MAP_SEQ_RUN) {
+        if (++ctx->map_short_runs >= 3)
+            map_set_advice(ctx, MAP_ADVICE_RANDOM);
+    } else {
+        ctx->map_short_runs = 0;
+        map_set_advice(ctx, MAP_ADVICE_NORMAL);
+    }
+    ctx->map_run_start = to;
+}
+
+/**
+ * Make readahead more aggressive after a long sequential run, otherwise
+ * prefetch large reads, which are usually packet data.
+ */
+static void map_read_hint(FFIOContext *ctx, int64_t pos, int size)
+{
+    if (ctx->map_advice == MAP_ADVICE_SEQUENTIAL)
+        return;
+
+    if (pos - ctx->map_run_start >= MAP_SEQ_RUN) {
+        ctx->map_short_runs = 0;
+        map_set_advice(ctx, MAP_ADVICE_SEQUENTIAL);
+    } else if (size >= MAP_WILLNEED && pos < ctx->map_size) {
+        map_advise(ctx, MAP_ADVICE_WILLNEED, pos,
+                   FFMIN(size, ctx->map_size - pos));
+    }
+}
+
 int64_t avio_seek(AVIOContext *s, int64_t offset, int whence)
 {
     FFIOContext *const ctx = ffiocontext(s);
@@ -293,6 +391,9 @@ int64_t avio_seek(AVIOContext *s, int64_t offset, int whence)
     if (offset < 0)
         return AVERROR(EINVAL);
 
+    if (ctx->map_size)
+        map_seek_hint(ctx, pos + (s->buf_ptr - s->buffer), offset);
+
     short_seek = ctx->short_seek_threshold;
     if (ctx->short_seek_get) {
         int tmp = ctx->short_seek_get(s->opaque);
@@ -539,6 +640,94 @@ static int read_packet_wrapper(AVIOContext *s, uint8_t *buf, int size)
 
 /* Input stream */
 
+static void free_buffer(AVIOContext *s)
+{
+    FFIOContext *const ctx = ffiocontext(s);
+
+    /* a referenced buffer is freed with its last reference */
+    if (ctx->buffer_ref)
+        av_buffer_unref(&ctx->buffer_ref);
+    else
+        av_free(s->buffer);
+    s->buffer = NULL;
+    ctx->buffer_ref_end = 0;
+}
+
+/**
+ * Check whether writing to the buffer at dst could modify data still
+ * referenced outside of the AVIOContext.
+ */
+static int buffer_referenced(AVIOContext *s, const uint8_t *dst)
+{
+    FFIOContext *const ctx = ffiocontext(s);
+
+    if (dst - s->buffer >= ctx->buffer_ref_end)
+        return 0;
+    if (av_buffer_is_writable(ctx->buffer_ref)) {
+        ctx->buffer_ref_end = 0;
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * Move the AVIOContext to a new buffer, keeping the data up to dst.
+ */
+static int unshare_buffer(AVIOContext *s, uint8_t **dst)
+{
+    uint8_t *buffer = av_malloc(s->buffer_size);
+
+    if (!buffer)
+        return AVERROR(ENOMEM);
+    memcpy(buffer, s->buffer, *dst - s->buffer);
+
+    *dst           = buffer + (*dst         - s->buffer);
+    s->buf_ptr     = buffer + (s->buf_ptr   - s->buffer);
+    s->buf_end     = buffer + (s->buf_end   - s->buffer);
+    s->buf_ptr_max = buffer + (s->buf_ptr_max - s->buffer);
+    if (s->update_checksum)
+        s->checksum_ptr = buffer + (s->checksum_ptr - s->buffer);
+    free_buffer(s);
+    s->buffer = buffer;
+    return 0;
+}
+
+/**
+ * Move the window into the mapping forward, so that it extends beyond the
+ * current end of the buffer but still covers some data before it.
+ */
+static void map_fill(AVIOContext *s)
+{
+    FFIOContext *const ctx = ffiocontext(s);
+    uint8_t *map = ctx->buffer_ref->data;
+    int64_t pos  = s->pos - (s->buf_end - s->buf_ptr);
+    int64_t start, end;
+
+    if (s->pos >= ctx->map_size) {
+        s->eof_reached = 1;
+        return;
+    }
+
+    /* the new data starts at s->pos, like after a refill from read_packet */
+    if (s->update_checksum) {
+        if (s->buf_end > s->checksum_ptr)
+            s->checksum = s->update_checksum(s->checksum, s->checksum_ptr,
+                                             s->buf_end - s->checksum_ptr);
+        s->checksum_ptr = map + s->pos;
+    }
+
+    start = FFMAX(s->pos - MAP_WINDOW / 2, 0);
+    end   = FFMIN(start + MAP_WINDOW, ctx->map_size);
+
+    s->buffer      = map + start;
+    s->buffer_size = end - start;
+    s->buf_ptr     = map + FFMAX(pos, start);
+    s->buf_end     = map + end;
+    ctx->bytes_read += end - s->pos;
+    s->bytes_read    = ctx->bytes_read;
+    s->pos           = end;
+}
+
 static void fill_buffer(AVIOContext *s)
 {
     FFIOContext *const ctx = (FFIOContext *)s;
@@ -548,6 +737,19 @@ static void fill_buffer(AVIOContext *s)
                           s->buf_end : s->buffer;
     int len             = s->buffer_size - (dst - s->buffer);
 
+    if (ctx->map_size) {
+        map_fill(s);
+        return;
+    }
+
+    /* start over in a new buffer rather than copying the data already read
+     * from a referenced one, see ffio_read_ref() */
+    if (dst != s->buffer && s->buf_ptr >= s->buf_end &&
+        buffer_referenced(s, dst)) {
+        dst = s->buffer;
+        len = s->buffer_size;
+    }
+
     /* can't fill the buffer without read_packet, just set EOF if appropriate */
     if (!s->read_packet && s->buf_ptr >= s->buf_end)
         s->eof_reached = 1;
@@ -576,6 +778,15 @@ static void fill_buffer(AVIOContext *s)
         len = ctx->orig_buffer_size;
     }
 
+    if (buffer_referenced(s, dst)) {
+        int ret = unshare_buffer(s, &dst);
+        if (ret < 0) {
+            s->eof_reached = 1;
+            s->error = ret;
+            return;
+        }
+    }
+
     len = read_packet_wrapper(s, dst, len);
     if (len == AVERROR_EOF) {
         /* do not modify buffer if EOF reached so that a seek back can
@@ -642,8 +853,12 @@ int avio_r8(AVIOContext *s)
 
 int avio_read(AVIOContext *s, unsigned char *buf, int size)
 {
+    FFIOContext *const ctx = ffiocontext(s);
     int len, size1;
 
+    if (ctx->map_size)
+        map_read_hint(ctx, s->pos - (s->buf_end - s->buf_ptr), size);
+
     size1 = size;
     while (size > 0) {
         len = FFMIN(s->buf_end - s->buf_ptr, size);
@@ -712,6 +927,119 @@ int ffio_read_indirect(AVIOContext *s, unsigned char *buf, int size, const unsig
     }
 }
 
+/**
+ * Map the data on its own, wherever the window is. The data following it in
+ * the mapping can not serve as padding, which must be zeroed.
+ */
+static int map_read_ref(AVIOContext *s, AVBufferRef **buf, int size)
+{
+    FFIOContext *const ctx = ffiocontext(s);
+    int64_t pos = avio_tell(s);
+    int64_t ret;
+
+    if (size < MAP_REF_MIN || pos < 0 || pos > ctx->map_size - size)
+        return AVERROR(EAGAIN);
+
+    map_read_hint(ctx, pos, size);
+
+    /* fall back to a copy if the range can not be mapped */
+    if (ffurl_map_range(s->opaque, pos, size, AV_INPUT_BUFFER_PADDING_SIZE,
+                        buf) < 0)
+        return AVERROR(EAGAIN);
+
+    if ((ret = avio_skip(s, size)) < 0) {
+        av_buffer_unref(buf);
+        return ret;
+    }
+    return size;
+}
+
+/**
+ * Read exactly size more bytes into the buffer at buf_end, fewer only on EOF
+ * or error.
+ */
+static void fill_buffer_exact(AVIOContext *s, int size)
+{
+    FFIOContext *const ctx = ffiocontext(s);
+
+    while (size > 0 && !s->eof_reached) {
+        int len = read_packet_wrapper(s, s->buf_end, size);
+        if (len == AVERROR_EOF) {
+            s->eof_reached = 1;
+        } else if (len < 0) {
+            s->eof_reached = 1;
+            s->error = len;
+        } else {
+            s->pos     += len;
+            s->buf_end += len;
+            size       -= len;
+            ctx->bytes_read += len;
+            s->bytes_read    = ctx->bytes_read;
+        }
+    }
+}
+
+int ffio_read_ref(AVIOContext *s, AVBufferRef **buf, int size)
+{
+    FFIOContext *const ctx = ffiocontext(s);
+    int needed = size + AV_INPUT_BUFFER_PADDING_SIZE;
+    int avail  = s->buf_end - s->buf_ptr;
+
+    if (ctx->map_size)
+        return map_read_ref(s, buf, size);
+
+    /* packetized protocols must be read a whole packet at a time, and the
+     * checksummed data would have to be tracked across a new buffer */
+    if (!ctx->own_buffer || s->write_flag || s->direct || !s->read_packet ||
+        s->max_packet_size || s->update_checksum ||
+        size <= 0 || size > s->buffer_size - AV_INPUT_BUFFER_PADDING_SIZE)
+        return AVERROR(EAGAIN);
+
+    /* The padding is zeroed, so the packet must end the data in the buffer,
+     * it is read up to its end only. Stream data following it in the buffer
+     * would be overwritten; small packets are usually in that case and are
+     * cheap to copy. */
+    if (avail > size)
+        return AVERROR(EAGAIN);
+
+    if (!avail) {
+        /* start over in an empty buffer, or in a new one if the current one
+         * is still referenced */
+        uint8_t *dst = s->buffer;
+        if (buffer_referenced(s, dst)) {
+            int ret = unshare_buffer(s, &dst);
+            if (ret < 0)
+                return ret;
+        }
+        s->buf_ptr = s->buf_end = dst;
+    } else if (s->buffer + s->buffer_size - s->buf_ptr < needed ||
+               buffer_referenced(s, s->buf_end)) {
+        return AVERROR(EAGAIN);
+    }
+
+    fill_buffer_exact(s, size - avail);
+    if (s->buf_end - s->buf_ptr < size)
+        return AVERROR(EAGAIN);
+    memset(s->buf_end, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+
+    if (!ctx->buffer_ref) {
+        ctx->buffer_ref = av_buffer_create(s->buffer, s->buffer_size,
+                                           av_buffer_default_free, NULL, 0);
+        if (!ctx->buffer_ref)
+            return AVERROR(ENOMEM);
+    }
+    *buf = av_buffer_ref(ctx->buffer_ref);
+    if (!*buf)
+        return AVERROR(ENOMEM);
+    (*buf)->data = s->buf_ptr;
+    (*buf)->size = needed;
+
+    s->buf_ptr += size;
+    ctx->buffer_ref_end = FFMAX(ctx->buffer_ref_end,
+                                s->buf_ptr - s->buffer + AV_INPUT_BUFFER_PADDING_SIZE);
+    return size;
+}
+
 int avio_read_partial(AVIOContext *s, unsigned char *buf, int size)
 {
     int len;
@@ -958,6 +1286,7 @@ uint64_t ffio_read_varlen(AVIOContext *bc){
 int ffio_fdopen(AVIOContext **s, URLContext *h)
 {
     uint8_t *buffer = NULL;
+    AVBufferRef *map = NULL;
     int buffer_size, max_packet_size;
 
     max_packet_size = h->max_packet_size;
@@ -971,17 +1300,31 @@ int ffio_fdopen(AVIOContext **s, URLContext *h)
             return AVERROR(EINVAL);
         buffer_size *= 2;
     }
-    buffer = av_malloc(buffer_size);
-    if (!buffer)
-        return AVERROR(ENOMEM);
 
-    *s = avio_alloc_context(buffer, buffer_size, h->flags & AVIO_FLAG_WRITE, h,
-                            (int (*)(void *, uint8_t *, int))  ffurl_read,
-                            (int (*)(void *, uint8_t *, int))  ffurl_write,
-                            (int64_t (*)(void *, int64_t, int))ffurl_seek);
-    if (!*s) {
-        av_freep(&buffer);
-        return AVERROR(ENOMEM);
+    /* without read_packet, fill_buffer() moves the window into the mapping */
+    if (!(h->flags & (AVIO_FLAG_WRITE | AVIO_FLAG_DIRECT)) &&
+        ffurl_get_mapping(h, &map) >= 0) {
+        *s = avio_alloc_context(map->data, 0, 0, h, NULL, NULL,
+                                (int64_t (*)(void *, int64_t, int))ffurl_seek);
+        if (!*s) {
+            av_buffer_unref(&map);
+            return AVERROR(ENOMEM);
+        }
+        ffiocontext(*s)->buffer_ref = map;
+        ffiocontext(*s)->map_size   = map->size;
+    } else {
+        buffer = av_malloc(buffer_size);
+        if (!buffer)
+            return AVERROR(ENOMEM);
+
+        *s = avio_alloc_context(buffer, buffer_size, h->flags & AVIO_FLAG_WRITE, h,
+                                (int (*)(void *, uint8_t *, int))  ffurl_read,
+                                (int (*)(void *, uint8_t *, int))  ffurl_write,
+                                (int64_t (*)(void *, int64_t, int))ffurl_seek);
+        if (!*s) {
+            av_freep(&buffer);
+            return AVERROR(ENOMEM);
+        }
     }
     (*s)->protocol_whitelist = av_strdup(h->protocol_whitelist);
     if (!(*s)->protocol_whitelist && h->protocol_whitelist) {
@@ -994,6 +1337,7 @@ int ffio_fdopen(AVIOContext **s, URLContext *h)
         return AVERROR(ENOMEM);
     }
     (*s)->direct = h->flags & AVIO_FLAG_DIRECT;
+    ffiocontext(*s)->own_buffer = 1;
 
     (*s)->seekable = h->is_streamed ? 0 : AVIO_SEEKABLE_NORMAL;
     (*s)->max_packet_size = max_packet_size;
@@ -1016,7 +1360,8 @@ URLContext* ffio_geturlcontext(AVIOContext *s)
     if (!s)
         return NULL;
 
-    if (s->opaque && s->read_packet == (int (*)(void *, uint8_t *, int))ffurl_read)
+    if (s->opaque && (s->read_packet == (int (*)(void *, uint8_t *, int))ffurl_read ||
+                      ffiocontext(s)->map_size))
         return s->opaque;
     else
         return NULL;
@@ -1073,16 +1418,17 @@ int ffio_ensure_seekback(AVIOContext *s, int64_t buf_size)
         return 0;
     av_assert0(!s->write_flag);
 
-    if (buf_size <= s->buffer_size) {
+    if (buf_size <= s->buffer_size && !buffer_referenced(s, s->buffer)) {
         update_checksum(s);
         memmove(s->buffer, s->buf_ptr, filled);
     } else {
+        buf_size = FFMAX(buf_size, s->buffer_size);
         buffer = av_malloc(buf_size);
         if (!buffer)
             return AVERROR(ENOMEM);
         update_checksum(s);
         memcpy(buffer, s->buf_ptr, filled);
-        av_free(s->buffer);
+        free_buffer(s);
         s->buffer = buffer;
         s->buffer_size = buf_size;
     }
@@ -1125,7 +1471,7 @@ static int set_buf_size(AVIOContext *s, int buf_size)
     if (!buffer)
         return AVERROR(ENOMEM);
 
-    av_free(s->buffer);
+    free_buffer(s);
     s->buffer = buffer;
     ffiocontext(s)->orig_buffer_size =
     s->buffer_size = buf_size;
@@ -1139,6 +1485,10 @@ int ffio_realloc_buf(AVIOContext *s, int buf_size)
     uint8_t *buffer;
     int data_size;
 
+    /* all of the mapping can be reached without reading it again */
+    if (ffiocontext(s)->map_size)
+        return 0;
+
     if (!s->buffer_size)
         return set_buf_size(s, buf_size);
 
@@ -1152,7 +1502,7 @@ int ffio_realloc_buf(AVIOContext *s, int buf_size)
     data_size = s->write_flag ? (s->buf_ptr - s->buffer) : (s->buf_end - s->buf_ptr);
     if (data_size > 0)
         memcpy(buffer, s->write_flag ? s->buffer : s->buf_ptr, data_size);
-    av_free(s->buffer);
+    free_buffer(s);
     s->buffer = buffer;
     ffiocontext(s)->orig_buffer_size = buf_size;
     s->buffer_size = buf_size;
@@ -1191,6 +1541,13 @@ int ffio_rewind_with_probe_data(AVIOContext *s, unsigned char **bufp, int buf_si
         return AVERROR(EINVAL);
     }
 
+    /* the probe data is still in the mapping */
+    if (ffiocontext(s)->map_size) {
+        int64_t ret = avio_seek(s, 0, SEEK_SET);
+        av_freep(bufp);
+        return ret < 0 ? ret : 0;
+    }
+
     buffer_size = s->buf_end - s->buffer;
 
     /* the buffers must touch or overlap */
@@ -1212,7 +1569,7 @@ int ffio_rewind_with_probe_data(AVIOContext *s, unsigned char **bufp, int buf_si
         buf_size = new_size;
     }
 
-    av_free(s->buffer);
+    free_buffer(s);
     s->buf_ptr = s->buffer = buf;
     s->buffer_size = alloc_size;
     s->pos = buf_size;
@@ -1267,7 +1624,7 @@ int avio_close(AVIOContext *s)
     h         = s->opaque;
     s->opaque = NULL;
 
-    av_freep(&s->buffer);
+    free_buffer(s);
     if (s->write_flag)
         av_log(s, AV_LOG_VERBOSE,
                "Statistics: %"PRId64" bytes written, %d seeks, %d writeouts\n",
@@ -19,8 +19,14 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include "config.h"
 #include "config_components.h"
 
+/* needed for O_DIRECT, fallocate() and sync_file_range() */
+#ifndef _GNU_SOURCE
+# define _GNU_SOURCE
+#endif
+
 #include "libavutil/avstring.h"
 #include "libavutil/file_open.h"
 #include "libavutil/internal.h"
@@ -38,8 +44,16 @@
 #endif
 #include <sys/stat.h>
 #include <stdlib.h>
+#if HAVE_MMAP
+#include <sys/mman.h>
+#include "libavutil/buffer.h"
+#endif
 #include "os_support.h"
 #include "url.h"
+#if HAVE_IO_URING
+#include "libavutil/mem.h"
+#include "iouring.h"
+#endif
 
 /* Some systems may not have S_ISFIFO */
 #ifndef S_ISFIFO
@@ -70,6 +84,20 @@
 
 /* standard file protocol */
 
+/* alignment of O_DIRECT writes, in memory and in the file */
+#define DIRECT_ALIGN 4096
+
+#if HAVE_IO_URING
+typedef struct FileRingSlot {
+    uint8_t *data;
+    int64_t offset;             ///< file offset of data[0]
+    int size;                   ///< size of the request
+    int len;                    ///< result of the request once completed
+    int pos;                    ///< read position in data
+    int pending;
+} FileRingSlot;
+#endif
+
 typedef struct FileContext {
     const AVClass *class;
     int fd;
@@ -77,8 +105,44 @@ typedef struct FileContext {
     int blocksize;
     int follow;
     int seekable;
+    int io_uring;
+    int ring_depth;
+    int ring_block_size;
+    int direct;
+    int direct_buffer_size;
+    int64_t prealloc_size;
+    int64_t sync_size;
+    int use_mmap;
 #if HAVE_DIRENT_H
     DIR *dir;
+#endif
+    int64_t pos;                ///< logical file position
+
+    /* O_DIRECT coalescing buffer: dbuf[i] is written to file offset dbase + i,
+     * so that aligned file blocks are aligned in memory too */
+    uint8_t *dbuf_alloc;
+    uint8_t *dbuf;
+    int64_t dbase;
+    int dlo;                    ///< start of the data in dbuf
+    int dfill;                  ///< end of the data in dbuf
+
+    int64_t prealloc_end;       ///< end of the preallocated space
+    int64_t sync_prev;          ///< start of the range under writeback
+    int64_t sync_start;         ///< start of the range not yet synced
+#if HAVE_MMAP
+    AVBufferRef *map;           ///< mapping of the whole file
+#endif
+#if HAVE_IO_URING
+    FFIOUring ring;
+    int use_ring;
+    int write;
+    int fixed;                  ///< slot buffers are registered with the ring
+    uint8_t *ring_buf;
+    FileRingSlot *slots;
+    int head;                   ///< oldest slot in use
+    int nb_used;                ///< slots with a request that was not consumed
+    int nb_pending;             ///< slots with a request in flight
+    int64_t next_offset;        ///< file offset of the next readahead request
 #endif
 } FileContext;
 
@@ -87,6 +151,14 @@ static const AVOption file_options[] = {
     { "blocksize", "set I/O operation maximum block size", offsetof(FileContext, blocksize), AV_OPT_TYPE_INT, { .i64 = INT_MAX }, 1, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM },
     { "follow", "Follow a file as it is being written", offsetof(FileContext, follow), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
     { "seekable", "Sets if the file is seekable", offsetof(FileContext, seekable), AV_OPT_TYPE_INT, { .i64 = -1 }, -1, 0, AV_OPT_FLAG_DECODING_PARAM | AV_OPT_FLAG_ENCODING_PARAM },
+    { "io_uring", "use io_uring for asynchronous reads and writes of regular files", offsetof(FileContext, io_uring), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_DECODING_PARAM | AV_OPT_FLAG_ENCODING_PARAM },
+    { "io_uring_depth", "number of io_uring requests in flight", offsetof(FileContext, ring_depth), AV_OPT_TYPE_INT, { .i64 = 4 }, 1, 64, AV_OPT_FLAG_DECODING_PARAM | AV_OPT_FLAG_ENCODING_PARAM },
+    { "io_uring_block_size", "size of each io_uring request", offsetof(FileContext, ring_block_size), AV_OPT_TYPE_INT, { .i64 = 1 << 20 }, 4096, 1 << 26, AV_OPT_FLAG_DECODING_PARAM | AV_OPT_FLAG_ENCODING_PARAM },
+    { "direct", "write with O_DIRECT from an aligned coalescing buffer", offsetof(FileContext, direct), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_ENCODING_PARAM },
+    { "direct_buffer_size", "size of the O_DIRECT coalescing buffer", offsetof(FileContext, direct_buffer_size), AV_OPT_TYPE_INT, { .i64 = 4 << 20 }, DIRECT_ALIGN, 1 << 28, AV_OPT_FLAG_ENCODING_PARAM },
+    { "preallocate", "preallocate disk space in chunks of this many bytes", offsetof(FileContext, prealloc_size), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, AV_OPT_FLAG_ENCODING_PARAM },
+    { "sync_size", "start writeback every time this many bytes were written", offsetof(FileContext, sync_size), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, AV_OPT_FLAG_ENCODING_PARAM },
+    { "mmap", "read regular files through a memory mapping", offsetof(FileContext, use_mmap), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
     { NULL }
 };
 
@@ -109,11 +181,603 @@ static const AVClass pipe_class = {
     .version    = LIBAVUTIL_VERSION_INT,
 };
 
+#if HAVE_IO_URING
+/* In io_uring mode, reads are issued ahead of the current position into a
+ * ring of slots and consumed in file order. Writes are copied to a slot and
+ * completed asynchronously, with at most io_uring_depth requests in flight;
+ * their errors are returned by a later write, seek or close. */
+
+static int ring_submit(FileContext *c, FileRingSlot *slot,
+                       int64_t offset, int size)
+{
+    struct io_uring_sqe *sqe = ff_io_uring_get_sqe(&c->ring);
+    int idx = slot - c->slots;
+
+    if (!sqe)
+        return AVERROR(EAGAIN);
+
+    if (c->fixed) {
+        sqe->opcode    = c->write ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+        sqe->buf_index = idx;
+    } else {
+        sqe->opcode    = c->write ? IORING_OP_WRITE : IORING_OP_READ;
+    }
+    sqe->fd        = c->fd;
+    sqe->addr      = (uintptr_t)slot->data;
+    sqe->len       = size;
+    sqe->off       = offset;
+    sqe->user_data = idx;
+
+    slot->offset  = offset;
+    slot->size    = size;
+    slot->len     = 0;
+    slot->pos     = 0;
+    slot->pending = 1;
+    c->nb_pending++;
+    return 0;
+}
+
+/* Submit queued requests and collect completions, waiting for at least one
+ * if wait is set. */
+static int ring_reap(FileContext *c, int wait)
+{
+    uint64_t idx;
+    int res, ret;
+
+    ret = ff_io_uring_submit(&c->ring, wait);
+    if (ret < 0)
+        return ret;
+
+    while (ff_io_uring_reap(&c->ring, &idx, &res)) {
+        FileRingSlot *slot = &c->slots[idx];
+        slot->len     = res;
+        slot->pending = 0;
+        c->nb_pending--;
+    }
+    return 0;
+}
+
+static int ring_wait(FileContext *c, FileRingSlot *slot)
+{
+    while (slot->pending) {
+        int ret = ring_reap(c, 1);
+        if (ret < 0)
+            return ret;
+    }
+    return 0;
+}
+
+static void ring_pop(FileContext *c)
+{
+    c->head = (c->head + 1) % c->ring_depth;
+    c->nb_used--;
+}
+
+static int ring_finish_write(FileContext *c, FileRingSlot *slot)
+{
+    int done = slot->len;
+
+    if (done < 0)
+        return AVERROR(-done);
+
+    /* complete short writes synchronously */
+    while (done < slot->size) {
+        ssize_t ret = pwrite(c->fd, slot->data + done, slot->size - done,
+                             slot->offset + done);
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            return AVERROR(errno);
+        }
+        if (!ret)
+            return AVERROR(EIO);
+        done += ret;
+    }
+    return 0;
+}
+
+/* Wait for all requests and release all slots. */
+static int ring_drain(FileContext *c)
+{
+    int ret = 0, err;
+
+    while (c->nb_pending) {
+        err = ring_reap(c, 1);
+        if (err < 0)
+            return err;
+    }
+    while (c->nb_used) {
+        if (c->write) {
+            err = ring_finish_write(c, &c->slots[c->head]);
+            if (err < 0 && !ret)
+                ret = err;
+        }
+        ring_pop(c);
+    }
+    c->head = 0;
+    return ret;
+}
+
+static int ring_readahead(FileContext *c)
+{
+    int ret;
+
+    while (c->nb_used < c->ring_depth) {
+        FileRingSlot *slot = &c->slots[(c->head + c->nb_used) % c->ring_depth];
+
+        /* the slot may still be busy if it was skipped by a seek */
+        if ((ret = ring_wait(c, slot)) < 0 ||
+            (ret = ring_submit(c, slot, c->next_offset, c->ring_block_size)) < 0)
+            return ret;
+        c->next_offset += c->ring_block_size;
+        c->nb_used++;
+    }
+    return ff_io_uring_submit(&c->ring, 0);
+}
+
+static int ring_restart(FileContext *c, int64_t pos)
+{
+    int ret = ring_drain(c);
+    c->pos = c->next_offset = pos;
+    return ret;
+}
+
+static int ring_read(FileContext *c, unsigned char *buf, int size)
+{
+    FileRingSlot *slot;
+    int ret;
+
+    if (!c->nb_used && (ret = ring_readahead(c)) < 0)
+        return ret;
+
+    slot = &c->slots[c->head];
+    if ((ret = ring_wait(c, slot)) < 0)
+        return ret;
+    if (slot->len < 0) {
+        ret = AVERROR(-slot->len);
+        /* retry from the same position on the next call */
+        ring_restart(c, c->pos);
+        return ret;
+    }
+    if (slot->pos == slot->len)
+        return AVERROR_EOF;
+
+    size = FFMIN(size, slot->len - slot->pos);
+    memcpy(buf, slot->data + slot->pos, size);
+    slot->pos += size;
+    c->pos    += size;
+
+    /* Errors while refilling the ring are returned by the next call. */
+    if (slot->pos == slot->len) {
+        if (slot->len < slot->size) {
+            /* Short read, normally at the end of the file: the following
+             * requests do not start at the current position. */
+            ring_restart(c, c->pos);
+        } else {
+            ring_pop(c);
+            ring_readahead(c);
+        }
+    }
+    return size;
+}
+
+static int ring_write(FileContext *c, const unsigned char *buf, int size)
+{
+    FileRingSlot *slot;
+    int ret;
+
+    if (c->nb_used == c->ring_depth) {
+        /* the window is full, retire the oldest write */
+        slot = &c->slots[c->head];
+        if ((ret = ring_wait(c, slot)) < 0)
+            return ret;
+        ret = ring_finish_write(c, slot);
+        ring_pop(c);
+        if (ret < 0)
+            return ret;
+    }
+
+    slot = &c->slots[(c->head + c->nb_used) % c->ring_depth];
+    size = FFMIN(size, c->ring_block_size);
+    memcpy(slot->data, buf, size);
+    if ((ret = ring_submit(c, slot, c->pos, size)) < 0)
+        return ret;
+    c->nb_used++;
+    c->pos += size;
+
+    ret = ring_reap(c, 0);
+    return ret < 0 ? ret : size;
+}
+
+static int64_t ring_seek(FileContext *c, int64_t pos, int whence)
+{
+    struct stat st;
+    int ret;
+
+    /* Writes must complete before they are overwritten or counted in the
+     * file size. */
+    if (c->write && (whence != SEEK_SET || pos != c->pos)) {
+        if ((ret = ring_drain(c)) < 0)
+            return ret;
+    }
+
+    if (whence == AVSEEK_SIZE || whence == SEEK_END) {
+        if (fstat(c->fd, &st) < 0)
+            return AVERROR(errno);
+        if (whence == AVSEEK_SIZE)
+            return st.st_size;
+        pos += st.st_size;
+    } else if (whence == SEEK_CUR) {
+        pos += c->pos;
+    } else if (whence != SEEK_SET) {
+        return AVERROR(EINVAL);
+    }
+    if (pos < 0)
+        return AVERROR(EINVAL);
+
+    if (!c->write) {
+        /* keep the readahead if it covers the new position */
+        for (int i = 0; i < c->nb_used; i++) {
+            FileRingSlot *slot = &c->slots[(c->head + i) % c->ring_depth];
+
+            if (pos < slot->offset || pos >= slot->offset + slot->size)
+                continue;
+            if ((ret = ring_wait(c, slot)) < 0)
+                return ret;
+            if (pos - slot->offset < slot->len) {
+                while (i--)
+                    ring_pop(c);
+                slot->pos = pos - slot->offset;
+                c->pos    = pos;
+                ring_readahead(c);
+                return pos;
+            }
+            break;
+        }
+    }
+
+    if ((ret = ring_restart(c, pos)) < 0)
+        return ret;
+    return pos;
+}
+
+static int ring_close(FileContext *c)
+{
+    int ret = ring_drain(c);
+
+    /* do not free buffers the kernel may still access */
+    if (c->nb_pending)
+        c->ring_buf = NULL;
+
+    ff_io_uring_free(&c->ring);
+    av_freep(&c->ring_buf);
+    av_freep(&c->slots);
+    c->use_ring = 0;
+    return ret;
+}
+
+static int ring_open(FileContext *c, int flags)
+{
+    struct iovec *iov;
+    int ret;
+
+    ret = ff_io_uring_init(&c->ring, c->ring_depth);
+    if (ret < 0)
+        return ret;
+
+    c->ring_buf = av_malloc((size_t)c->ring_depth * c->ring_block_size);
+    c->slots    = av_calloc(c->ring_depth, sizeof(*c->slots));
+    iov         = av_calloc(c->ring_depth, sizeof(*iov));
+    if (!c->ring_buf || !c->slots || !iov) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    for (int i = 0; i < c->ring_depth; i++) {
+        c->slots[i].data = c->ring_buf + (size_t)i * c->ring_block_size;
+        iov[i].iov_base  = c->slots[i].data;
+        iov[i].iov_len   = c->ring_block_size;
+    }
+
+    /* Registered buffers save mapping them for every request, but are pinned
+     * in memory, which may exceed RLIMIT_MEMLOCK on older kernels. */
+    c->fixed = ff_io_uring_register_buffers(&c->ring, iov, c->ring_depth) >= 0;
+    av_freep(&iov);
+
+    /* IORING_OP_READ and IORING_OP_WRITE came with this feature in Linux 5.6 */
+    if (!c->fixed && !(c->ring.features & IORING_FEAT_RW_CUR_POS)) {
+        ret = AVERROR(ENOSYS);
+        goto fail;
+    }
+
+    c->write    = !!(flags & AVIO_FLAG_WRITE);
+    c->use_ring = 1;
+    return 0;
+fail:
+    av_free(iov);
+    ring_close(c);
+    return ret;
+}
+#endif /* HAVE_IO_URING */
+
+#ifdef O_DIRECT
+static int direct_set(FileContext *c, int enable)
+{
+    int flags = fcntl(c->fd, F_GETFL);
+
+    if (flags < 0)
+        return AVERROR(errno);
+    flags = enable ? flags | O_DIRECT : flags & ~O_DIRECT;
+    return fcntl(c->fd, F_SETFL, flags) < 0 ? AVERROR(errno) : 0;
+}
+
+/* Write dbuf[lo..hi), with O_DIRECT only if aligned is set. */
+static int direct_write_range(FileContext *c, int lo, int hi, int aligned)
+{
+    int ret = 0, err;
+
+    if (lo == hi)
+        return 0;
+    if (!aligned && (ret = direct_set(c, 0)) < 0)
+        return ret;
+
+    while (lo < hi) {
+        ssize_t n = pwrite(c->fd, c->dbuf + lo, hi - lo, c->dbase + lo);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            ret = AVERROR(errno);
+            break;
+        }
+        if (!n) {
+            ret = AVERROR(EIO);
+            break;
+        }
+        lo += n;
+    }
+
+    if (!aligned && (err = direct_set(c, 1)) < 0 && !ret)
+        ret = err;
+    return ret;
+}
+
+/* Write the whole blocks in dbuf with O_DIRECT and the partial blocks at
+ * either end without. Unless final is set, the partial block at the end is
+ * kept to be completed by the next writes. */
+static int direct_flush(FileContext *c, int final)
+{
+    int lo  = c->dlo, hi = c->dfill;
+    int alo = FFMIN(FFALIGN(lo, DIRECT_ALIGN), hi);
+    int ahi = FFMAX(hi & ~(DIRECT_ALIGN - 1), alo);
+    int ret;
+
+    if ((ret = direct_write_range(c, lo,  alo, 0)) < 0 ||
+        (ret = direct_write_range(c, alo, ahi, 1)) < 0)
+        return ret;
+    c->dlo = ahi;
+    if (final) {
+        if ((ret = direct_write_range(c, ahi, hi, 0)) < 0)
+            return ret;
+        c->dlo = hi;
+    }
+
+    memmove(c->dbuf, c->dbuf + ahi, hi - ahi);
+    c->dbase += ahi;
+    c->dlo   -= ahi;
+    c->dfill -= ahi;
+    return 0;
+}
+
+static int direct_write(FileContext *c, const unsigned char *buf, int size)
+{
+    int ret;
+
+    if (c->dfill == c->direct_buffer_size && (ret = direct_flush(c, 0)) < 0)
+        return ret;
+
+    size = FFMIN(size, c->direct_buffer_size - c->dfill);
+    memcpy(c->dbuf + c->dfill, buf, size);
+    c->dfill += size;
+    c->pos   += size;
+    return size;
+}
+
+static int64_t direct_seek(FileContext *c, int64_t pos, int whence)
+{
+    struct stat st;
+    int ret;
+
+    if (whence == AVSEEK_SIZE || whence == SEEK_END) {
+        if (fstat(c->fd, &st) < 0)
+            return AVERROR(errno);
+        st.st_size = FFMAX(st.st_size, c->dbase + c->dfill);
+        if (whence == AVSEEK_SIZE)
+            return st.st_size;
+        pos += st.st_size;
+    } else if (whence == SEEK_CUR) {
+        pos += c->pos;
+    } else if (whence != SEEK_SET) {
+        return AVERROR(EINVAL);
+    }
+    if (pos < 0)
+        return AVERROR(EINVAL);
+    if (pos == c->pos)
+        return pos;
+
+    if ((ret = direct_flush(c, 1)) < 0)
+        return ret;
+    c->dbase = pos & ~(int64_t)(DIRECT_ALIGN - 1);
+    c->dlo   = c->dfill = pos - c->dbase;
+    c->pos   = pos;
+    return pos;
+}
+
+static int direct_open(URLContext *h, const struct stat *st)
+{
+    FileContext *c = h->priv_data;
+
+    /* devices and the like deal with alignment themselves, if at all */
+    if (!S_ISREG(st->st_mode))
+        return direct_set(c, 0);
+
+    c->direct_buffer_size = FFALIGN(c->direct_buffer_size, DIRECT_ALIGN);
+    c->dbuf_alloc = av_malloc(c->direct_buffer_size + DIRECT_ALIGN - 1);
+    if (!c->dbuf_alloc)
+        return AVERROR(ENOMEM);
+    c->dbuf = (uint8_t *)FFALIGN((uintptr_t)c->dbuf_alloc, DIRECT_ALIGN);
+    return 0;
+}
+#endif /* O_DIRECT */
+
+#if HAVE_FALLOCATE
+/* Reserve disk space up to at least end, without changing the file size. */
+static int file_preallocate(URLContext *h, int64_t end)
+{
+    FileContext *c = h->priv_data;
+    int64_t new_end;
+
+    if (end <= c->prealloc_end)
+        return 0;
+
+    new_end = (end / c->prealloc_size + 1) * c->prealloc_size;
+    if (fallocate(c->fd, FALLOC_FL_KEEP_SIZE, c->prealloc_end,
+                  new_end - c->prealloc_end) < 0) {
+        int ret = AVERROR(errno);
+        if (errno != EOPNOTSUPP && errno != ENOSYS)
+            return ret;
+        av_log(h, AV_LOG_VERBOSE, "Preallocation not supported: %s\n",
+               av_err2str(ret));
+        c->prealloc_size = 0;
+        return 0;
+    }
+    c->prealloc_end = new_end;
+    return 0;
+}
+#endif
+
+#if HAVE_SYNC_FILE_RANGE
+/* Start writeback of the data written since the last call once there is
+ * sync_size of it, and wait for the range started by the previous call, so
+ * that the amount of dirty data stays bounded. */
+static void file_sync_range(FileContext *c)
+{
+    if (c->pos - c->sync_start < c->sync_size)
+        return;
+
+    sync_file_range(c->fd, c->sync_start, c->pos - c->sync_start,
+                    SYNC_FILE_RANGE_WRITE);
+    if (c->sync_start > c->sync_prev)
+        sync_file_range(c->fd, c->sync_prev, c->sync_start - c->sync_prev,
+                        SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE |
+                        SYNC_FILE_RANGE_WAIT_AFTER);
+    c->sync_prev  = c->sync_start;
+    c->sync_start = c->pos;
+}
+#endif
+
+#if HAVE_MMAP
+/* The mapping is handed out to the AVIOContext, which reads from it instead
+ * of calling file_read(), and from there to packets. It stays valid until
+ * the last reference is gone, even after the file is closed. */
+
+static void file_unmap(void *opaque, uint8_t *data)
+{
+    munmap(data, (size_t)(uintptr_t)opaque);
+}
+
+static int file_map(URLContext *h, const struct stat *st)
+{
+    FileContext *c = h->priv_data;
+    void *map;
+
+    if (st->st_size <= 0 || (uint64_t)st->st_size > SIZE_MAX)
+        return AVERROR(EINVAL);
+
+    /* private writable pages, so that a stray write into the data only
+     * modifies a copy instead of crashing */
+    map = mmap(NULL, st->st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, c->fd, 0);
+    if (map == MAP_FAILED)
+        return AVERROR(errno);
+
+    c->map = av_buffer_create(map, st->st_size, file_unmap,
+                              (void *)(uintptr_t)st->st_size,
+                              AV_BUFFER_FLAG_READONLY);
+    if (!c->map) {
+        munmap(map, st->st_size);
+        return AVERROR(ENOMEM);
+    }
+    return 0;
+}
+
+static int file_get_mapping(URLContext *h, AVBufferRef **buf)
+{
+    FileContext *c = h->priv_data;
+
+    if (!c->map)
+        return AVERROR(ENOSYS);
+    *buf = av_buffer_ref(c->map);
+    return *buf ? 0 : AVERROR(ENOMEM);
+}
+
+static void file_unmap_range(void *opaque, uint8_t *data)
+{
+    uintptr_t page = sysconf(_SC_PAGESIZE);
+
+    munmap((void *)((uintptr_t)data & ~(page - 1)), (size_t)(uintptr_t)opaque);
+}
+
+/* The whole pages of the range are mapped from the file again, read-only and
+ * without a copy. The rest of the range is copied into anonymous memory
+ * following them, which provides the zeroed padding. */
+static int file_map_range(URLContext *h, int64_t pos, int size, int padding,
+                          AVBufferRef **buf)
+{
+    FileContext *c = h->priv_data;
+    size_t page = sysconf(_SC_PAGESIZE);
+    int64_t start;
+    size_t off, head, len;
+    uint8_t *map;
+    int ret;
+
+    if (!c->map || pos < 0 || size <= 0 || padding < 0 ||
+        pos > c->map->size - size)
+        return AVERROR(EINVAL);
+
+    start = pos & ~(int64_t)(page - 1);
+    off   = pos - start;
+    head  = (off + size) & ~(page - 1);
+    len   = FFALIGN(off + size + padding, page);
+
+    map = mmap(NULL, len, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (map == MAP_FAILED)
+        return AVERROR(errno);
+    if (head && mmap(map, head, PROT_READ, MAP_PRIVATE | MAP_FIXED,
+                     c->fd, start) == MAP_FAILED) {
+        ret = AVERROR(errno);
+        munmap(map, len);
+        return ret;
+    }
+    memcpy(map + head, c->map->data + start + head, off + size - head);
+
+    *buf = av_buffer_create(map + off, size + padding, file_unmap_range,
+                            (void *)(uintptr_t)len, AV_BUFFER_FLAG_READONLY);
+    if (!*buf) {
+        munmap(map, len);
+        return AVERROR(ENOMEM);
+    }
+    return 0;
+}
+#endif
+
 static int file_read(URLContext *h, unsigned char *buf, int size)
 {
     FileContext *c = h->priv_data;
     int ret;
     size = FFMIN(size, c->blocksize);
+#if HAVE_IO_URING
+    if (c->use_ring)
+        return ring_read(c, buf, size);
+#endif
     ret = read(c->fd, buf, size);
     if (ret == 0 && c->follow)
         return AVERROR(EAGAIN);
@@ -127,8 +791,32 @@ static int file_write(URLContext *h, const unsigned char *buf, int size)
     FileContext *c = h->priv_data;
     int ret;
     size = FFMIN(size, c->blocksize);
-    ret = write(c->fd, buf, size);
-    return (ret == -1) ? AVERROR(errno) : ret;
+#if HAVE_FALLOCATE
+    if (c->prealloc_size && (ret = file_preallocate(h, c->pos + size)) < 0)
+        return ret;
+#endif
+#ifdef O_DIRECT
+    if (c->dbuf)
+        return direct_write(c, buf, size);
+#endif
+#if HAVE_IO_URING
+    if (c->use_ring) {
+        ret = ring_write(c, buf, size);
+        if (ret < 0)
+            return ret;
+    } else
+#endif
+    {
+        ret = write(c->fd, buf, size);
+        if (ret == -1)
+            return AVERROR(errno);
+        c->pos += ret;
+    }
+#if HAVE_SYNC_FILE_RANGE
+    if (c->sync_size)
+        file_sync_range(c);
+#endif
+    return ret;
 }
 
 static int file_get_handle(URLContext *h)
@@ -226,14 +914,86 @@ static int file_open(URLContext *h, const char *filename, int flags)
     }
 #ifdef O_BINARY
     access |= O_BINARY;
+#endif
+#ifdef O_DIRECT
+    if (c->direct && (flags & AVIO_FLAG_READ_WRITE) == AVIO_FLAG_WRITE)
+        access |= O_DIRECT;
 #endif
     fd = avpriv_open(filename, access, 0666);
+#ifdef O_DIRECT
+    if (fd == -1 && errno == EINVAL && access & O_DIRECT) {
+        av_log(h, AV_LOG_VERBOSE, "O_DIRECT not supported, using buffered writes\n");
+        access &= ~O_DIRECT;
+        fd = avpriv_open(filename, access, 0666);
+    }
+#endif
     if (fd == -1)
         return AVERROR(errno);
     c->fd = fd;
 
     h->is_streamed = !fstat(fd, &st) && S_ISFIFO(st.st_mode);
 
+#ifdef O_DIRECT
+    if (access & O_DIRECT) {
+        int ret;
+        if (fstat(fd, &st) < 0)
+            ret = AVERROR(errno);
+        else
+            ret = direct_open(h, &st);
+        if (ret < 0) {
+            close(fd);
+            return ret;
+        }
+        if (c->dbuf)
+            av_log(h, AV_LOG_DEBUG, "Using O_DIRECT with a %d byte buffer\n",
+                   c->direct_buffer_size);
+    }
+#endif
+#if HAVE_FALLOCATE
+    /* existing data is allocated already */
+    if (c->prealloc_size && !(access & O_TRUNC) && !fstat(fd, &st))
+        c->prealloc_end = st.st_size;
+#endif
+
+#if HAVE_MMAP
+    if (c->use_mmap) {
+        int ret;
+        if (flags & AVIO_FLAG_WRITE || c->follow ||
+            fstat(fd, &st) || !S_ISREG(st.st_mode))
+            av_log(h, AV_LOG_VERBOSE, "mmap is only used for regular files "
+                   "opened for reading\n");
+        else if ((ret = file_map(h, &st)) < 0)
+            av_log(h, AV_LOG_VERBOSE, "Cannot map the file (%s), "
+                   "falling back to read()\n", av_err2str(ret));
+        else
+            av_log(h, AV_LOG_DEBUG, "Mapped %"PRId64" bytes\n",
+                   (int64_t)st.st_size);
+    }
+#endif
+
+#if HAVE_IO_URING
+    if (c->io_uring && c->dbuf) {
+        av_log(h, AV_LOG_VERBOSE, "io_uring is not used together with O_DIRECT\n");
+#if HAVE_MMAP
+    } else if (c->io_uring && c->map) {
+        av_log(h, AV_LOG_VERBOSE, "io_uring is not used together with mmap\n");
+#endif
+    } else if (c->io_uring) {
+        int ret;
+        if (fstat(fd, &st) || !S_ISREG(st.st_mode) || c->follow ||
+            (flags & AVIO_FLAG_WRITE && flags & AVIO_FLAG_READ))
+            av_log(h, AV_LOG_VERBOSE, "io_uring is only used for regular "
+                   "files opened for either reading or writing\n");
+        else if ((ret = ring_open(c, flags)) < 0)
+            av_log(h, AV_LOG_VERBOSE, "io_uring unavailable (%s), "
+                   "falling back to read()/write()\n", av_err2str(ret));
+        else
+            av_log(h, AV_LOG_DEBUG, "Using io_uring with %d requests of %d bytes%s\n",
+                   c->ring_depth, c->ring_block_size,
+                   c->fixed ? " in registered buffers" : "");
+    }
+#endif
+
     /* Buffer writes more than the default 32k to improve throughput especially
      * with networked file systems */
     if (!h->is_streamed && flags & AVIO_FLAG_WRITE)
@@ -251,6 +1011,15 @@ static int64_t file_seek(URLContext *h, int64_t pos, int whence)
     FileContext *c = h->priv_data;
     int64_t ret;
 
+#ifdef O_DIRECT
+    if (c->dbuf)
+        return direct_seek(c, pos, whence);
+#endif
+#if HAVE_IO_URING
+    if (c->use_ring)
+        return ring_seek(c, pos, whence);
+#endif
+
     if (whence == AVSEEK_SIZE) {
         struct stat st;
         ret = fstat(c->fd, &st);
@@ -258,15 +1027,43 @@ static int64_t file_seek(URLContext *h, int64_t pos, int whence)
     }
 
     ret = lseek(c->fd, pos, whence);
-
-    return ret < 0 ? AVERROR(errno) : ret;
+    if (ret < 0)
+        return AVERROR(errno);
+    c->pos = ret;
+    return ret;
 }
 
 static int file_close(URLContext *h)
 {
     FileContext *c = h->priv_data;
-    int ret = close(c->fd);
-    return (ret == -1) ? AVERROR(errno) : 0;
+    int ret = 0, err;
+#ifdef O_DIRECT
+    if (c->dbuf) {
+        ret = direct_flush(c, 1);
+        av_freep(&c->dbuf_alloc);
+        c->dbuf = NULL;
+    }
+#endif
+#if HAVE_IO_URING
+    if (c->use_ring && (err = ring_close(c)) < 0 && !ret)
+        ret = err;
+#endif
+#if HAVE_MMAP
+    av_buffer_unref(&c->map);
+#endif
+#if HAVE_FALLOCATE
+    /* release the space preallocated beyond the end of the file */
+    if (c->prealloc_end) {
+        struct stat st;
+        if (!fstat(c->fd, &st) && st.st_size < c->prealloc_end &&
+            ftruncate(c->fd, st.st_size) < 0 && !ret)
+            ret = AVERROR(errno);
+    }
+#endif
+    err = close(c->fd);
+    if (err == -1 && !ret)
+        ret = AVERROR(errno);
+    return ret;
 }
 
 static int file_open_dir(URLContext *h)
@@ -361,6 +1158,10 @@ const URLProtocol ff_file_protocol = {
     .url_seek            = file_seek,
     .url_close           = file_close,
     .url_get_file_handle = file_get_handle,
+#if HAVE_MMAP
+    .url_get_mapping     = file_get_mapping,
+    .url_map_range       = file_map_range,
+#endif
     .url_check           = file_check,
     .url_delete          = file_delete,
     .url_move            = file_move,
@@ -537,6 +537,14 @@ int ff_get_line(AVIOContext *s, char *buf, int maxlen);
  */
 int ff_get_chomp_line(AVIOContext *s, char *buf, int maxlen);
 
+/**
+ * Like av_get_packet(), but the packet may reference the AVIOContext
+ * buffer instead of owning a copy of the data, see ffio_read_ref().
+ * Demuxers using it must not modify the packet data without calling
+ * av_packet_make_writable() first.
+ */
+int ff_get_packet_ref(AVIOContext *s, AVPacket *pkt, int size);
+
 #define SPACE_CHARS " \t\r\n"
 
 /**
@@ -0,0 +1,200 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#define _DEFAULT_SOURCE /* needed for syscall() and MAP_POPULATE */
+
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "libavutil/common.h"
+#include "libavutil/error.h"
+
+#include "iouring.h"
+
+static int sys_io_uring_setup(unsigned entries, struct io_uring_params *p)
+{
+    return syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sys_io_uring_enter(int fd, unsigned to_submit,
+                              unsigned min_complete, unsigned flags)
+{
+    return syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags,
+                   NULL, 0);
+}
+
+static int sys_io_uring_register(int fd, unsigned opcode,
+                                 const void *arg, unsigned nr_args)
+{
+    return syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+static void *map_ring(int fd, size_t size, off_t offset)
+{
+    void *ptr = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, fd, offset);
+    return ptr == MAP_FAILED ? NULL : ptr;
+}
+
+int ff_io_uring_init(FFIOUring *ring, unsigned entries)
+{
+    struct io_uring_params p = { 0 };
+    uint8_t *sq, *cq;
+    int ret;
+
+    memset(ring, 0, sizeof(*ring));
+
+    ring->fd = sys_io_uring_setup(entries, &p);
+    if (ring->fd < 0) {
+        ring->fd = -1;
+        return AVERROR(errno);
+    }
+    ring->features = p.features;
+
+    /* Older kernels need separate mappings for the two rings, which are
+     * not worth supporting. */
+    if (!(p.features & IORING_FEAT_SINGLE_MMAP)) {
+        ret = AVERROR(ENOSYS);
+        goto fail;
+    }
+
+    ring->sq_ring_size = FFMAX(p.sq_off.array + p.sq_entries * sizeof(unsigned),
+                               p.cq_off.cqes  + p.cq_entries * sizeof(struct io_uring_cqe));
+    ring->sq_ring = map_ring(ring->fd, ring->sq_ring_size, IORING_OFF_SQ_RING);
+    if (!ring->sq_ring) {
+        ret = AVERROR(errno);
+        goto fail;
+    }
+    ring->cq_ring = ring->sq_ring;
+
+    ring->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = map_ring(ring->fd, ring->sqes_size, IORING_OFF_SQES);
+    if (!ring->sqes) {
+        ret = AVERROR(errno);
+        goto fail;
+    }
+
+    sq = ring->sq_ring;
+    ring->sq_head    = (atomic_uint *)(sq + p.sq_off.head);
+    ring->sq_tail    = (atomic_uint *)(sq + p.sq_off.tail);
+    ring->sq_mask    = *(unsigned *)(sq + p.sq_off.ring_mask);
+    ring->sq_entries = *(unsigned *)(sq + p.sq_off.ring_entries);
+    ring->sq_array   = (unsigned *)(sq + p.sq_off.array);
+
+    cq = ring->cq_ring;
+    ring->cq_head    = (atomic_uint *)(cq + p.cq_off.head);
+    ring->cq_tail    = (atomic_uint *)(cq + p.cq_off.tail);
+    ring->cq_mask    = *(unsigned *)(cq + p.cq_off.ring_mask);
+    ring->cqes       = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+
+    return 0;
+fail:
+    ff_io_uring_free(ring);
+    return ret;
+}
+
+void ff_io_uring_free(FFIOUring *ring)
+{
+    if (ring->sqes)
+        munmap(ring->sqes, ring->sqes_size);
+    if (ring->sq_ring)
+        munmap(ring->sq_ring, ring->sq_ring_size);
+    if (ring->fd >= 0)
+        close(ring->fd);
+    memset(ring, 0, sizeof(*ring));
+    ring->fd = -1;
+}
+
+int ff_io_uring_register_buffers(FFIOUring *ring,
+                                 const struct iovec *iov, unsigned nb)
+{
+    if (sys_io_uring_register(ring->fd, IORING_REGISTER_BUFFERS, iov, nb) < 0)
+        return AVERROR(errno);
+    return 0;
+}
+
+struct io_uring_sqe *ff_io_uring_get_sqe(FFIOUring *ring)
+{
+    /* Only we write the tail, the kernel advances the head. Queued SQEs are
+     * published by moving the tail in ff_io_uring_submit(). */
+    unsigned tail = atomic_load_explicit(ring->sq_tail, memory_order_relaxed) +
+                    ring->sq_queued;
+    unsigned head = atomic_load_explicit(ring->sq_head, memory_order_acquire);
+    struct io_uring_sqe *sqe;
+    unsigned idx;
+
+    if (tail - head >= ring->sq_entries)
+        return NULL;
+
+    idx = tail & ring->sq_mask;
+    sqe = &ring->sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    ring->sq_array[idx] = idx;
+    ring->sq_queued++;
+    return sqe;
+}
+
+int ff_io_uring_submit(FFIOUring *ring, unsigned wait_nr)
+{
+    unsigned to_submit = ring->sq_queued;
+    int ret;
+
+    if (to_submit) {
+        unsigned tail = atomic_load_explicit(ring->sq_tail, memory_order_relaxed);
+        atomic_store_explicit(ring->sq_tail, tail + to_submit, memory_order_release);
+        ring->sq_queued = 0;
+    }
+
+    while (to_submit || wait_nr) {
+        ret = sys_io_uring_enter(ring->fd, to_submit, wait_nr,
+                                 wait_nr ? IORING_ENTER_GETEVENTS : 0);
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            return AVERROR(errno);
+        }
+        /* The kernel only waits once all SQEs have been consumed. It may
+         * also return early on a signal, so callers waiting for a specific
+         * completion must check for it and wait again. */
+        if (!ret && to_submit)
+            return AVERROR(EAGAIN);
+        to_submit -= FFMIN(to_submit, ret);
+        if (!to_submit)
+            break;
+    }
+    return 0;
+}
+
+int ff_io_uring_reap(FFIOUring *ring, uint64_t *user_data, int *res)
+{
+    unsigned head = atomic_load_explicit(ring->cq_head, memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(ring->cq_tail, memory_order_acquire);
+    const struct io_uring_cqe *cqe;
+
+    if (head == tail)
+        return 0;
+
+    cqe = &ring->cqes[head & ring->cq_mask];
+    *user_data = cqe->user_data;
+    *res       = cqe->res;
+    atomic_store_explicit(ring->cq_head, head + 1, memory_order_release);
+    return 1;
+}
@@ -0,0 +1,101 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Minimal io_uring wrapper on top of the raw system calls.
+ */
+
+#ifndef AVFORMAT_IOURING_H
+#define AVFORMAT_IOURING_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+
+typedef struct FFIOUring {
+    int fd;
+    unsigned features;          ///< IORING_FEAT_* flags of the kernel
+
+    void  *sq_ring;
+    size_t sq_ring_size;
+    void  *cq_ring;
+    struct io_uring_sqe *sqes;
+    size_t sqes_size;
+
+    atomic_uint *sq_head;
+    atomic_uint *sq_tail;
+    unsigned     sq_mask;
+    unsigned     sq_entries;
+    unsigned    *sq_array;
+    unsigned     sq_queued;     ///< SQEs filled in but not yet submitted
+
+    atomic_uint *cq_head;
+    atomic_uint *cq_tail;
+    unsigned     cq_mask;
+    struct io_uring_cqe *cqes;
+} FFIOUring;
+
+/**
+ * Set up a ring with room for at least entries submissions.
+ *
+ * @return 0 on success, a negative AVERROR code if the kernel lacks io_uring
+ *         support or does not allow its use
+ */
+int ff_io_uring_init(FFIOUring *ring, unsigned entries);
+
+/**
+ * Tear down a ring set up with ff_io_uring_init(). All submitted requests
+ * must have completed.
+ */
+void ff_io_uring_free(FFIOUring *ring);
+
+/**
+ * Register buffers for use with IORING_OP_READ_FIXED and
+ * IORING_OP_WRITE_FIXED; buf_index in the SQE refers to iov[buf_index].
+ */
+int ff_io_uring_register_buffers(FFIOUring *ring,
+                                 const struct iovec *iov, unsigned nb);
+
+/**
+ * Get a zeroed SQE to fill in. It is submitted by the next call to
+ * ff_io_uring_submit().
+ *
+ * @return the SQE, or NULL if the submission queue is full
+ */
+struct io_uring_sqe *ff_io_uring_get_sqe(FFIOUring *ring);
+
+/**
+ * Submit the queued SQEs and wait until at least wait_nr completions are
+ * available.
+ *
+ * @return 0 on success, a negative AVERROR code on failure
+ */
+int ff_io_uring_submit(FFIOUring *ring, unsigned wait_nr);
+
+/**
+ * Pop the oldest completion from the completion queue.
+ *
+ * @return 1 if a completion was returned in user_data and res, 0 if the
+ *         completion queue is empty
+ */
+int ff_io_uring_reap(FFIOUring *ring, uint64_t *user_data, int *res);
+
+#endif /* AVFORMAT_IOURING_H */
@@ -1063,10 +1063,24 @@ static int ebml_read_ascii(AVIOContext *pb, int size,
  * 0 is success, < 0 or NEEDS_CHECKING is failure.
  */
 static int ebml_read_binary(AVIOContext *pb, int length,
-                            int64_t pos, EbmlBin *bin)
+                            int64_t pos, EbmlBin *bin, int ref)
 {
     int ret;
 
+    /* blocks are never modified in place, so they can reference
+     * the I/O buffer instead of being copied */
+    if (ref) {
+        av_buffer_unref(&bin->buf);
+        ret = ffio_read_ref(pb, &bin->buf, length);
+        if (ret >= 0) {
+            bin->data = bin->buf->data;
+            bin->size = length;
+            bin->pos  = pos;
+            return 0;
+        } else if (ret != AVERROR(EAGAIN))
+            return ret;
+    }
+
     ret = av_buffer_realloc(&bin->buf, length + AV_INPUT_BUFFER_PADDING_SIZE);
     if (ret < 0)
         return ret;
@@ -1462,7 +1476,9 @@ static int ebml_parse(MatroskaDemuxContext *matroska,
         res = ebml_read_ascii(pb, length, syntax->def.s, data);
         break;
     case EBML_BIN:
-        res = ebml_read_binary(pb, length, pos_alt, data);
+        res = ebml_read_binary(pb, length, pos_alt, data,
+                               id == MATROSKA_ID_BLOCK ||
+                               id == MATROSKA_ID_SIMPLEBLOCK);
         break;
     case EBML_LEVEL1:
     case EBML_NEST:
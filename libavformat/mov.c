@@ -8769,6 +8769,9 @@ static int mov_read_packet(AVFormatContext *s, AVPacket *pkt)
 
         if (st->codecpar->codec_id == AV_CODEC_ID_EIA_608 && sample->size > 8)
             ret = get_eia608_packet(sc->pb, pkt, sample->size);
+        else if (!mov->aax_mode && !mov->decryption_key)
+            /* the data is only modified in place when decrypting */
+            ret = ff_get_packet_ref(sc->pb, pkt, sample->size);
         else
             ret = av_get_packet(sc->pb, pkt, sample->size);
         if (ret < 0) {
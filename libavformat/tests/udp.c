@@ -0,0 +1,130 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/error.h"
+#include "libavutil/log.h"
+#include "libavformat/url.h"
+
+#define NB_DATAGRAMS 64
+#define PKT_SIZE     1000
+
+/* datagram counts of the last "Statistics" line, -1 if none was logged */
+static int64_t stats_datagrams = -1;
+
+static void log_callback(void *ptr, int level, const char *fmt, va_list vl)
+{
+    char line[1024];
+
+    if (level > AV_LOG_VERBOSE || strncmp(fmt, "Statistics:", 11))
+        return;
+    vsnprintf(line, sizeof(line), fmt, vl);
+    sscanf(line, "Statistics: %"SCNd64, &stats_datagrams);
+}
+
+static int datagram_size(int i)
+{
+    /* shorter datagrams end the runs sent with a single GSO message */
+    return i % 7 == 6 ? PKT_SIZE / 2 : PKT_SIZE;
+}
+
+static void fill_datagram(uint8_t *buf, int i)
+{
+    for (int j = 0; j < datagram_size(i); j++)
+        buf[j] = i * 7 + j;
+}
+
+static void test(const char *rx_opts, const char *tx_opts)
+{
+    URLContext *rx = NULL, *tx = NULL;
+    uint8_t buf[2 * PKT_SIZE], ref[PKT_SIZE];
+    char url[256];
+    int64_t tx_stats, rx_stats;
+    int ret, i;
+
+    printf("receiver '%s', sender '%s': ", rx_opts, tx_opts);
+
+    snprintf(url, sizeof(url), "udp://127.0.0.1:0?timeout=1000000&%s", rx_opts);
+    ret = ffurl_open_whitelist(&rx, url, AVIO_FLAG_READ, NULL, NULL,
+                               NULL, NULL, NULL);
+    if (ret < 0)
+        goto fail;
+    snprintf(url, sizeof(url), "udp://127.0.0.1:%d?pkt_size=%d&%s",
+             ff_udp_get_local_port(rx), PKT_SIZE, tx_opts);
+    ret = ffurl_open_whitelist(&tx, url, AVIO_FLAG_WRITE, NULL, NULL,
+                               NULL, NULL, NULL);
+    if (ret < 0)
+        goto fail;
+
+    /* each datagram must arrive before the next one is written, a sender
+     * waiting for a full batch would stall here until the read times out */
+    for (i = 0; i < NB_DATAGRAMS; i++) {
+        fill_datagram(ref, i);
+        ret = ffurl_write(tx, ref, datagram_size(i));
+        if (ret < 0)
+            goto fail;
+        ret = ffurl_read(rx, buf, sizeof(buf));
+        if (ret < 0)
+            goto fail;
+        if (ret != datagram_size(i) || memcmp(buf, ref, ret)) {
+            printf("datagram %d mismatch (%d bytes)\n", i, ret);
+            ffurl_closep(&tx);
+            ffurl_closep(&rx);
+            return;
+        }
+    }
+    stats_datagrams = -1;
+    ffurl_closep(&tx);
+    tx_stats = stats_datagrams;
+
+    stats_datagrams = -1;
+    ffurl_closep(&rx);
+    rx_stats = stats_datagrams;
+
+    printf("%d datagrams received in order, batched: sent %"PRId64
+           ", received %"PRId64"\n", NB_DATAGRAMS, tx_stats, rx_stats);
+    return;
+fail:
+    printf("error %s\n", av_err2str(ret));
+    ffurl_closep(&tx);
+    ffurl_closep(&rx);
+}
+
+int main(void)
+{
+    av_log_set_level(AV_LOG_VERBOSE);
+    av_log_set_callback(log_callback);
+
+    /* unbatched reference */
+    test("fifo_size=0", "bitrate=100000000");
+    /* recvmmsg() directly, sendmmsg() from the transmit thread */
+    test("fifo_size=0&batch=8", "batch=8&bitrate=100000000");
+    /* recvmmsg() from the receive thread */
+    test("batch=8", "batch=8&bitrate=100000000");
+    test("batch=8&timestamps=1", "batch=8&bitrate=100000000");
+    /* segmentation offload, falls back to plain batches when unsupported */
+    test("fifo_size=0&gro=1", "batch=16&gso=1&bitrate=100000000");
+    test("gro=1", "batch=16&gso=1&bitrate=100000000");
+    /* batching is ignored without the transmit thread */
+    test("fifo_size=0", "batch=8");
+
+    return 0;
+}
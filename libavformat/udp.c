@@ -26,6 +26,7 @@
 
 #define _DEFAULT_SOURCE
 #define _BSD_SOURCE     /* Needed for using struct ip_mreq with recent glibc */
+#define _GNU_SOURCE     /* Needed for recvmmsg() and sendmmsg() */
 
 #include "avformat.h"
 #include "avio_internal.h"
@@ -47,6 +48,10 @@
 #include "TargetConditionals.h"
 #endif
 
+#if HAVE_RECVMMSG || HAVE_SENDMMSG
+#include <netinet/udp.h>
+#endif
+
 #if HAVE_UDPLITE_H
 #include "udplite.h"
 #else
@@ -61,6 +66,14 @@
 #define IPPROTO_UDPLITE                                  136
 #endif
 
+/* Segmentation and receive offload, missing from older system headers */
+#if defined(__linux__) && !defined(UDP_SEGMENT)
+#define UDP_SEGMENT                                      103
+#endif
+#if defined(__linux__) && !defined(UDP_GRO)
+#define UDP_GRO                                          104
+#endif
+
 #if HAVE_W32THREADS
 #undef HAVE_PTHREAD_CANCEL
 #define HAVE_PTHREAD_CANCEL 1
@@ -80,6 +93,16 @@
 #define UDP_MAX_PKT_SIZE 65536
 #define UDP_HEADER_SIZE 8
 
+/* limits of a buffer sent with UDP_SEGMENT */
+#define UDP_GSO_MAX_SIZE 65507
+#define UDP_GSO_MAX_SEGS 64
+
+/* control data received with each message: GRO segment size, timestamp and
+ * drop counter */
+#define UDP_CMSG_SPACE (CMSG_SPACE(sizeof(int)) +             \
+                        CMSG_SPACE(sizeof(struct timespec)) + \
+                        CMSG_SPACE(sizeof(uint32_t)))
+
 typedef struct UDPContext {
     const AVClass *class;
     int udp_fd;
@@ -117,6 +140,38 @@ typedef struct UDPContext {
     char *sources;
     char *block;
     IPSourceFilters filters;
+
+    int batch;
+    int gso;
+    int gro;
+    int timestamps;
+#if HAVE_RECVMMSG || HAVE_SENDMMSG
+    /* batched I/O, with one slot of mmsg_slot bytes per message */
+    int use_mmsg;               ///< receive with recvmmsg()
+    uint8_t *mmsg_buf;
+    int mmsg_slot;
+    struct mmsghdr *mmsgs;
+    struct iovec *mmsg_iov;
+    struct sockaddr_storage *mmsg_addr;
+    uint8_t *mmsg_cmsg;         ///< UDP_CMSG_SPACE bytes per message
+    int nb_mmsgs;               ///< messages received or queued for sending
+    int cur_mmsg;               ///< next received message to return
+    int seg_pos;                ///< offset of the next GRO segment in it
+    int seg_size;               ///< size of its GRO segments, 0 if not coalesced
+    int64_t recv_time;          ///< time of the last recvmmsg()
+#endif
+
+    /* statistics */
+    uint64_t nb_calls;          ///< batched system calls
+    uint64_t nb_msgs;           ///< messages received or sent by them
+    uint64_t nb_datagrams;
+    int max_batch;              ///< most messages in one call
+    uint32_t kernel_drops;      ///< datagrams dropped by the socket
+    uint64_t overruns;          ///< datagrams dropped by the circular buffer
+    uint64_t truncated;
+    uint64_t nb_delays;
+    int64_t delay_sum;          ///< receive queueing delays, in microseconds
+    int64_t delay_max;
 } UDPContext;
 
 #define OFFSET(x) offsetof(UDPContext, x)
@@ -141,6 +196,10 @@ static const AVOption options[] = {
     { "timeout",        "set raise error timeout, in microseconds (only in read mode)",OFFSET(timeout),         AV_OPT_TYPE_INT,  {.i64 = 0}, 0, INT_MAX, D },
     { "sources",        "Source list",                                     OFFSET(sources),        AV_OPT_TYPE_STRING, { .str = NULL },               .flags = D|E },
     { "block",          "Block list",                                      OFFSET(block),          AV_OPT_TYPE_STRING, { .str = NULL },               .flags = D|E },
+    { "batch",          "Number of datagrams received or sent per system call", OFFSET(batch), AV_OPT_TYPE_INT,    { .i64 = 1 },      1, 1024,    D|E },
+    { "gso",            "Send batches of datagrams with segmentation offload", OFFSET(gso),    AV_OPT_TYPE_BOOL,   { .i64 = 0 },      0, 1,       E },
+    { "gro",            "Receive datagrams coalesced by receive offload",  OFFSET(gro),            AV_OPT_TYPE_BOOL,   { .i64 = 0 },      0, 1,       D },
+    { "timestamps",     "Measure the receive queueing delay with kernel timestamps", OFFSET(timestamps), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1,       D },
     { NULL }
 };
 
@@ -480,6 +539,337 @@ static int udp_get_file_handle(URLContext *h)
     return s->udp_fd;
 }
 
+#if HAVE_RECVMMSG || HAVE_SENDMMSG
+static void udp_mmsg_free(UDPContext *s)
+{
+    av_freep(&s->mmsg_buf);
+    av_freep(&s->mmsgs);
+    av_freep(&s->mmsg_iov);
+    av_freep(&s->mmsg_addr);
+    av_freep(&s->mmsg_cmsg);
+}
+
+static int udp_mmsg_alloc(UDPContext *s, int slot)
+{
+    s->mmsg_slot = slot;
+    s->mmsg_buf  = av_malloc_array(s->batch, slot);
+    s->mmsgs     = av_calloc(s->batch, sizeof(*s->mmsgs));
+    s->mmsg_iov  = av_calloc(s->batch, sizeof(*s->mmsg_iov));
+    s->mmsg_addr = av_calloc(s->batch, sizeof(*s->mmsg_addr));
+    s->mmsg_cmsg = av_calloc(s->batch, UDP_CMSG_SPACE);
+    if (!s->mmsg_buf || !s->mmsgs || !s->mmsg_iov || !s->mmsg_addr || !s->mmsg_cmsg) {
+        udp_mmsg_free(s);
+        return AVERROR(ENOMEM);
+    }
+
+    for (int i = 0; i < s->batch; i++) {
+        s->mmsg_iov[i].iov_base        = s->mmsg_buf + (size_t)i * slot;
+        s->mmsgs[i].msg_hdr.msg_iov    = &s->mmsg_iov[i];
+        s->mmsgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    return 0;
+}
+
+static void udp_count_call(UDPContext *s, int nb_msgs)
+{
+    s->nb_calls++;
+    s->nb_msgs  += nb_msgs;
+    s->max_batch = FFMAX(s->max_batch, nb_msgs);
+}
+#endif
+
+#if HAVE_RECVMMSG
+static int udp_setup_rx(URLContext *h, int fd)
+{
+    UDPContext *s = h->priv_data;
+    int one = 1;
+
+#ifdef UDP_GRO
+    if (s->gro && setsockopt(fd, IPPROTO_UDP, UDP_GRO, &one, sizeof(one)) < 0) {
+        ff_log_net_error(h, AV_LOG_WARNING, "setsockopt(UDP_GRO)");
+        s->gro = 0;
+    }
+#else
+    if (s->gro)
+        av_log(h, AV_LOG_WARNING, "UDP_GRO is not supported on this system\n");
+#endif
+#ifdef SO_TIMESTAMPNS
+    if (s->timestamps &&
+        setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPNS, &one, sizeof(one)) < 0) {
+        ff_log_net_error(h, AV_LOG_WARNING, "setsockopt(SO_TIMESTAMPNS)");
+        s->timestamps = 0;
+    }
+#else
+    if (s->timestamps)
+        av_log(h, AV_LOG_WARNING, "SO_TIMESTAMPNS is not supported on this system\n");
+#endif
+#ifdef SO_RXQ_OVFL
+    if (setsockopt(fd, SOL_SOCKET, SO_RXQ_OVFL, &one, sizeof(one)) < 0)
+        ff_log_net_error(h, AV_LOG_VERBOSE, "setsockopt(SO_RXQ_OVFL)");
+#endif
+
+    s->use_mmsg = 1;
+    /* coalesced datagrams can be as large as the largest datagram */
+    return udp_mmsg_alloc(s, UDP_MAX_PKT_SIZE);
+}
+
+/**
+ * Receive up to batch messages, waiting for the first one only.
+ */
+static int udp_recv_batch(UDPContext *s)
+{
+    int ret;
+
+    for (int i = 0; i < s->batch; i++) {
+        struct msghdr *m = &s->mmsgs[i].msg_hdr;
+
+        s->mmsg_iov[i].iov_len = s->mmsg_slot;
+        m->msg_name       = &s->mmsg_addr[i];
+        m->msg_namelen    = sizeof(s->mmsg_addr[i]);
+        m->msg_control    = s->mmsg_cmsg + i * UDP_CMSG_SPACE;
+        m->msg_controllen = UDP_CMSG_SPACE;
+        m->msg_flags      = 0;
+    }
+
+    ret = recvmmsg(s->udp_fd, s->mmsgs, s->batch, MSG_WAITFORONE, NULL);
+    if (ret < 0)
+        return ff_neterrno();
+
+    if (s->timestamps)
+        s->recv_time = av_gettime();
+    udp_count_call(s, ret);
+    s->nb_mmsgs = ret;
+    s->cur_mmsg = 0;
+    s->seg_pos  = 0;
+    return ret;
+}
+
+static void udp_parse_cmsg(UDPContext *s, struct msghdr *m)
+{
+    struct cmsghdr *c;
+
+    s->seg_size = 0;
+    if (m->msg_flags & MSG_TRUNC)
+        s->truncated++;
+
+    for (c = CMSG_FIRSTHDR(m); c; c = CMSG_NXTHDR(m, c)) {
+#ifdef UDP_GRO
+        if (c->cmsg_level == IPPROTO_UDP && c->cmsg_type == UDP_GRO)
+            memcpy(&s->seg_size, CMSG_DATA(c), sizeof(s->seg_size));
+#endif
+#ifdef SO_TIMESTAMPNS
+        if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_TIMESTAMPNS) {
+            struct timespec ts;
+            int64_t delay;
+
+            memcpy(&ts, CMSG_DATA(c), sizeof(ts));
+            delay = s->recv_time - (ts.tv_sec * INT64_C(1000000) + ts.tv_nsec / 1000);
+            s->delay_sum += delay;
+            s->delay_max  = FFMAX(s->delay_max, delay);
+            s->nb_delays++;
+        }
+#endif
+#ifdef SO_RXQ_OVFL
+        /* the counter covers the lifetime of the socket */
+        if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SO_RXQ_OVFL)
+            memcpy(&s->kernel_drops, CMSG_DATA(c), sizeof(s->kernel_drops));
+#endif
+    }
+}
+
+/**
+ * Get the next datagram of the received batch, splitting the messages
+ * coalesced by GRO back into datagrams.
+ *
+ * @return 1 if a datagram was returned, 0 if the batch is used up
+ */
+static int udp_next_datagram(UDPContext *s, const uint8_t **data, int *len)
+{
+    while (s->cur_mmsg < s->nb_mmsgs) {
+        const struct mmsghdr *mm = &s->mmsgs[s->cur_mmsg];
+        int size = FFMIN(mm->msg_len, s->mmsg_slot);
+
+        if (!s->seg_pos) {
+            udp_parse_cmsg(s, &s->mmsgs[s->cur_mmsg].msg_hdr);
+            if (ff_ip_check_source_lists(&s->mmsg_addr[s->cur_mmsg], &s->filters)) {
+                s->cur_mmsg++;
+                continue;
+            }
+        }
+
+        *data = (const uint8_t *)s->mmsg_iov[s->cur_mmsg].iov_base + s->seg_pos;
+        *len  = s->seg_size > 0 ? FFMIN(s->seg_size, size - s->seg_pos) :
+                                  size;
+        s->seg_pos += *len;
+        if (s->seg_pos >= size) {
+            s->cur_mmsg++;
+            s->seg_pos = 0;
+        }
+        s->nb_datagrams++;
+        return 1;
+    }
+    return 0;
+}
+#endif
+
+#if HAVE_SENDMMSG && HAVE_PTHREAD_CANCEL
+#ifdef UDP_SEGMENT
+/**
+ * Send nb queued datagrams starting at first as one buffer, which the
+ * kernel or the network card splits into datagrams of mmsg_slot bytes.
+ */
+static int udp_send_gso(UDPContext *s, int first, int nb)
+{
+    union {
+        struct cmsghdr hdr;
+        uint8_t buf[CMSG_SPACE(sizeof(uint16_t))];
+    } control = { 0 };
+    struct iovec iov = {
+        .iov_base = s->mmsg_iov[first].iov_base,
+        .iov_len  = (size_t)(nb - 1) * s->mmsg_slot +
+                    s->mmsg_iov[first + nb - 1].iov_len,
+    };
+    struct msghdr m = {
+        .msg_iov        = &iov,
+        .msg_iovlen     = 1,
+        .msg_control    = control.buf,
+        .msg_controllen = sizeof(control.buf),
+    };
+    struct cmsghdr *c = CMSG_FIRSTHDR(&m);
+    uint16_t seg_size = s->mmsg_slot;
+    int ret;
+
+    if (!s->is_connected) {
+        m.msg_name    = &s->dest_addr;
+        m.msg_namelen = s->dest_addr_len;
+    }
+    c->cmsg_level = IPPROTO_UDP;
+    c->cmsg_type  = UDP_SEGMENT;
+    c->cmsg_len   = CMSG_LEN(sizeof(seg_size));
+    memcpy(CMSG_DATA(c), &seg_size, sizeof(seg_size));
+
+    do {
+        ret = sendmsg(s->udp_fd, &m, 0);
+    } while (ret < 0 && ff_neterrno() == AVERROR(EINTR));
+    return ret < 0 ? ff_neterrno() : 0;
+}
+#endif
+
+/**
+ * Send the queued datagrams, in as few system calls as possible. The queue
+ * is emptied even on failure.
+ */
+static int udp_send_batch(URLContext *h)
+{
+    UDPContext *s = h->priv_data;
+    int first = 0, ret = 0;
+
+    for (int i = 0; i < s->nb_mmsgs; i++) {
+        s->mmsgs[i].msg_hdr.msg_name    = s->is_connected ? NULL : &s->dest_addr;
+        s->mmsgs[i].msg_hdr.msg_namelen = s->is_connected ? 0 : s->dest_addr_len;
+    }
+
+    while (first < s->nb_mmsgs) {
+#ifdef UDP_SEGMENT
+        if (s->gso) {
+            int max = FFMIN(UDP_GSO_MAX_SEGS, UDP_GSO_MAX_SIZE / s->mmsg_slot);
+            int nb  = 0;
+
+            /* all segments but the last one must be full */
+            while (first + nb < s->nb_mmsgs && nb < max &&
+                   s->mmsg_iov[first + nb++].iov_len == s->mmsg_slot);
+
+            if (nb > 1) {
+                ret = udp_send_gso(s, first, nb);
+                if (ret == AVERROR(EINVAL) || ret == AVERROR(EIO)) {
+                    av_log(h, AV_LOG_VERBOSE, "UDP segmentation offload is "
+                           "unavailable (%s), using sendmmsg()\n", av_err2str(ret));
+                    s->gso = 0;
+                    continue;
+                }
+                if (ret == AVERROR(EAGAIN)) {
+                    ret = ff_network_wait_fd(s->udp_fd, 1);
+                    if (ret < 0 && ret != AVERROR(EAGAIN))
+                        break;
+                    continue;
+                }
+                if (ret < 0)
+                    break;
+                udp_count_call(s, 1);
+                s->nb_datagrams += nb;
+                first += nb;
+                continue;
+            }
+        }
+#endif
+        ret = sendmmsg(s->udp_fd, s->mmsgs + first, s->nb_mmsgs - first, 0);
+        if (ret < 0) {
+            ret = ff_neterrno();
+            if (ret == AVERROR(EAGAIN)) {
+                ret = ff_network_wait_fd(s->udp_fd, 1);
+                if (ret < 0 && ret != AVERROR(EAGAIN))
+                    break;
+            } else if (ret != AVERROR(EINTR)) {
+                break;
+            }
+            continue;
+        }
+        udp_count_call(s, ret);
+        s->nb_datagrams += ret;
+        first += ret;
+        ret = 0;
+    }
+    s->nb_mmsgs = 0;
+    return ret < 0 ? ret : 0;
+}
+
+/**
+ * Move the datagram of size len at the start of the FIFO and the complete
+ * ones following it to the send queue, up to a batch.
+ *
+ * @return the number of bytes queued
+ */
+static int udp_queue_from_fifo(UDPContext *s, int len)
+{
+    int total = 0;
+    uint8_t tmp[4];
+
+    for (;;) {
+        av_fifo_read(s->fifo, s->mmsg_iov[s->nb_mmsgs].iov_base, len);
+        s->mmsg_iov[s->nb_mmsgs++].iov_len = len;
+        total += len;
+
+        if (s->nb_mmsgs == s->batch || av_fifo_can_read(s->fifo) < 4)
+            break;
+        av_fifo_peek(s->fifo, tmp, 4, 0);
+        len = AV_RL32(tmp);
+        if (len > s->mmsg_slot)
+            break;
+        av_fifo_drain2(s->fifo, 4);
+    }
+    return total;
+}
+#endif
+
+static void udp_log_stats(URLContext *h)
+{
+    UDPContext *s = h->priv_data;
+
+    if (s->nb_calls)
+        av_log(h, AV_LOG_VERBOSE, "Statistics: %"PRIu64" datagrams in %"PRIu64
+               " messages, %"PRIu64" system calls, %.1f messages per call on "
+               "average, %d at most\n", s->nb_datagrams, s->nb_msgs,
+               s->nb_calls, (double)s->nb_msgs / s->nb_calls, s->max_batch);
+    if (s->kernel_drops || s->overruns || s->truncated)
+        av_log(h, AV_LOG_VERBOSE, "Dropped %"PRIu32" datagrams in the socket "
+               "buffer, %"PRIu64" in the circular buffer, %"PRIu64" truncated\n",
+               s->kernel_drops, s->overruns, s->truncated);
+    if (s->nb_delays)
+        av_log(h, AV_LOG_VERBOSE, "Receive queueing delay: %"PRId64" us on "
+               "average, %"PRId64" us at most\n",
+               s->delay_sum / (int64_t)s->nb_delays, s->delay_max);
+}
+
 #if HAVE_PTHREAD_CANCEL
 static void *circular_buffer_task_rx( void *_URLContext)
 {
@@ -506,6 +896,11 @@ static void *circular_buffer_task_rx( void *_URLContext)
            see "General Information" / "Thread Cancelation Overview"
            in Single Unix. */
         pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &old_cancelstate);
+#if HAVE_RECVMMSG
+        if (s->use_mmsg)
+            len = udp_recv_batch(s);
+        else
+#endif
         len = recvfrom(s->udp_fd, s->tmp+4, sizeof(s->tmp)-4, 0, (struct sockaddr *)&addr, &addr_len);
         pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &old_cancelstate);
         pthread_mutex_lock(&s->mutex);
@@ -516,6 +911,33 @@ static void *circular_buffer_task_rx( void *_URLContext)
             }
             continue;
         }
+#if HAVE_RECVMMSG
+        if (s->use_mmsg) {
+            const uint8_t *data;
+            uint8_t tmp[4];
+
+            while (udp_next_datagram(s, &data, &len)) {
+                if (av_fifo_can_write(s->fifo) < len + 4) {
+                    if (!s->overrun_nonfatal) {
+                        av_log(h, AV_LOG_ERROR, "Circular buffer overrun. "
+                                "To avoid, increase fifo_size URL option. "
+                                "To survive in such case, use overrun_nonfatal option\n");
+                        s->circular_buffer_error = AVERROR(EIO);
+                        goto end;
+                    }
+                    av_log(h, AV_LOG_WARNING, "Circular buffer overrun. "
+                            "Surviving due to overrun_nonfatal option\n");
+                    s->overruns++;
+                    continue;
+                }
+                AV_WL32(tmp, len);
+                av_fifo_write(s->fifo, tmp, 4);
+                av_fifo_write(s->fifo, data, len);
+            }
+            pthread_cond_signal(&s->cond);
+            continue;
+        }
+#endif
         if (ff_ip_check_source_lists(&addr, &s->filters))
             continue;
         AV_WL32(s->tmp, len);
@@ -525,6 +947,7 @@ static void *circular_buffer_task_rx( void *_URLContext)
             if (s->overrun_nonfatal) {
                 av_log(h, AV_LOG_WARNING, "Circular buffer overrun. "
                         "Surviving due to overrun_nonfatal option\n");
+                s->overruns++;
                 continue;
             } else {
                 av_log(h, AV_LOG_ERROR, "Circular buffer overrun. "
@@ -585,6 +1008,11 @@ static void *circular_buffer_task_tx( void *_URLContext)
         av_assert0(len >= 0);
         av_assert0(len <= sizeof(s->tmp));
 
+#if HAVE_SENDMMSG
+        if (s->mmsgs && len <= s->mmsg_slot)
+            len = udp_queue_from_fifo(s, len);
+        else
+#endif
         av_fifo_read(s->fifo, s->tmp, len);
 
         pthread_mutex_unlock(&s->mutex);
@@ -609,6 +1037,20 @@ static void *circular_buffer_task_tx( void *_URLContext)
             target_timestamp = start_timestamp + sent_bits * 1000000 / s->bitrate;
         }
 
+#if HAVE_SENDMMSG
+        if (s->nb_mmsgs) {
+            int ret = udp_send_batch(h);
+            if (ret < 0) {
+                pthread_mutex_lock(&s->mutex);
+                s->circular_buffer_error = ret;
+                pthread_mutex_unlock(&s->mutex);
+                return NULL;
+            }
+            pthread_mutex_lock(&s->mutex);
+            continue;
+        }
+#endif
+
         p = s->tmp;
         while (len) {
             int ret;
@@ -753,6 +1195,20 @@ static int udp_open(URLContext *h, const char *uri, int flags)
             s->timeout = strtol(buf, NULL, 10);
         if (is_output && av_find_info_tag(buf, sizeof(buf), "broadcast", p))
             s->is_broadcast = strtol(buf, NULL, 10);
+        if (av_find_info_tag(buf, sizeof(buf), "batch", p)) {
+            s->batch = strtol(buf, NULL, 10);
+            if (s->batch < 1 || s->batch > 1024) {
+                av_log(h, AV_LOG_ERROR, "batch(%d) should be in range [1,1024]\n", s->batch);
+                ret = AVERROR(EINVAL);
+                goto fail;
+            }
+        }
+        if (is_output && av_find_info_tag(buf, sizeof(buf), "gso", p))
+            s->gso = strtol(buf, NULL, 10);
+        if (!is_output && av_find_info_tag(buf, sizeof(buf), "gro", p))
+            s->gro = strtol(buf, NULL, 10);
+        if (!is_output && av_find_info_tag(buf, sizeof(buf), "timestamps", p))
+            s->timestamps = strtol(buf, NULL, 10);
     }
     /* handling needed to support options picking from both AVOption and URL */
     s->circular_buffer_size *= 188;
@@ -919,6 +1375,41 @@ static int udp_open(URLContext *h, const char *uri, int flags)
 
     s->udp_fd = udp_fd;
 
+    if (!is_output && (s->batch > 1 || s->gro || s->timestamps)) {
+#if HAVE_RECVMMSG
+        if ((ret = udp_setup_rx(h, udp_fd)) < 0)
+            goto fail;
+#else
+        av_log(h, AV_LOG_WARNING, "'batch', 'gro' and 'timestamps' options "
+               "were set but are not supported on this build\n");
+#endif
+    }
+    if (is_output && s->batch > 1) {
+#if HAVE_SENDMMSG && HAVE_PTHREAD_CANCEL
+        /* Datagrams written directly are sent right away, as waiting for
+         * more would delay them. Only the sending thread of the circular
+         * buffer knows which ones are already waiting to be sent. */
+        if (!s->bitrate || !s->circular_buffer_size) {
+            av_log(h, AV_LOG_WARNING, "'batch' only applies to sending with "
+                   "'bitrate' and 'fifo_size' set\n");
+        } else if (s->pkt_size <= 0) {
+            av_log(h, AV_LOG_ERROR, "'batch' requires a positive 'pkt_size'\n");
+            ret = AVERROR(EINVAL);
+            goto fail;
+        } else if ((ret = udp_mmsg_alloc(s, s->pkt_size)) < 0) {
+            goto fail;
+        }
+#else
+        av_log(h, AV_LOG_WARNING, "'batch' option was set but it is not "
+               "supported on this build\n");
+#endif
+    }
+#if !defined(UDP_SEGMENT) || !HAVE_SENDMMSG || !HAVE_PTHREAD_CANCEL
+    if (s->gso)
+        av_log(h, AV_LOG_WARNING, "'gso' option was set but it is not "
+               "supported on this build\n");
+#endif
+
 #if HAVE_PTHREAD_CANCEL
     /*
       Create thread in case of:
@@ -970,6 +1461,9 @@ static int udp_open(URLContext *h, const char *uri, int flags)
  fail:
     if (udp_fd >= 0)
         closesocket(udp_fd);
+#if HAVE_RECVMMSG || HAVE_SENDMMSG
+    udp_mmsg_free(s);
+#endif
     av_fifo_freep2(&s->fifo);
     ff_ip_reset_filters(&s->filters);
     return ret;
@@ -1036,6 +1530,28 @@ static int udp_read(URLContext *h, uint8_t *buf, int size)
     }
 #endif
 
+#if HAVE_RECVMMSG
+    if (s->use_mmsg) {
+        const uint8_t *data;
+        int len;
+
+        while (!udp_next_datagram(s, &data, &len)) {
+            if (!(h->flags & AVIO_FLAG_NONBLOCK)) {
+                ret = ff_network_wait_fd(s->udp_fd, 0);
+                if (ret < 0)
+                    return ret;
+            }
+            ret = udp_recv_batch(s);
+            if (ret < 0)
+                return ret;
+        }
+        /* the rest of the datagram is lost, as with recvfrom() */
+        len = FFMIN(len, size);
+        memcpy(buf, data, len);
+        return len;
+    }
+#endif
+
     if (!(h->flags & AVIO_FLAG_NONBLOCK)) {
         ret = ff_network_wait_fd(s->udp_fd, 0);
         if (ret < 0)
@@ -1139,6 +1655,10 @@ static int udp_close(URLContext *h)
     }
 #endif
     closesocket(s->udp_fd);
+    udp_log_stats(h);
+#if HAVE_RECVMMSG || HAVE_SENDMMSG
+    udp_mmsg_free(s);
+#endif
     av_fifo_freep2(&s->fifo);
     ff_ip_reset_filters(&s->filters);
     return 0;
@@ -26,6 +26,7 @@
 
 #include "avio.h"
 
+#include "libavutil/buffer.h"
 #include "libavutil/dict.h"
 #include "libavutil/log.h"
 
@@ -85,6 +86,17 @@ typedef struct URLProtocol {
     int (*url_get_multi_file_handle)(URLContext *h, int **handles,
                                      int *numhandles);
     int (*url_get_short_seek)(URLContext *h);
+    /**
+     * Get a read-only reference to a memory mapping of the whole resource,
+     * which stays valid for the lifetime of the reference.
+     */
+    int (*url_get_mapping)(URLContext *h, AVBufferRef **buf);
+    /**
+     * Map a range of the resource into memory, followed by padding bytes
+     * that are zeroed, see ffurl_map_range().
+     */
+    int (*url_map_range)(URLContext *h, int64_t pos, int size, int padding,
+                         AVBufferRef **buf);
     int (*url_shutdown)(URLContext *h, int flags);
     const AVClass *priv_data_class;
     int priv_data_size;
@@ -253,6 +265,28 @@ int ffurl_get_multi_file_handle(URLContext *h, int **handles, int *numhandles);
  */
 int ffurl_get_short_seek(URLContext *h);
 
+/**
+ * Get a memory mapping of the whole resource, for reading it without
+ * copies.
+ *
+ * @param buf set to a new read-only reference to the mapping on success
+ * @return >= 0 on success, a negative AVERROR code if the resource is not
+ *         mapped
+ */
+int ffurl_get_mapping(URLContext *h, AVBufferRef **buf);
+
+/**
+ * Map a range of the resource into memory on its own, followed by zeroed
+ * padding, for handing it out without a copy. Only the part of the range
+ * in its last page is copied.
+ *
+ * @param buf set to a new read-only reference to the range on success,
+ *            with size including the padding
+ * @return >= 0 on success, a negative AVERROR code on failure
+ */
+int ffurl_map_range(URLContext *h, int64_t pos, int size, int padding,
+                    AVBufferRef **buf);
+
 /**
  * Signal the URLContext that we are done reading or writing the stream.
  *
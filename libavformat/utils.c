@@ -115,6 +115,25 @@ FF_ENABLE_DEPRECATION_WARNINGS
     return append_packet_chunked(s, pkt, size);
 }
 
+int ff_get_packet_ref(AVIOContext *s, AVPacket *pkt, int size)
+{
+    int64_t pos = avio_tell(s);
+    AVBufferRef *buf;
+    int ret = ffio_read_ref(s, &buf, size);
+
+    if (ret == AVERROR(EAGAIN))
+        return av_get_packet(s, pkt, size);
+    if (ret < 0)
+        return ret;
+
+    av_packet_unref(pkt);
+    pkt->buf  = buf;
+    pkt->data = buf->data;
+    pkt->size = size;
+    pkt->pos  = pos;
+    return size;
+}
+
 int av_append_packet(AVIOContext *s, AVPacket *pkt, int size)
 {
     if (!pkt->size)
@@ -16,8 +16,13 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/avstring.h"
 #include "libavutil/cpu.h"
 #include "libavutil/cpu_internal.h"
+#include "libavutil/macros.h"
 #include "config.h"
 
 int ff_get_cpu_flags_aarch64(void)
@@ -36,3 +41,33 @@ size_t ff_get_cpu_max_align_aarch64(void)
 
     return 8;
 }
+
+void ff_get_cpu_model_aarch64(char *buf, size_t size)
+{
+#if defined(__linux__)
+    /* identify the CPU by the MIDR fields of the first core */
+    static const char *const fields[] = {
+        "CPU implementer", "CPU variant", "CPU part", "CPU revision",
+    };
+    char line[256], model[64] = "";
+    int nb = 0;
+    FILE *f = fopen("/proc/cpuinfo", "r");
+
+    if (!f)
+        return;
+    while (nb < FF_ARRAY_ELEMS(fields) && fgets(line, sizeof(line), f)) {
+        const char *val = strchr(line, ':');
+
+        if (!val || strncmp(line, fields[nb], strlen(fields[nb])))
+            continue;
+        val += strspn(val + 1, " \t") + 1;
+        av_strlcatf(model, sizeof(model), "%s%.*s", nb ? "/" : "",
+                    (int)strcspn(val, " \t\r\n"), val);
+        nb++;
+    }
+    fclose(f);
+
+    if (nb == FF_ARRAY_ELEMS(fields))
+        snprintf(buf, size, "MIDR %s", model);
+#endif
+}
@@ -24,11 +24,14 @@
 #include "aes_ctr.h"
 #include "aes.h"
 #include "aes_internal.h"
+#include "intreadwrite.h"
 #include "macros.h"
 #include "mem.h"
+#include "mem_internal.h"
 #include "random_seed.h"
 
 #define AES_BLOCK_SIZE (16)
+#define AES_CTR_BATCH  (16)
 
 typedef struct AVAESCTR {
     uint8_t counter[AES_BLOCK_SIZE];
@@ -106,26 +109,39 @@ void av_aes_ctr_increment_iv(struct AVAESCTR *a)
 
 void av_aes_ctr_crypt(struct AVAESCTR *a, uint8_t *dst, const uint8_t *src, int count)
 {
-    const uint8_t* src_end = src + count;
-    const uint8_t* cur_end_pos;
-    uint8_t* encrypted_counter_pos;
+    DECLARE_ALIGNED(16, uint8_t, keystream)[AES_CTR_BATCH * AES_BLOCK_SIZE];
 
-    while (src < src_end) {
-        if (a->block_offset == 0) {
-            av_aes_crypt(&a->aes, a->encrypted_counter, a->counter, 1, NULL, 0);
+    /* use up the keystream left over from a previous call */
+    while (a->block_offset && count > 0) {
+        *dst++ = *src++ ^ a->encrypted_counter[a->block_offset++];
+        a->block_offset &= AES_BLOCK_SIZE - 1;
+        count--;
+    }
+
+    /* encrypt the counters of a batch of whole blocks at once, so that
+     * optimized implementations can interleave the blocks */
+    while (count >= AES_BLOCK_SIZE) {
+        int nb_blocks = FFMIN(count / AES_BLOCK_SIZE, AES_CTR_BATCH);
 
+        for (int i = 0; i < nb_blocks; i++) {
+            memcpy(keystream + i * AES_BLOCK_SIZE, a->counter, AES_BLOCK_SIZE);
             av_aes_ctr_increment_be64(a->counter + 8);
         }
+        av_aes_crypt(&a->aes, keystream, keystream, nb_blocks, NULL, 0);
 
-        encrypted_counter_pos = a->encrypted_counter + a->block_offset;
-        cur_end_pos = src + AES_BLOCK_SIZE - a->block_offset;
-        cur_end_pos = FFMIN(cur_end_pos, src_end);
+        for (int i = 0; i < nb_blocks * AES_BLOCK_SIZE; i += 8)
+            AV_WN64(dst + i, AV_RN64(src + i) ^ AV_RN64A(keystream + i));
+        dst   += nb_blocks * AES_BLOCK_SIZE;
+        src   += nb_blocks * AES_BLOCK_SIZE;
+        count -= nb_blocks * AES_BLOCK_SIZE;
+    }
 
-        a->block_offset += cur_end_pos - src;
-        a->block_offset &= (AES_BLOCK_SIZE - 1);
+    if (count > 0) {
+        av_aes_crypt(&a->aes, a->encrypted_counter, a->counter, 1, NULL, 0);
+        av_aes_ctr_increment_be64(a->counter + 8);
 
-        while (src < cur_end_pos) {
-            *dst++ = *src++ ^ *encrypted_counter_pos++;
-        }
+        for (int i = 0; i < count; i++)
+            dst[i] = src[i] ^ a->encrypted_counter[i];
+        a->block_offset = count;
     }
 }
@@ -295,6 +295,15 @@ AVBufferPool *av_buffer_pool_init(size_t size, AVBufferRef* (*alloc)(size_t size
 
 static void buffer_pool_flush(AVBufferPool *pool)
 {
+    for (int i = 0; i < BUFFER_POOL_SLOTS; i++) {
+        BufferPoolEntry *buf = (BufferPoolEntry*)atomic_exchange_explicit(&pool->slots[i].entry, 0,
+                                                                          memory_order_acq_rel);
+        if (buf) {
+            buf->free(buf->opaque, buf->data);
+            av_free(buf);
+        }
+    }
+
     while (pool->pool) {
         BufferPoolEntry *buf = pool->pool;
         pool->pool = buf->next;
@@ -336,15 +345,41 @@ void av_buffer_pool_uninit(AVBufferPool **ppool)
         buffer_pool_free(pool);
 }
 
+/*
+ * Index of the first slot to try, derived from the stack address of the
+ * calling thread: without thread-local storage, this still lets every thread
+ * mostly take back the buffers it released itself, from slots the other
+ * threads rarely touch.
+ */
+static unsigned pool_first_slot(const void *stack)
+{
+    uint32_t h = (uintptr_t)stack >> 16;
+    return (uint64_t)(h * 0x9E3779B1U) * BUFFER_POOL_SLOTS >> 32;
+}
+
 static void pool_release_buffer(void *opaque, uint8_t *data)
 {
     BufferPoolEntry *buf = opaque;
     AVBufferPool *pool = buf->pool;
+    unsigned first = pool_first_slot(&buf);
+    int i;
 
-    ff_mutex_lock(&pool->mutex);
-    buf->next = pool->pool;
-    pool->pool = buf;
-    ff_mutex_unlock(&pool->mutex);
+    for (i = 0; i < BUFFER_POOL_SLOTS; i++) {
+        BufferPoolSlot *slot = &pool->slots[(first + i) % BUFFER_POOL_SLOTS];
+        uintptr_t empty = 0;
+
+        if (!atomic_load_explicit(&slot->entry, memory_order_relaxed) &&
+            atomic_compare_exchange_strong_explicit(&slot->entry, &empty, (uintptr_t)buf,
+                                                    memory_order_release, memory_order_relaxed))
+            break;
+    }
+
+    if (i == BUFFER_POOL_SLOTS) {
+        ff_mutex_lock(&pool->mutex);
+        buf->next = pool->pool;
+        pool->pool = buf;
+        ff_mutex_unlock(&pool->mutex);
+    }
 
     if (atomic_fetch_sub_explicit(&pool->refcount, 1, memory_order_acq_rel) == 1)
         buffer_pool_free(pool);
@@ -381,27 +416,59 @@ static AVBufferRef *pool_alloc_buffer(AVBufferPool *pool)
     return ret;
 }
 
-AVBufferRef *av_buffer_pool_get(AVBufferPool *pool)
+static AVBufferRef *pool_reuse_buffer(AVBufferPool *pool, BufferPoolEntry *buf)
 {
     AVBufferRef *ret;
+
+    memset(&buf->buffer, 0, sizeof(buf->buffer));
+    ret = buffer_create(&buf->buffer, buf->data, pool->size,
+                        pool_release_buffer, buf, 0);
+    if (ret)
+        buf->buffer.flags_internal |= BUFFER_FLAG_NO_FREE;
+    return ret;
+}
+
+AVBufferRef *av_buffer_pool_get(AVBufferPool *pool)
+{
+    AVBufferRef *ret = NULL;
     BufferPoolEntry *buf;
+    unsigned first = pool_first_slot(&ret);
+
+    for (int i = 0; i < BUFFER_POOL_SLOTS; i++) {
+        BufferPoolSlot *slot = &pool->slots[(first + i) % BUFFER_POOL_SLOTS];
+
+        if (!atomic_load_explicit(&slot->entry, memory_order_relaxed))
+            continue;
+        buf = (BufferPoolEntry*)atomic_exchange_explicit(&slot->entry, 0, memory_order_acquire);
+        if (!buf)
+            continue;
+
+        ret = pool_reuse_buffer(pool, buf);
+        if (!ret) {
+            /* put it back where others can find it */
+            ff_mutex_lock(&pool->mutex);
+            buf->next = pool->pool;
+            pool->pool = buf;
+            ff_mutex_unlock(&pool->mutex);
+            return NULL;
+        }
+        goto done;
+    }
 
     ff_mutex_lock(&pool->mutex);
     buf = pool->pool;
     if (buf) {
-        memset(&buf->buffer, 0, sizeof(buf->buffer));
-        ret = buffer_create(&buf->buffer, buf->data, pool->size,
-                            pool_release_buffer, buf, 0);
+        ret = pool_reuse_buffer(pool, buf);
         if (ret) {
             pool->pool = buf->next;
             buf->next = NULL;
-            buf->buffer.flags_internal |= BUFFER_FLAG_NO_FREE;
         }
     } else {
         ret = pool_alloc_buffer(pool);
     }
     ff_mutex_unlock(&pool->mutex);
 
+done:
     if (ret)
         atomic_fetch_add_explicit(&pool->refcount, 1, memory_order_relaxed);
 
@@ -85,7 +85,28 @@ typedef struct BufferPoolEntry {
     AVBuffer buffer;
 } BufferPoolEntry;
 
+/**
+ * Number of slots of a pool holding released buffers without locking.
+ */
+#define BUFFER_POOL_SLOTS 16
+
+/*
+ * A slot holds a BufferPoolEntry pointer or 0. Buffers are only put in empty
+ * slots and taken by exchanging the slot with 0, which is free of the ABA
+ * problem of lock-free linked lists. Every slot has its own cache line, so
+ * that threads using different slots do not contend.
+ */
+typedef struct BufferPoolSlot {
+    atomic_uintptr_t entry;
+    char padding[64 - sizeof(atomic_uintptr_t)];
+} BufferPoolSlot;
+
 struct AVBufferPool {
+    BufferPoolSlot slots[BUFFER_POOL_SLOTS];
+
+    /*
+     * Released buffers which did not fit in the slots.
+     */
     AVMutex mutex;
     BufferPoolEntry *pool;
 
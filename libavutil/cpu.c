@@ -25,15 +25,27 @@
 #include <sched.h>
 #endif
 
+#include <errno.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
 
 #include "attributes.h"
+#include "avassert.h"
+#include "avstring.h"
 #include "cpu.h"
 #include "cpu_internal.h"
+#include "dict.h"
+#include "error.h"
+#include "file_open.h"
+#include "log.h"
+#include "mem.h"
 #include "opt.h"
 #include "common.h"
+#include "thread.h"
+#include "time.h"
 
 #if HAVE_GETPROCESSAFFINITYMASK || HAVE_WINRT
 #include <windows.h>
@@ -280,3 +292,164 @@ size_t av_cpu_max_align(void)
 
     return 8;
 }
+
+#define AUTOTUNE_MAX_CANDIDATES 16
+#define AUTOTUNE_ROUNDS          3
+#define AUTOTUNE_ROUND_US     2000
+
+static atomic_int autotune_enabled = ATOMIC_VAR_INIT(0);
+static AVMutex autotune_lock = AV_MUTEX_INITIALIZER;
+static AVDictionary *autotune_cache;
+static char *autotune_file;
+
+static void get_cpu_id(char *buf, size_t size)
+{
+    char model[128] = "unknown";
+
+#if ARCH_AARCH64
+    ff_get_cpu_model_aarch64(model, sizeof(model));
+#elif ARCH_X86
+    ff_get_cpu_model_x86(model, sizeof(model));
+#endif
+
+    snprintf(buf, size, "%s/%08x", model, av_get_cpu_flags());
+}
+
+/* Cache file lines are "<cpu id>\t<function>\t<implementation>\n". */
+static int autotune_load(const char *filename)
+{
+    char line[512];
+    FILE *f = avpriv_fopen_utf8(filename, "r");
+    int ret = 0, overlong = 0;
+
+    if (!f)
+        return errno == ENOENT ? 0 : AVERROR(errno);
+
+    while (fgets(line, sizeof(line), f)) {
+        size_t len = strcspn(line, "\r\n");
+        char *name;
+
+        /* skip overlong and malformed lines */
+        if (!line[len] || overlong) {
+            overlong = !line[len];
+            continue;
+        }
+        line[len] = 0;
+        name = strrchr(line, '\t');
+        if (!name || name == strchr(line, '\t'))
+            continue;
+        *name++ = 0;
+        if ((ret = av_dict_set(&autotune_cache, line, name, 0)) < 0)
+            break;
+    }
+
+    fclose(f);
+    return ret;
+}
+
+static void autotune_store(const char *id, const char *name)
+{
+    FILE *f = avpriv_fopen_utf8(autotune_file, "a");
+
+    if (!f || fprintf(f, "%s\t%s\n", id, name) < 0)
+        av_log(NULL, AV_LOG_WARNING, "Could not write autotune cache %s\n",
+               autotune_file);
+    if (f)
+        fclose(f);
+}
+
+int av_cpu_set_autotune(int enable, const char *cache_file)
+{
+    int ret = 0;
+
+    ff_mutex_lock(&autotune_lock);
+    av_dict_free(&autotune_cache);
+    av_freep(&autotune_file);
+    if (enable && cache_file) {
+        autotune_file = av_strdup(cache_file);
+        ret = autotune_file ? autotune_load(cache_file) : AVERROR(ENOMEM);
+        if (ret < 0) {
+            av_dict_free(&autotune_cache);
+            av_freep(&autotune_file);
+        }
+    }
+    atomic_store_explicit(&autotune_enabled, enable && ret >= 0,
+                          memory_order_relaxed);
+    ff_mutex_unlock(&autotune_lock);
+
+    return ret;
+}
+
+int avpriv_cpu_autotune_enabled(void)
+{
+    return atomic_load_explicit(&autotune_enabled, memory_order_relaxed);
+}
+
+static int autotune_bench(void *const *funcs, int nb,
+                          void (*bench)(void *opaque, void *func), void *opaque)
+{
+    double best_time[AUTOTUNE_MAX_CANDIDATES];
+    int best = nb - 1;
+
+    /* Interleave the candidates so that they all see similar clock
+     * frequencies, and keep the best round of each. */
+    for (int r = 0; r < AUTOTUNE_ROUNDS; r++) {
+        for (int i = 0; i < nb; i++) {
+            int64_t t0, t;
+            int n = 0;
+
+            bench(opaque, funcs[i]);
+            t0 = av_gettime_relative();
+            do {
+                bench(opaque, funcs[i]);
+                n++;
+            } while ((t = av_gettime_relative() - t0) < AUTOTUNE_ROUND_US);
+
+            if (!r || (double)t / n < best_time[i])
+                best_time[i] = (double)t / n;
+        }
+    }
+
+    /* Only move away from the default for a clear win, not for noise. */
+    for (int i = nb - 2; i >= 0; i--)
+        if (best_time[i] < best_time[best] * 0.97)
+            best = i;
+
+    return best;
+}
+
+int avpriv_cpu_autotune(const char *key, const char *const *names,
+                        void *const *funcs, int nb,
+                        void (*bench)(void *opaque, void *func), void *opaque)
+{
+    const AVDictionaryEntry *e;
+    char cpu[160], id[256];
+    int best = -1;
+
+    av_assert0(nb > 0 && nb <= AUTOTUNE_MAX_CANDIDATES);
+
+    if (nb == 1 || !avpriv_cpu_autotune_enabled())
+        return nb - 1;
+
+    get_cpu_id(cpu, sizeof(cpu));
+    snprintf(id, sizeof(id), "%s\t%s", cpu, key);
+
+    /* Benchmarks run under the lock so that they do not disturb each other. */
+    ff_mutex_lock(&autotune_lock);
+    e = av_dict_get(autotune_cache, id, NULL, AV_DICT_MATCH_CASE);
+    for (int i = 0; e && i < nb; i++)
+        if (!strcmp(names[i], e->value))
+            best = i;
+
+    if (best < 0) {
+        best = autotune_bench(funcs, nb, bench, opaque);
+        av_log(NULL, AV_LOG_VERBOSE, "Autotuned %s: using %s\n",
+               key, names[best]);
+        av_dict_set(&autotune_cache, id, names[best], 0);
+        if (autotune_file)
+            autotune_store(id, names[best]);
+    }
+    ff_mutex_unlock(&autotune_lock);
+
+    return best;
+}
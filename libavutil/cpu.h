@@ -131,4 +131,26 @@ void av_cpu_force_count(int count);
  */
 size_t av_cpu_max_align(void);
 
+/**
+ * Enable or disable autotuning of DSP functions.
+ *
+ * By default, the optimized implementation of a DSP function is selected
+ * based on the CPU flags alone. With autotuning enabled, DSP init functions
+ * which support it benchmark all implementations usable on the running CPU
+ * and pick the fastest one instead. This makes DSP init considerably slower
+ * the first time a function is tuned.
+ *
+ * The results can be cached in a file, which may be shared by several
+ * machines: entries are keyed by CPU model and CPU flags, so each machine
+ * only uses the results measured on its own kind of CPU.
+ *
+ * @param enable     nonzero to enable autotuning, 0 to disable it
+ * @param cache_file path of the file to read cached results from and append
+ *                   new results to, or NULL to not cache them; the file
+ *                   does not need to exist yet
+ * @return 0 on success, a negative AVERROR code if the cache file could not
+ *         be read; autotuning is left disabled in that case
+ */
+int av_cpu_set_autotune(int enable, const char *cache_file);
+
 #endif /* AVUTIL_CPU_H */
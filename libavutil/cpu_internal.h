@@ -59,4 +59,37 @@ size_t ff_get_cpu_max_align_ppc(void);
 size_t ff_get_cpu_max_align_x86(void);
 size_t ff_get_cpu_max_align_loongarch(void);
 
+void ff_get_cpu_model_aarch64(char *buf, size_t size);
+void ff_get_cpu_model_x86(char *buf, size_t size);
+
+/**
+ * @return nonzero if autotuning was enabled with av_cpu_set_autotune()
+ */
+int avpriv_cpu_autotune_enabled(void);
+
+/**
+ * Select the fastest of several implementations of a DSP function.
+ *
+ * Returns the cached result for this function and CPU if there is one,
+ * otherwise benchmarks the implementations by timing repeated calls to
+ * bench and caches the result.
+ *
+ * @param key    name of the function, unique across all libraries,
+ *               e.g. "v210enc.pack_line_8"
+ * @param names  names of the implementations, e.g. the instruction set
+ *               extension they use; they identify the result in the cache
+ * @param funcs  the implementations usable on the running CPU, in the order
+ *               the CPU flags would prefer them, i.e. the last is the
+ *               default choice
+ * @param nb     number of implementations, at most 16
+ * @param bench  callback calling the given implementation once on typical
+ *               input
+ * @param opaque passed to bench
+ * @return index of the implementation to use; nb - 1 if autotuning is
+ *         disabled
+ */
+int avpriv_cpu_autotune(const char *key, const char *const *names,
+                        void *const *funcs, int nb,
+                        void (*bench)(void *opaque, void *func), void *opaque);
+
 #endif /* AVUTIL_CPU_INTERNAL_H */
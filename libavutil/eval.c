@@ -174,8 +174,36 @@ struct AVExpr {
     } a;
     struct AVExpr *param[3];
     double *var;
+
+    /* set in the root node only, for av_expr_eval_array() */
+    struct ExprInsn *insns; ///< bytecode, NULL if the expression has side effects
+    int nb_insns;
+    double *regs;           ///< EVAL_BLOCK values for each register
+    int nb_consts;          ///< number of constants used by the expression
+    double *const_tmp;      ///< nb_consts values, for the evaluation without bytecode
 };
 
+/* number of elements av_expr_eval_array() processes with each instruction */
+#define EVAL_BLOCK 64
+
+/**
+ * Instruction of the bytecode compiled from an expression: it computes the
+ * node of the given type for EVAL_BLOCK elements at once, from and to
+ * registers holding EVAL_BLOCK values each.
+ */
+typedef struct ExprInsn {
+    int type;
+    int dst;
+    int src[3];             ///< -1 for absent optional arguments
+    double value;
+    int const_index;
+    union {
+        double (*func0)(double);
+        double (*func1)(void *, double);
+        double (*func2)(void *, double, double);
+    } a;
+} ExprInsn;
+
 static double etime(double v)
 {
     return av_gettime() * 0.000001;
@@ -340,6 +368,9 @@ void av_expr_free(AVExpr *e)
     av_expr_free(e->param[1]);
     av_expr_free(e->param[2]);
     av_freep(&e->var);
+    av_freep(&e->insns);
+    av_freep(&e->regs);
+    av_freep(&e->const_tmp);
     av_freep(&e);
 }
 
@@ -682,11 +713,125 @@ static int verify_expr(AVExpr *e)
     }
 }
 
-int av_expr_parse(AVExpr **expr, const char *s,
-                  const char * const *const_names,
-                  const char * const *func1_names, double (* const *funcs1)(void *, double),
-                  const char * const *func2_names, double (* const *funcs2)(void *, double, double),
-                  int log_offset, void *log_ctx)
+/* whether the expression can be evaluated in any order and any number of
+ * times for every element, i.e. it neither uses nor changes the variables */
+static int expr_is_pure(const AVExpr *e)
+{
+    if (!e)
+        return 1;
+    switch (e->type) {
+    case e_ld:
+    case e_st:
+    case e_random:
+    case e_print:
+    case e_while:
+    case e_taylor:
+    case e_root:
+        return 0;
+    }
+    return expr_is_pure(e->param[0]) && expr_is_pure(e->param[1]) &&
+           expr_is_pure(e->param[2]);
+}
+
+/* Replace the subexpressions which do not depend on the constants or
+ * functions passed by the caller by their value. */
+static void fold_expr(AVExpr *e)
+{
+    Parser p = { 0 };
+    int i;
+
+    for (i = 0; i < 3; i++)
+        if (e->param[i])
+            fold_expr(e->param[i]);
+
+    if (e->type == e_value || e->type == e_const ||
+        e->type == e_func1 || e->type == e_func2 ||
+        (e->type == e_func0 && e->a.func0 == etime) || !expr_is_pure(e))
+        return;
+    for (i = 0; i < 3; i++)
+        if (e->param[i] && e->param[i]->type != e_value)
+            return;
+
+    e->value = eval_expr(&p, e);
+    e->type  = e_value;
+    for (i = 0; i < 3; i++) {
+        av_expr_free(e->param[i]);
+        e->param[i] = NULL;
+    }
+}
+
+static int expr_nb_nodes(const AVExpr *e)
+{
+    return e ? 1 + expr_nb_nodes(e->param[0]) + expr_nb_nodes(e->param[1]) +
+                   expr_nb_nodes(e->param[2]) : 0;
+}
+
+static int expr_nb_consts(const AVExpr *e)
+{
+    int nb = e && e->type == e_const ? e->const_index + 1 : 0;
+
+    for (int i = 0; e && i < 3; i++)
+        nb = FFMAX(nb, expr_nb_consts(e->param[i]));
+    return nb;
+}
+
+/* Append the instructions computing e into register reg to root->insns,
+ * using the registers from reg on as temporaries. */
+static void compile_expr(AVExpr *root, const AVExpr *e, int reg, int *nb_regs)
+{
+    ExprInsn *insn;
+    int i;
+
+    /* the first operand of ';' is only evaluated for its side effects */
+    if (e->type == e_last) {
+        compile_expr(root, e->param[1], reg, nb_regs);
+    } else {
+        for (i = 0; i < 3; i++)
+            if (e->param[i])
+                compile_expr(root, e->param[i], reg + i, nb_regs);
+    }
+
+    insn = &root->insns[root->nb_insns++];
+    insn->type        = e->type;
+    insn->dst         = reg;
+    insn->value       = e->value;
+    insn->const_index = e->const_index;
+    memcpy(&insn->a, &e->a, sizeof(insn->a));
+    for (i = 0; i < 3; i++)
+        insn->src[i] = e->type == e_last ? (i ? -1 : reg) :
+                       e->param[i] ? reg + i : -1;
+    *nb_regs = FFMAX(*nb_regs, reg + 1);
+}
+
+static int compile_root(AVExpr *e)
+{
+    int nb_regs = 0;
+
+    e->nb_consts = expr_nb_consts(e);
+    if (e->nb_consts &&
+        !(e->const_tmp = av_malloc_array(e->nb_consts, sizeof(*e->const_tmp))))
+        return AVERROR(ENOMEM);
+
+    if (!expr_is_pure(e))
+        return 0;
+
+    e->insns = av_calloc(expr_nb_nodes(e), sizeof(*e->insns));
+    if (!e->insns)
+        return AVERROR(ENOMEM);
+    compile_expr(e, e, 0, &nb_regs);
+    e->regs = av_malloc_array(nb_regs, EVAL_BLOCK * sizeof(*e->regs));
+    if (!e->regs)
+        return AVERROR(ENOMEM);
+    return 0;
+}
+
+/* The expressions evaluated only once are neither folded nor compiled,
+ * which would cost more than the evaluation itself. */
+static int expr_parse(AVExpr **expr, const char *s,
+                      const char * const *const_names,
+                      const char * const *func1_names, double (* const *funcs1)(void *, double),
+                      const char * const *func2_names, double (* const *funcs2)(void *, double, double),
+                      int log_offset, void *log_ctx, int compile)
 {
     Parser p = { 0 };
     AVExpr *e = NULL;
@@ -724,11 +869,15 @@ int av_expr_parse(AVExpr **expr, const char *s,
         ret = AVERROR(EINVAL);
         goto end;
     }
+    if (compile)
+        fold_expr(e);
     e->var= av_mallocz(sizeof(double) *VARS);
     if (!e->var) {
         ret = AVERROR(ENOMEM);
         goto end;
     }
+    if (compile && (ret = compile_root(e)) < 0)
+        goto end;
     *expr = e;
     e = NULL;
 end:
@@ -737,6 +886,16 @@ end:
     return ret;
 }
 
+int av_expr_parse(AVExpr **expr, const char *s,
+                  const char * const *const_names,
+                  const char * const *func1_names, double (* const *funcs1)(void *, double),
+                  const char * const *func2_names, double (* const *funcs2)(void *, double, double),
+                  int log_offset, void *log_ctx)
+{
+    return expr_parse(expr, s, const_names, func1_names, funcs1, func2_names, funcs2,
+                      log_offset, log_ctx, 1);
+}
+
 static int expr_count(AVExpr *e, unsigned *counter, int size, int type)
 {
     int i;
@@ -773,6 +932,111 @@ double av_expr_eval(AVExpr *e, const double *const_values, void *opaque)
     return eval_expr(&p, e);
 }
 
+static void eval_block(AVExpr *e, int n, int offset, const double *const_values,
+                       const double * const *const_arrays, void *opaque)
+{
+#define REG(r) (e->regs + (r) * EVAL_BLOCK)
+    for (int k = 0; k < e->nb_insns; k++) {
+        const ExprInsn *insn = &e->insns[k];
+        double *d = REG(insn->dst);
+        const double *a = insn->src[0] >= 0 ? REG(insn->src[0]) : NULL;
+        const double *b = insn->src[1] >= 0 ? REG(insn->src[1]) : NULL;
+        const double *c = insn->src[2] >= 0 ? REG(insn->src[2]) : NULL;
+        double v = insn->value;
+        int i;
+
+        switch (insn->type) {
+        case e_value:
+            for (i = 0; i < n; i++) d[i] = v;
+            continue;
+        case e_const:
+            if (const_arrays && const_arrays[insn->const_index]) {
+                const double *src = const_arrays[insn->const_index] + offset;
+                for (i = 0; i < n; i++) d[i] = v * src[i];
+            } else {
+                double val = v * const_values[insn->const_index];
+                for (i = 0; i < n; i++) d[i] = val;
+            }
+            continue;
+        case e_squish: for (i = 0; i < n; i++) d[i] = 1/(1+exp(4*a[i]));                    continue;
+        case e_gauss:  for (i = 0; i < n; i++) d[i] = exp(-a[i]*a[i]/2)/sqrt(2*M_PI);       continue;
+        case e_lerp:   for (i = 0; i < n; i++) d[i] = a[i] + (b[i] - a[i]) * c[i];           continue;
+        case e_func0:  for (i = 0; i < n; i++) d[i] = insn->a.func0(a[i]);                  break;
+        case e_func1:  for (i = 0; i < n; i++) d[i] = insn->a.func1(opaque, a[i]);          break;
+        case e_func2:  for (i = 0; i < n; i++) d[i] = insn->a.func2(opaque, a[i], b[i]);    break;
+        case e_isnan:  for (i = 0; i < n; i++) d[i] = !!isnan(a[i]);                        break;
+        case e_isinf:  for (i = 0; i < n; i++) d[i] = !!isinf(a[i]);                        break;
+        case e_floor:  for (i = 0; i < n; i++) d[i] = floor(a[i]);                          break;
+        case e_ceil:   for (i = 0; i < n; i++) d[i] = ceil (a[i]);                          break;
+        case e_trunc:  for (i = 0; i < n; i++) d[i] = trunc(a[i]);                          break;
+        case e_round:  for (i = 0; i < n; i++) d[i] = round(a[i]);                          break;
+        case e_sgn:    for (i = 0; i < n; i++) d[i] = FFDIFFSIGN(a[i], 0);                  break;
+        case e_sqrt:   for (i = 0; i < n; i++) d[i] = sqrt (a[i]);                          break;
+        case e_not:    for (i = 0; i < n; i++) d[i] = a[i] == 0;                            break;
+        case e_if:     for (i = 0; i < n; i++) d[i] =  a[i] ? b[i] : c ? c[i] : 0;          break;
+        case e_ifnot:  for (i = 0; i < n; i++) d[i] = !a[i] ? b[i] : c ? c[i] : 0;          break;
+        case e_clip:
+            for (i = 0; i < n; i++)
+                d[i] = isnan(b[i]) || isnan(c[i]) || isnan(a[i]) || b[i] > c[i] ? NAN :
+                       av_clipd(a[i], b[i], c[i]);
+            break;
+        case e_between:for (i = 0; i < n; i++) d[i] = a[i] >= b[i] && a[i] <= c[i];         break;
+        case e_mod:    for (i = 0; i < n; i++) d[i] = a[i] - floor(b[i] ? a[i] / b[i] : a[i] * INFINITY) * b[i]; break;
+        case e_gcd:    for (i = 0; i < n; i++) d[i] = av_gcd(a[i], b[i]);                   break;
+        case e_max:    for (i = 0; i < n; i++) d[i] = a[i] >  b[i] ? a[i] : b[i];           break;
+        case e_min:    for (i = 0; i < n; i++) d[i] = a[i] <  b[i] ? a[i] : b[i];           break;
+        case e_eq:     for (i = 0; i < n; i++) d[i] = a[i] == b[i] ? 1.0 : 0.0;             break;
+        case e_gt:     for (i = 0; i < n; i++) d[i] = a[i] >  b[i] ? 1.0 : 0.0;             break;
+        case e_gte:    for (i = 0; i < n; i++) d[i] = a[i] >= b[i] ? 1.0 : 0.0;             break;
+        case e_lt:     for (i = 0; i < n; i++) d[i] = a[i] <  b[i] ? 1.0 : 0.0;             break;
+        case e_lte:    for (i = 0; i < n; i++) d[i] = a[i] <= b[i] ? 1.0 : 0.0;             break;
+        case e_pow:    for (i = 0; i < n; i++) d[i] = pow(a[i], b[i]);                      break;
+        case e_mul:    for (i = 0; i < n; i++) d[i] = a[i] * b[i];                          break;
+        case e_div:    for (i = 0; i < n; i++) d[i] = b[i] ? a[i] / b[i] : a[i] * INFINITY; break;
+        case e_add:    for (i = 0; i < n; i++) d[i] = a[i] + b[i];                          break;
+        case e_last:   /* the operand is already in the destination */                     break;
+        case e_hypot:  for (i = 0; i < n; i++) d[i] = hypot(a[i], b[i]);                    break;
+        case e_atan2:  for (i = 0; i < n; i++) d[i] = atan2(a[i], b[i]);                    break;
+        case e_bitand:
+            for (i = 0; i < n; i++)
+                d[i] = isnan(a[i]) || isnan(b[i]) ? NAN : (long int)a[i] & (long int)b[i];
+            break;
+        case e_bitor:
+            for (i = 0; i < n; i++)
+                d[i] = isnan(a[i]) || isnan(b[i]) ? NAN : (long int)a[i] | (long int)b[i];
+            break;
+        }
+        if (v != 1)
+            for (i = 0; i < n; i++) d[i] *= v;
+    }
+#undef REG
+}
+
+void av_expr_eval_array(AVExpr *e, double *res, int nb,
+                        const double *const_values,
+                        const double * const *const_arrays, void *opaque)
+{
+    if (!e->insns) {
+        double *values = e->const_tmp;
+
+        for (int i = 0; i < nb; i++) {
+            for (int j = 0; j < e->nb_consts; j++)
+                values[j] = const_arrays && const_arrays[j] ? const_arrays[j][i] :
+                                                              const_values[j];
+            res[i] = av_expr_eval(e, values, opaque);
+        }
+        return;
+    }
+
+    for (int offset = 0; offset < nb; offset += EVAL_BLOCK) {
+        int n = FFMIN(nb - offset, EVAL_BLOCK);
+
+        eval_block(e, n, offset, const_values, const_arrays, opaque);
+        /* the root is computed into the first register */
+        memcpy(res + offset, e->regs, n * sizeof(*res));
+    }
+}
+
 int av_expr_parse_and_eval(double *d, const char *s,
                            const char * const *const_names, const double *const_values,
                            const char * const *func1_names, double (* const *funcs1)(void *, double),
@@ -780,7 +1044,8 @@ int av_expr_parse_and_eval(double *d, const char *s,
                            void *opaque, int log_offset, void *log_ctx)
 {
     AVExpr *e = NULL;
-    int ret = av_expr_parse(&e, s, const_names, func1_names, funcs1, func2_names, funcs2, log_offset, log_ctx);
+    int ret = expr_parse(&e, s, const_names, func1_names, funcs1, func2_names, funcs2,
+                         log_offset, log_ctx, 0);
 
     if (ret < 0) {
         *d = NAN;
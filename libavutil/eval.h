@@ -87,6 +87,34 @@ int av_expr_parse(AVExpr **expr, const char *s,
  */
 double av_expr_eval(AVExpr *e, const double *const_values, void *opaque);
 
+/**
+ * Evaluate a previously parsed expression for an array of elements.
+ *
+ * This is equivalent to calling av_expr_eval() for each element with the
+ * values of the constants of that element, but much faster: unless the
+ * expression uses variables (st(), ld(), random(), while()...) or print(),
+ * it runs a compiled form of the expression on blocks of elements at once.
+ * The functions from funcs1 and funcs2 may then also be called for the
+ * branches of if() and ifnot() which are not taken, so they must not have
+ * side effects.
+ *
+ * Unlike av_expr_eval(), this must not be called for the same AVExpr from
+ * several threads simultaneously.
+ *
+ * @param e the AVExpr to evaluate
+ * @param res array where the nb results are written
+ * @param nb number of elements
+ * @param const_values values of the constants which are the same for all the
+ *                     elements, like for av_expr_eval()
+ * @param const_arrays NULL, or an array with an entry for each constant: a
+ *                     non-NULL entry points to the nb values of the constant
+ *                     for the elements, overriding const_values
+ * @param opaque a pointer which will be passed to all functions from funcs1 and funcs2
+ */
+void av_expr_eval_array(AVExpr *e, double *res, int nb,
+                        const double *const_values,
+                        const double * const *const_arrays, void *opaque);
+
 /**
  * Track the presence of variables and their number of occurrences in a parsed expression
  *
@@ -0,0 +1,353 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdatomic.h>
+#include "avassert.h"
+#include "cpu.h"
+#include "executor.h"
+#include "internal.h"
+#include "mem.h"
+#include "thread.h"
+
+#define MAX_AUTO_THREADS 64
+#define INITIAL_QUEUE_SIZE 64
+
+#if HAVE_PTHREADS || HAVE_W32THREADS || HAVE_OS2THREADS
+
+/* jobs submitted together by one av_executor_execute() call */
+typedef struct ExecutorBatch {
+    void            (*func)(void *arg, int jobnr);
+    void            *arg;
+    atomic_int      remaining;
+} ExecutorBatch;
+
+typedef struct ExecutorJob {
+    ExecutorBatch   *batch;
+    int             jobnr;
+} ExecutorJob;
+
+/* The owner of a queue pushes and pops its jobs at the tail, so that it runs
+ * the most recent ones first while their data is still in its caches, the
+ * other threads steal the oldest ones at the head. */
+typedef struct JobQueue {
+    pthread_mutex_t mutex;
+    ExecutorJob     *jobs;
+    unsigned        size;
+    unsigned        head;
+    unsigned        tail;
+} JobQueue;
+
+typedef struct ExecutorWorker {
+    AVExecutor      *e;
+    JobQueue        queue;
+    pthread_t       thread;
+    int             index;
+} ExecutorWorker;
+
+struct AVExecutor {
+    ExecutorWorker  *workers;
+    int             nb_workers;
+
+    /* upper bound on the number of jobs in all the queues */
+    atomic_int      nb_queued;
+    atomic_uint     next_queue;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t  cond;
+    int             finished;
+};
+
+static int queue_push(JobQueue *q, const ExecutorJob *job)
+{
+    pthread_mutex_lock(&q->mutex);
+    if (q->tail - q->head == q->size) {
+        unsigned size = q->size ? 2 * q->size : INITIAL_QUEUE_SIZE;
+        ExecutorJob *jobs = av_malloc_array(size, sizeof(*jobs));
+        unsigned i;
+
+        if (!jobs) {
+            pthread_mutex_unlock(&q->mutex);
+            return AVERROR(ENOMEM);
+        }
+        for (i = 0; i < q->size; i++)
+            jobs[i] = q->jobs[(q->head + i) & (q->size - 1)];
+        av_free(q->jobs);
+        q->jobs = jobs;
+        q->tail = q->size;
+        q->head = 0;
+        q->size = size;
+    }
+    q->jobs[q->tail++ & (q->size - 1)] = *job;
+    pthread_mutex_unlock(&q->mutex);
+    return 0;
+}
+
+static int queue_pop(JobQueue *q, ExecutorJob *job, int steal)
+{
+    int ret = 0;
+
+    pthread_mutex_lock(&q->mutex);
+    if (q->tail != q->head) {
+        *job = steal ? q->jobs[q->head++ & (q->size - 1)]
+                     : q->jobs[--q->tail & (q->size - 1)];
+        ret = 1;
+    }
+    pthread_mutex_unlock(&q->mutex);
+    return ret;
+}
+
+/* index of the worker running in the calling thread, or -1 */
+static int current_worker(const AVExecutor *e)
+{
+#if HAVE_PTHREADS
+    pthread_t self = pthread_self();
+    int i;
+
+    for (i = 0; i < e->nb_workers; i++)
+        if (pthread_equal(e->workers[i].thread, self))
+            return i;
+#endif
+    return -1;
+}
+
+static int get_job(AVExecutor *e, int self, ExecutorJob *job)
+{
+    unsigned start;
+    int i;
+
+    if (atomic_load_explicit(&e->nb_queued, memory_order_acquire) <= 0)
+        return 0;
+
+    if (self >= 0 && queue_pop(&e->workers[self].queue, job, 0))
+        goto found;
+
+    start = self >= 0 ? self + 1 : atomic_load_explicit(&e->next_queue, memory_order_relaxed);
+    for (i = 0; i < e->nb_workers; i++) {
+        int victim = (start + i) % e->nb_workers;
+        if (victim != self && queue_pop(&e->workers[victim].queue, job, 1))
+            goto found;
+    }
+    return 0;
+
+found:
+    atomic_fetch_sub_explicit(&e->nb_queued, 1, memory_order_acq_rel);
+    return 1;
+}
+
+static void run_job(AVExecutor *e, const ExecutorJob *job)
+{
+    ExecutorBatch *batch = job->batch;
+
+    batch->func(batch->arg, job->jobnr);
+
+    /* the batch may be gone as soon as the counter reaches 0 */
+    if (atomic_fetch_sub_explicit(&batch->remaining, 1, memory_order_acq_rel) == 1) {
+        pthread_mutex_lock(&e->mutex);
+        pthread_cond_broadcast(&e->cond);
+        pthread_mutex_unlock(&e->mutex);
+    }
+}
+
+static void *attribute_align_arg executor_worker(void *v)
+{
+    ExecutorWorker *w = v;
+    AVExecutor *e = w->e;
+    ExecutorJob job;
+
+    while (1) {
+        if (get_job(e, w->index, &job)) {
+            run_job(e, &job);
+            continue;
+        }
+
+        pthread_mutex_lock(&e->mutex);
+        while (!e->finished && atomic_load(&e->nb_queued) <= 0)
+            pthread_cond_wait(&e->cond, &e->mutex);
+        if (e->finished) {
+            pthread_mutex_unlock(&e->mutex);
+            return NULL;
+        }
+        pthread_mutex_unlock(&e->mutex);
+    }
+}
+
+AVExecutor *av_executor_alloc(int nb_threads)
+{
+    AVExecutor *e;
+    int i;
+
+    av_assert0(nb_threads >= 0);
+    if (!nb_threads)
+        nb_threads = FFMIN(av_cpu_count(), MAX_AUTO_THREADS);
+
+    e = av_mallocz(sizeof(*e));
+    if (!e)
+        return NULL;
+
+    e->workers = av_calloc(nb_threads, sizeof(*e->workers));
+    if (!e->workers) {
+        av_free(e);
+        return NULL;
+    }
+
+    atomic_init(&e->nb_queued, 0);
+    atomic_init(&e->next_queue, 0);
+    pthread_mutex_init(&e->mutex, NULL);
+    pthread_cond_init(&e->cond, NULL);
+
+    for (i = 0; i < nb_threads; i++) {
+        ExecutorWorker *w = &e->workers[i];
+        w->e     = e;
+        w->index = i;
+        pthread_mutex_init(&w->queue.mutex, NULL);
+    }
+
+    /* all the workers must exist before any of them starts stealing */
+    pthread_mutex_lock(&e->mutex);
+    for (i = 0; i < nb_threads; i++) {
+        if (pthread_create(&e->workers[i].thread, NULL, executor_worker, &e->workers[i])) {
+            pthread_mutex_destroy(&e->workers[i].queue.mutex);
+            break;
+        }
+        e->nb_workers++;
+    }
+    pthread_mutex_unlock(&e->mutex);
+
+    if (e->nb_workers < nb_threads) {
+        for (i = e->nb_workers + 1; i < nb_threads; i++)
+            pthread_mutex_destroy(&e->workers[i].queue.mutex);
+        av_executor_free(&e);
+    }
+
+    return e;
+}
+
+void av_executor_free(AVExecutor **pe)
+{
+    AVExecutor *e;
+    int i;
+
+    if (!pe || !*pe)
+        return;
+    e = *pe;
+
+    pthread_mutex_lock(&e->mutex);
+    e->finished = 1;
+    pthread_cond_broadcast(&e->cond);
+    pthread_mutex_unlock(&e->mutex);
+
+    for (i = 0; i < e->nb_workers; i++) {
+        ExecutorWorker *w = &e->workers[i];
+        pthread_join(w->thread, NULL);
+        pthread_mutex_destroy(&w->queue.mutex);
+        av_freep(&w->queue.jobs);
+    }
+
+    pthread_cond_destroy(&e->cond);
+    pthread_mutex_destroy(&e->mutex);
+    av_freep(&e->workers);
+    av_freep(pe);
+}
+
+int av_executor_nb_threads(const AVExecutor *e)
+{
+    return e->nb_workers;
+}
+
+void av_executor_execute(AVExecutor *e, void (*func)(void *arg, int jobnr),
+                         void (*main)(void *arg), void *arg, int nb_jobs)
+{
+    ExecutorBatch batch = { .func = func, .arg = arg };
+    int self = current_worker(e);
+    /* without a main function, the calling thread starts with the first job */
+    int first = !main;
+    ExecutorJob job;
+    unsigned queue;
+    int i;
+
+    av_assert0(nb_jobs > 0);
+    atomic_init(&batch.remaining, nb_jobs);
+
+    /* a worker keeps the jobs in its own queue, where the other workers
+     * steal them when they run out of work; other threads spread them */
+    queue = self >= 0 ? self : atomic_fetch_add_explicit(&e->next_queue, 1, memory_order_relaxed);
+    for (i = first; i < nb_jobs; i++) {
+        JobQueue *q = &e->workers[self >= 0 ? self : (queue + i) % e->nb_workers].queue;
+
+        job.batch = &batch;
+        job.jobnr = i;
+        /* counted before being pushed, so that it never goes negative */
+        atomic_fetch_add_explicit(&e->nb_queued, 1, memory_order_acq_rel);
+        if (queue_push(q, &job) < 0) {
+            atomic_fetch_sub_explicit(&e->nb_queued, 1, memory_order_acq_rel);
+            run_job(e, &job);
+        }
+    }
+
+    if (nb_jobs > first) {
+        pthread_mutex_lock(&e->mutex);
+        pthread_cond_broadcast(&e->cond);
+        pthread_mutex_unlock(&e->mutex);
+    }
+
+    if (main) {
+        main(arg);
+    } else {
+        job.batch = &batch;
+        job.jobnr = 0;
+        run_job(e, &job);
+    }
+
+    while (atomic_load_explicit(&batch.remaining, memory_order_acquire)) {
+        if (get_job(e, self, &job)) {
+            run_job(e, &job);
+            continue;
+        }
+
+        pthread_mutex_lock(&e->mutex);
+        while (atomic_load(&batch.remaining) && atomic_load(&e->nb_queued) <= 0)
+            pthread_cond_wait(&e->cond, &e->mutex);
+        pthread_mutex_unlock(&e->mutex);
+    }
+}
+
+#else /* HAVE_PTHREADS || HAVE_W32THREADS || HAVE_OS2THREADS */
+
+AVExecutor *av_executor_alloc(int nb_threads)
+{
+    return NULL;
+}
+
+void av_executor_free(AVExecutor **pe)
+{
+    av_assert0(!pe || !*pe);
+}
+
+int av_executor_nb_threads(const AVExecutor *e)
+{
+    av_assert0(0);
+    return 0;
+}
+
+void av_executor_execute(AVExecutor *e, void (*func)(void *arg, int jobnr),
+                         void (*main)(void *arg), void *arg, int nb_jobs)
+{
+    av_assert0(0);
+}
+
+#endif /* HAVE_PTHREADS || HAVE_W32THREADS || HAVE_OS2THREADS */
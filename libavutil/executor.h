@@ -0,0 +1,76 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVUTIL_EXECUTOR_H
+#define AVUTIL_EXECUTOR_H
+
+/**
+ * @file
+ * Work-stealing thread pool, which can be shared by codecs, filters and
+ * scalers instead of each of them starting its own threads.
+ *
+ * Every worker thread has its own queue of jobs; jobs submitted from a
+ * worker go to its queue and idle workers steal jobs from the others.
+ * A thread waiting for its jobs to finish runs queued jobs in the meantime,
+ * so jobs may themselves submit and wait for other jobs.
+ */
+
+typedef struct AVExecutor AVExecutor;
+
+/**
+ * Allocate an executor and start its worker threads.
+ *
+ * @param nb_threads number of worker threads, 0 for one per logical CPU
+ * @return the executor or NULL on failure, in particular if lavu was built
+ *         without thread support
+ */
+AVExecutor *av_executor_alloc(int nb_threads);
+
+/**
+ * Stop the worker threads and free the executor.
+ *
+ * The executor must no longer be in use by any thread nor be attached to
+ * any context.
+ */
+void av_executor_free(AVExecutor **e);
+
+/**
+ * @return the number of worker threads of the executor
+ */
+int av_executor_nb_threads(const AVExecutor *e);
+
+/**
+ * Run jobs on the executor and wait for all of them to finish.
+ *
+ * The calling thread takes part in running the jobs, and may run jobs
+ * submitted by other threads while it waits. The jobs are not guaranteed to
+ * run concurrently, so they must not wait for each other; main may wait for
+ * them.
+ *
+ * @param e       the executor
+ * @param func    function called once for each job, with jobnr going from
+ *                0 to nb_jobs - 1, in any order and from any thread
+ * @param main    if not NULL, called from the calling thread concurrently
+ *                with the jobs
+ * @param arg     opaque pointer passed to func and main
+ * @param nb_jobs number of jobs, must be > 0
+ */
+void av_executor_execute(AVExecutor *e, void (*func)(void *arg, int jobnr),
+                         void (*main)(void *arg), void *arg, int nb_jobs);
+
+#endif /* AVUTIL_EXECUTOR_H */
@@ -27,6 +27,7 @@
 #include "mem.h"
 #include "samplefmt.h"
 #include "hwcontext.h"
+#include "thread.h"
 
 #if FF_API_OLD_CHANNEL_LAYOUT
 #define CHECK_CHANNELS_CONSISTENCY(frame) \
@@ -122,6 +123,76 @@ void av_frame_free(AVFrame **frame)
     av_freep(frame);
 }
 
+struct AVFramePool {
+    AVMutex      mutex;
+    AVFrame    **frames;
+    unsigned int nb_frames;
+    unsigned int frames_allocated;
+};
+
+AVFramePool *av_frame_pool_alloc(void)
+{
+    AVFramePool *pool = av_mallocz(sizeof(*pool));
+
+    if (!pool)
+        return NULL;
+
+    if (ff_mutex_init(&pool->mutex, NULL)) {
+        av_free(pool);
+        return NULL;
+    }
+
+    return pool;
+}
+
+void av_frame_pool_free(AVFramePool **ppool)
+{
+    AVFramePool *pool = *ppool;
+
+    if (!pool)
+        return;
+
+    for (unsigned int i = 0; i < pool->nb_frames; i++)
+        av_frame_free(&pool->frames[i]);
+    av_freep(&pool->frames);
+    ff_mutex_destroy(&pool->mutex);
+    av_freep(ppool);
+}
+
+AVFrame *av_frame_pool_get(AVFramePool *pool)
+{
+    AVFrame *frame = NULL;
+
+    ff_mutex_lock(&pool->mutex);
+    if (pool->nb_frames)
+        frame = pool->frames[--pool->nb_frames];
+    ff_mutex_unlock(&pool->mutex);
+
+    return frame ? frame : av_frame_alloc();
+}
+
+void av_frame_pool_release(AVFramePool *pool, AVFrame **frame)
+{
+    void *tmp;
+
+    if (!*frame)
+        return;
+
+    av_frame_unref(*frame);
+
+    ff_mutex_lock(&pool->mutex);
+    tmp = av_fast_realloc(pool->frames, &pool->frames_allocated,
+                          (pool->nb_frames + 1) * sizeof(*pool->frames));
+    if (tmp) {
+        pool->frames = tmp;
+        pool->frames[pool->nb_frames++] = *frame;
+        *frame = NULL;
+    }
+    ff_mutex_unlock(&pool->mutex);
+
+    av_frame_free(frame);
+}
+
 static int get_video_buffer(AVFrame *frame, int align)
 {
     const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(frame->format);
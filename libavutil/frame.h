@@ -745,6 +745,52 @@ AVFrame *av_frame_alloc(void);
  */
 void av_frame_free(AVFrame **frame);
 
+/**
+ * A pool of AVFrame structures, for recycling the frames themselves instead
+ * of allocating and freeing one for every frame processed. The pool keeps
+ * the AVFrame structures only, not their data buffers, see AVBufferPool for
+ * those.
+ *
+ * The functions operating on a pool may be called from several threads
+ * simultaneously.
+ */
+typedef struct AVFramePool AVFramePool;
+
+/**
+ * Allocate an empty pool of frames. It must be freed with
+ * av_frame_pool_free().
+ *
+ * @return the pool or NULL on failure
+ */
+AVFramePool *av_frame_pool_alloc(void);
+
+/**
+ * Free a pool and all the frames in it. The frames taken from the pool and
+ * not released yet are not affected, they must then be freed with
+ * av_frame_free().
+ *
+ * @param pool pointer to the pool to be freed. It will be set to NULL.
+ */
+void av_frame_pool_free(AVFramePool **pool);
+
+/**
+ * Take a frame from the pool, or allocate a new one if the pool is empty.
+ * The frame has its fields set to default values, as if allocated with
+ * av_frame_alloc().
+ *
+ * @return the frame or NULL on failure
+ */
+AVFrame *av_frame_pool_get(AVFramePool *pool);
+
+/**
+ * Unreference a frame and return it to the pool. The frame does not need to
+ * come from this pool, or from any pool: any frame allocated with
+ * av_frame_alloc() may be released to a pool.
+ *
+ * @param frame pointer to the frame to be released. It will be set to NULL.
+ */
+void av_frame_pool_release(AVFramePool *pool, AVFrame **frame);
+
 /**
  * Set up a new reference to the data described by the source frame.
  *
@@ -25,6 +25,7 @@
  */
 
 #define _XOPEN_SOURCE 600
+#define _DEFAULT_SOURCE // needed for madvise()
 
 #include "config.h"
 
@@ -36,6 +37,9 @@
 #if HAVE_MALLOC_H
 #include <malloc.h>
 #endif
+#if HAVE_MADVISE
+#include <sys/mman.h>
+#endif
 
 #include "attributes.h"
 #include "avassert.h"
@@ -75,6 +79,85 @@ void av_max_alloc(size_t max){
     atomic_store_explicit(&max_alloc_size, max, memory_order_relaxed);
 }
 
+#define HUGE_PAGE_SIZE (2 << 20)
+
+static atomic_size_t huge_page_min_size = ATOMIC_VAR_INIT(0);
+
+void av_mem_set_huge_pages(size_t min_size)
+{
+    atomic_store_explicit(&huge_page_min_size, min_size, memory_order_relaxed);
+}
+
+enum AllocatorState {
+    ALLOCATOR_UNUSED,     ///< nothing allocated yet, an allocator may be set
+    ALLOCATOR_DEFAULT,    ///< memory allocated by the default allocator
+    ALLOCATOR_INSTALLING, ///< av_mem_set_allocator() is copying the callbacks
+    ALLOCATOR_CUSTOM,     ///< allocator set with av_mem_set_allocator()
+};
+
+static atomic_int allocator_state = ATOMIC_VAR_INIT(ALLOCATOR_UNUSED);
+static AVMemAllocator allocator;
+
+int av_mem_set_allocator(const AVMemAllocator *a)
+{
+    int state = ALLOCATOR_UNUSED;
+
+    if (!a->alloc || !a->realloc || !a->free)
+        return AVERROR(EINVAL);
+    if (!atomic_compare_exchange_strong_explicit(&allocator_state, &state, ALLOCATOR_INSTALLING,
+                                                 memory_order_acquire, memory_order_relaxed))
+        return AVERROR(EBUSY);
+
+    /* the callbacks must be visible before any thread can use them */
+    allocator = *a;
+    atomic_store_explicit(&allocator_state, ALLOCATOR_CUSTOM, memory_order_release);
+    return 0;
+}
+
+static int get_allocator_state(void)
+{
+    int state;
+
+    /* only a struct copy away from ALLOCATOR_CUSTOM */
+    do {
+        state = atomic_load_explicit(&allocator_state, memory_order_acquire);
+    } while (state == ALLOCATOR_INSTALLING);
+    return state;
+}
+
+/* Return whether the allocations go to a custom allocator; memory allocated
+ * by the default allocator forbids setting one afterwards. */
+static int custom_allocator(void)
+{
+    int state = get_allocator_state();
+
+    while (state == ALLOCATOR_UNUSED &&
+           !atomic_compare_exchange_strong_explicit(&allocator_state, &state, ALLOCATOR_DEFAULT,
+                                                    memory_order_acq_rel, memory_order_acquire))
+        state = get_allocator_state();
+    return state == ALLOCATOR_CUSTOM;
+}
+
+#if HAVE_POSIX_MEMALIGN && HAVE_MADVISE && defined(MADV_HUGEPAGE)
+/* Align large blocks on huge page boundaries and ask the kernel to back them
+ * with transparent huge pages. The blocks stay compatible with free() and
+ * realloc(). */
+static void *huge_page_malloc(size_t size)
+{
+    void *ptr;
+
+    if (posix_memalign(&ptr, HUGE_PAGE_SIZE, size))
+        return NULL;
+
+    /* only advise whole huge pages, the tail is shared with the heap */
+    madvise(ptr, size & ~(size_t)(HUGE_PAGE_SIZE - 1), MADV_HUGEPAGE);
+    return ptr;
+}
+#define USE_HUGE_PAGES 1
+#else
+#define USE_HUGE_PAGES 0
+#endif
+
 static int size_mult(size_t a, size_t b, size_t *r)
 {
     size_t t;
@@ -96,10 +179,27 @@ static int size_mult(size_t a, size_t b, size_t *r)
 void *av_malloc(size_t size)
 {
     void *ptr = NULL;
+#if USE_HUGE_PAGES
+    size_t huge_min = atomic_load_explicit(&huge_page_min_size, memory_order_relaxed);
+#endif
 
     if (size > atomic_load_explicit(&max_alloc_size, memory_order_relaxed))
         return NULL;
 
+    if (custom_allocator()) {
+        ptr = allocator.alloc(allocator.opaque, size + !size, ALIGN);
+#if CONFIG_MEMORY_POISONING
+        if (ptr)
+            memset(ptr, FF_MEMORY_POISON, size);
+#endif
+        return ptr;
+    }
+
+#if USE_HUGE_PAGES
+    if (huge_min && size >= FFMAX(huge_min, HUGE_PAGE_SIZE))
+        ptr = huge_page_malloc(size);
+    else
+#endif
 #if HAVE_POSIX_MEMALIGN
     if (size) //OS X on SDK 10.6 has a broken posix_memalign implementation
     if (posix_memalign(&ptr, ALIGN, size))
@@ -156,6 +256,9 @@ void *av_realloc(void *ptr, size_t size)
     if (size > atomic_load_explicit(&max_alloc_size, memory_order_relaxed))
         return NULL;
 
+    if (custom_allocator())
+        ret = allocator.realloc(allocator.opaque, ptr, size + !size);
+    else
 #if HAVE_ALIGNED_MALLOC
     ret = _aligned_realloc(ptr, size + !size, ALIGN);
 #else
@@ -245,6 +348,12 @@ int av_reallocp_array(void *ptr, size_t nmemb, size_t size)
 
 void av_free(void *ptr)
 {
+    if (get_allocator_state() == ALLOCATOR_CUSTOM) {
+        if (ptr)
+            allocator.free(allocator.opaque, ptr);
+        return;
+    }
+
 #if HAVE_ALIGNED_MALLOC
     _aligned_free(ptr);
 #else
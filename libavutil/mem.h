@@ -689,6 +689,67 @@ int av_size_mult(size_t a, size_t b, size_t *r);
  */
 void av_max_alloc(size_t max);
 
+/**
+ * Back large blocks allocated by the default allocator with huge pages.
+ *
+ * Blocks of at least min_size bytes, and at least one huge page, are aligned
+ * on huge page boundaries and the system is asked to back them with
+ * transparent huge pages, which reduces the TLB misses when processing large
+ * frames. This is only supported on systems with madvise(MADV_HUGEPAGE) and
+ * does nothing elsewhere. It does not apply to blocks allocated by an
+ * allocator set with av_mem_set_allocator().
+ *
+ * May be called at any time, the blocks already allocated are not affected.
+ *
+ * @param min_size minimum size of the blocks to back with huge pages, 0 to
+ *                 disable
+ */
+void av_mem_set_huge_pages(size_t min_size);
+
+/**
+ * Allocator callbacks used by the @ref lavu_mem_funcs "heap management
+ * functions" instead of the system allocator, see av_mem_set_allocator().
+ */
+typedef struct AVMemAllocator {
+    /**
+     * Opaque pointer passed to the callbacks.
+     */
+    void *opaque;
+
+    /**
+     * Allocate a block of size bytes, size being > 0, aligned on at least
+     * align bytes. Return NULL on failure.
+     */
+    void *(*alloc)(void *opaque, size_t size, size_t align);
+
+    /**
+     * Resize a block returned by alloc() or realloc() to size bytes, size
+     * being > 0, like realloc() does, or allocate a block if ptr is NULL.
+     * The block only needs the alignment of malloc(). Return NULL on failure,
+     * leaving the block untouched.
+     */
+    void *(*realloc)(void *opaque, void *ptr, size_t size);
+
+    /**
+     * Free a block returned by alloc() or realloc(), ptr is never NULL.
+     */
+    void (*free)(void *opaque, void *ptr);
+} AVMemAllocator;
+
+/**
+ * Make the heap management functions of the whole process use custom
+ * allocator callbacks, e.g. for an arena or a NUMA-local allocator.
+ *
+ * This must be called at most once, before any memory is allocated by any of
+ * the libraries, and the callbacks must stay usable until the process exits.
+ *
+ * @param allocator the callbacks, which are copied
+ * @return 0 on success, AVERROR(EINVAL) if a callback is missing,
+ *         AVERROR(EBUSY) if an allocator was already set or memory was
+ *         already allocated
+ */
+int av_mem_set_allocator(const AVMemAllocator *allocator);
+
 /**
  * @}
  * @}
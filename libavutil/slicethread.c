@@ -18,6 +18,7 @@
 
 #include <stdatomic.h>
 #include "cpu.h"
+#include "executor.h"
 #include "internal.h"
 #include "slicethread.h"
 #include "mem.h"
@@ -52,6 +53,8 @@ struct AVSliceThread {
     void            *priv;
     void            (*worker_func)(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads);
     void            (*main_func)(void *priv);
+
+    AVExecutor      *executor;
 };
 
 static int run_jobs(AVSliceThread *ctx)
@@ -95,6 +98,48 @@ static void *attribute_align_arg thread_worker(void *v)
     }
 }
 
+static void executor_run_jobs(void *priv, int jobnr)
+{
+    run_jobs(priv);
+}
+
+static void executor_main(void *priv)
+{
+    AVSliceThread *ctx = priv;
+    ctx->main_func(ctx->priv);
+}
+
+int avpriv_slicethread_create_executor(AVSliceThread **pctx, void *priv,
+                                       void (*worker_func)(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads),
+                                       void (*main_func)(void *priv),
+                                       int nb_threads, AVExecutor *executor)
+{
+    AVSliceThread *ctx;
+
+    if (!executor)
+        return avpriv_slicethread_create(pctx, priv, worker_func, main_func, nb_threads);
+
+    av_assert0(nb_threads >= 0);
+    /* the calling thread takes part in running the jobs */
+    if (!nb_threads)
+        nb_threads = av_executor_nb_threads(executor) + 1;
+
+    *pctx = ctx = av_mallocz(sizeof(*ctx));
+    if (!ctx)
+        return AVERROR(ENOMEM);
+
+    ctx->priv        = priv;
+    ctx->worker_func = worker_func;
+    ctx->main_func   = main_func;
+    ctx->nb_threads  = nb_threads;
+    ctx->executor    = executor;
+
+    atomic_init(&ctx->first_job, 0);
+    atomic_init(&ctx->current_job, 0);
+
+    return nb_threads;
+}
+
 int avpriv_slicethread_create(AVSliceThread **pctx, void *priv,
                               void (*worker_func)(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads),
                               void (*main_func)(void *priv),
@@ -174,6 +219,16 @@ void avpriv_slicethread_execute(AVSliceThread *ctx, int nb_jobs, int execute_mai
     ctx->nb_active_threads = FFMIN(nb_jobs, ctx->nb_threads);
     atomic_store_explicit(&ctx->first_job, 0, memory_order_relaxed);
     atomic_store_explicit(&ctx->current_job, ctx->nb_active_threads, memory_order_relaxed);
+
+    /* one executor job per active thread, each running run_jobs() as the
+     * dedicated threads do */
+    if (ctx->executor) {
+        av_executor_execute(ctx->executor, executor_run_jobs,
+                            ctx->main_func && execute_main ? executor_main : NULL,
+                            ctx, ctx->nb_active_threads);
+        return;
+    }
+
     nb_workers             = ctx->nb_active_threads;
     if (!ctx->main_func || !execute_main)
         nb_workers--;
@@ -209,6 +264,11 @@ void avpriv_slicethread_free(AVSliceThread **pctx)
         return;
 
     ctx = *pctx;
+    if (ctx->executor) {
+        av_freep(pctx);
+        return;
+    }
+
     nb_workers = ctx->nb_threads;
     if (!ctx->main_func)
         nb_workers--;
@@ -246,6 +306,15 @@ int avpriv_slicethread_create(AVSliceThread **pctx, void *priv,
     return AVERROR(ENOSYS);
 }
 
+int avpriv_slicethread_create_executor(AVSliceThread **pctx, void *priv,
+                                       void (*worker_func)(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads),
+                                       void (*main_func)(void *priv),
+                                       int nb_threads, AVExecutor *executor)
+{
+    *pctx = NULL;
+    return AVERROR(ENOSYS);
+}
+
 void avpriv_slicethread_execute(AVSliceThread *ctx, int nb_jobs, int execute_main)
 {
     av_assert0(0);
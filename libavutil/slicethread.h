@@ -19,6 +19,8 @@
 #ifndef AVUTIL_SLICETHREAD_H
 #define AVUTIL_SLICETHREAD_H
 
+#include "executor.h"
+
 typedef struct AVSliceThread AVSliceThread;
 
 /**
@@ -35,6 +37,21 @@ int avpriv_slicethread_create(AVSliceThread **pctx, void *priv,
                               void (*main_func)(void *priv),
                               int nb_threads);
 
+/**
+ * Create slice threading context running its jobs on a shared executor
+ * instead of its own threads.
+ * The jobs of one execution must not wait for each other, as they may not run
+ * concurrently; main_func may wait for them.
+ * @param nb_threads number of concurrent jobs, 0 for the number of executor
+ *                   threads plus the calling thread, must be >= 0
+ * @param executor executor to use, if NULL this is avpriv_slicethread_create()
+ * @return return number of threads or negative AVERROR on failure
+ */
+int avpriv_slicethread_create_executor(AVSliceThread **pctx, void *priv,
+                                       void (*worker_func)(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads),
+                                       void (*main_func)(void *priv),
+                                       int nb_threads, AVExecutor *executor);
+
 /**
  * Execute slice threading.
  * @param ctx slice threading context
@@ -19,6 +19,7 @@
 #include <string.h>
 
 #include "libavutil/log.h"
+#include "libavutil/macros.h"
 #include "libavutil/mem_internal.h"
 #include "libavutil/aes_ctr.h"
 
@@ -27,11 +28,14 @@ static const DECLARE_ALIGNED(8, uint8_t, plain)[] = {
 };
 static DECLARE_ALIGNED(8, uint8_t, tmp)[11];
 
+static uint8_t long_plain[1000], long_enc[1000], long_tmp[1000];
+
 int main (void)
 {
     int ret = 1;
     struct AVAESCTR *ae, *ad;
     const uint8_t *iv;
+    uint8_t full_iv[16];
 
     ae = av_aes_ctr_alloc();
     ad = av_aes_ctr_alloc();
@@ -48,6 +52,7 @@ int main (void)
     av_aes_ctr_set_random_iv(ae);
     iv =   av_aes_ctr_get_iv(ae);
     av_aes_ctr_set_full_iv(ad, iv);
+    memcpy(full_iv, iv, sizeof(full_iv));
 
     av_aes_ctr_crypt(ae, tmp, plain, sizeof(tmp));
     av_aes_ctr_crypt(ad, tmp, tmp,   sizeof(tmp));
@@ -57,6 +62,30 @@ int main (void)
         goto ERROR;
     }
 
+    /* encrypting in uneven pieces must give the same result as in one go */
+    for (int i = 0; i < sizeof(long_plain); i++)
+        long_plain[i] = i * 7 + 3;
+    av_aes_ctr_set_full_iv(ae, full_iv);
+    av_aes_ctr_set_full_iv(ad, full_iv);
+    av_aes_ctr_crypt(ae, long_enc, long_plain, sizeof(long_enc));
+    for (int pos = 0, size = 1; pos < sizeof(long_tmp); size = size * 3 % 67 + 1) {
+        size = FFMIN(size, sizeof(long_tmp) - pos);
+        av_aes_ctr_crypt(ad, long_tmp + pos, long_plain + pos, size);
+        pos += size;
+    }
+
+    if (memcmp(long_tmp, long_enc, sizeof(long_tmp)) != 0) {
+        av_log(NULL, AV_LOG_ERROR, "chunked test failed\n");
+        goto ERROR;
+    }
+
+    av_aes_ctr_set_full_iv(ad, full_iv);
+    av_aes_ctr_crypt(ad, long_tmp, long_enc, sizeof(long_tmp));
+    if (memcmp(long_tmp, long_plain, sizeof(long_tmp)) != 0) {
+        av_log(NULL, AV_LOG_ERROR, "long test failed\n");
+        goto ERROR;
+    }
+
     av_log(NULL, AV_LOG_INFO, "test passed\n");
     ret = 0;
 
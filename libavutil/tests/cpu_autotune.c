@@ -0,0 +1,95 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdio.h>
+
+#include "libavutil/cpu.h"
+#include "libavutil/cpu_internal.h"
+
+static volatile unsigned sink;
+static int nb_bench;
+
+static void work(int n)
+{
+    unsigned x = sink;
+
+    for (int i = 0; i < n; i++)
+        x = x * 1664525 + 1013904223;
+    sink = x;
+}
+
+static void impl_fast(void)
+{
+    work(100);
+}
+
+static void impl_slow(void)
+{
+    work(10000);
+}
+
+static void bench(void *opaque, void *func)
+{
+    void (*impl)(void) = func;
+
+    nb_bench++;
+    impl();
+}
+
+static void test(const char *label, const char *key)
+{
+    /* the slow one is last, i.e. the default */
+    static const char *const names[] = { "fast", "slow" };
+    void *const funcs[] = { impl_fast, impl_slow };
+    int i;
+
+    nb_bench = 0;
+    i = avpriv_cpu_autotune(key, names, funcs, 2, bench, NULL);
+    printf("%s: %s, %s\n", label, names[i],
+           nb_bench ? "benchmarked" : "not benchmarked");
+}
+
+int main(int argc, char **argv)
+{
+    int ret;
+
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <cache file>\n", argv[0]);
+        return 1;
+    }
+    remove(argv[1]);
+
+    test("disabled", "test.a");
+
+    if ((ret = av_cpu_set_autotune(1, argv[1])) < 0)
+        return 1;
+    test("enabled", "test.a");
+    test("cached", "test.a");
+
+    /* start over from the cache file */
+    if ((ret = av_cpu_set_autotune(1, argv[1])) < 0)
+        return 1;
+    test("reloaded", "test.a");
+    test("other function", "test.b");
+
+    av_cpu_set_autotune(0, NULL);
+    test("disabled again", "test.a");
+
+    remove(argv[1]);
+    return 0;
+}
@@ -23,6 +23,7 @@
 #include <string.h>
 
 #include "libavutil/libm.h"
+#include "libavutil/macros.h"
 #include "libavutil/eval.h"
 
 static const double const_values[] = {
@@ -140,6 +141,22 @@ int main(int argc, char **argv)
         "clip(0, 0/0, 1)",
         NULL
     };
+    static const char *const array_exprs[] = {
+        "PI*2+E-3/4",
+        "-PI;PI/2",
+        "if(gt(PI,0),sqrt(PI),-PI)+ifnot(PI,1)+if(lt(PI,-10),2)",
+        "clip(PI,-1,1)-clip(PI,1,-1)+between(PI,-1,1)",
+        "mod(PI,1.5)+mod(PI,0)",
+        "bitand(PI,3)+bitor(PI,8)-trunc(PI)*gcd(PI,6)",
+        "-floor(PI)+ceil(PI)*round(PI)",
+        "lerp(0,PI,0.5)+squish(PI/10)+gauss(PI)",
+        "pow(PI,2)/(PI-1)",
+        "eq(PI,0)+gte(PI,1)+lt(PI,2)+lte(PI,3)+min(PI,1)+max(PI,2)",
+        "hypot(PI,1)+atan2(PI,1)+isnan(PI)+isinf(PI/0)+not(PI)+sgn(PI)",
+        "-sin(PI)*cos(2*PI+1)+exp(PI/100)",
+        "st(0,PI);ld(0)*2+ld(1)",
+        NULL
+    };
     int ret;
 
     for (expr = exprs; *expr; expr++) {
@@ -168,6 +185,31 @@ int main(int argc, char **argv)
     if (ret < 0)
         printf("av_expr_parse_and_eval failed\n");
 
+    /* av_expr_eval_array() must match av_expr_eval() for every element */
+    for (expr = array_exprs; *expr; expr++) {
+        double x[300], res[300], values[] = { 0, M_E, 0 };
+        const double *arrays[] = { x, NULL };
+        AVExpr *e;
+
+        if (av_expr_parse(&e, *expr, const_names, NULL, NULL, NULL, NULL, 0, NULL) < 0) {
+            printf("av_expr_parse failed for '%s'\n", *expr);
+            continue;
+        }
+        for (i = 0; i < FF_ARRAY_ELEMS(x); i++)
+            x[i] = i * 0.37 - 50;
+        av_expr_eval_array(e, res, FF_ARRAY_ELEMS(x), values, arrays, NULL);
+        for (i = 0; i < FF_ARRAY_ELEMS(x); i++) {
+            values[0] = x[i];
+            d = av_expr_eval(e, values, NULL);
+            if (d != res[i] && !(isnan(d) && isnan(res[i]))) {
+                printf("av_expr_eval_array mismatch for '%s' at %d: %f != %f\n",
+                       *expr, i, res[i], d);
+                break;
+            }
+        }
+        av_expr_free(e);
+    }
+
     if (argc > 1 && !strcmp(argv[1], "-t")) {
         for (i = 0; i < 1050; i++) {
             START_TIMER;
@@ -0,0 +1,199 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/executor.h"
+#include "libavutil/slicethread.h"
+#include "libavutil/thread.h"
+
+#define NB_THREADS  4
+#define NB_CALLERS  3
+#define NB_OUTER    16
+#define NB_INNER    64
+
+typedef struct Outer {
+    AVExecutor *e;
+    atomic_int  sums[NB_OUTER];
+    atomic_int  main_done;
+} Outer;
+
+typedef struct Inner {
+    Outer *outer;
+    int    index;
+} Inner;
+
+static void inner_job(void *arg, int jobnr)
+{
+    Inner *in = arg;
+    atomic_fetch_add(&in->outer->sums[in->index], jobnr + 1);
+}
+
+/* every outer job runs and waits for a nested batch on the same executor */
+static void outer_job(void *arg, int jobnr)
+{
+    Inner in = { arg, jobnr };
+    av_executor_execute(in.outer->e, inner_job, NULL, &in, NB_INNER);
+}
+
+static void outer_main(void *arg)
+{
+    Outer *o = arg;
+    atomic_store(&o->main_done, 1);
+}
+
+static int check_outer(Outer *o, int with_main)
+{
+    int i;
+
+    for (i = 0; i < NB_OUTER; i++) {
+        if (atomic_load(&o->sums[i]) != NB_INNER * (NB_INNER + 1) / 2) {
+            fprintf(stderr, "wrong sum for job %d: %d\n", i, atomic_load(&o->sums[i]));
+            return 1;
+        }
+    }
+    if (atomic_load(&o->main_done) != with_main) {
+        fprintf(stderr, "main function %s\n", with_main ? "not called" : "called");
+        return 1;
+    }
+    return 0;
+}
+
+static int run_outer(AVExecutor *e, int with_main)
+{
+    Outer o = { .e = e };
+    int i;
+
+    for (i = 0; i < NB_OUTER; i++)
+        atomic_init(&o.sums[i], 0);
+    atomic_init(&o.main_done, 0);
+
+    av_executor_execute(e, outer_job, with_main ? outer_main : NULL, &o, NB_OUTER);
+    return check_outer(&o, with_main);
+}
+
+typedef struct Caller {
+    AVExecutor *e;
+    pthread_t   thread;
+    int         ret;
+} Caller;
+
+static void *caller_thread(void *arg)
+{
+    Caller *c = arg;
+    int i;
+
+    for (i = 0; i < 20 && !c->ret; i++)
+        c->ret = run_outer(c->e, i & 1);
+    return NULL;
+}
+
+typedef struct Slices {
+    int        nb_threads;
+    atomic_int jobs[NB_INNER];
+    int        error;
+} Slices;
+
+static void slice_worker(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads)
+{
+    Slices *s = priv;
+
+    if (threadnr < 0 || threadnr >= nb_threads || nb_threads > s->nb_threads)
+        s->error = 1;
+    atomic_fetch_add(&s->jobs[jobnr], 1);
+}
+
+static int test_slicethread(AVExecutor *e)
+{
+    AVSliceThread *thread;
+    Slices s = { 0 };
+    int i;
+
+    for (i = 0; i < NB_INNER; i++)
+        atomic_init(&s.jobs[i], 0);
+
+    s.nb_threads = avpriv_slicethread_create_executor(&thread, &s, slice_worker,
+                                                      NULL, 0, e);
+    if (s.nb_threads != NB_THREADS + 1) {
+        fprintf(stderr, "wrong number of slice threads: %d\n", s.nb_threads);
+        avpriv_slicethread_free(&thread);
+        return 1;
+    }
+
+    avpriv_slicethread_execute(thread, NB_INNER, 0);
+    avpriv_slicethread_execute(thread, 2, 0);
+    avpriv_slicethread_free(&thread);
+
+    for (i = 0; i < NB_INNER; i++) {
+        if (atomic_load(&s.jobs[i]) != 1 + (i < 2)) {
+            fprintf(stderr, "slice %d run %d times\n", i, atomic_load(&s.jobs[i]));
+            return 1;
+        }
+    }
+    if (s.error)
+        fprintf(stderr, "wrong slice thread index\n");
+    return s.error;
+}
+
+int main(void)
+{
+    Caller callers[NB_CALLERS];
+    AVExecutor *e;
+    int i, ret = 0;
+
+    e = av_executor_alloc(NB_THREADS);
+    if (!e) {
+        fprintf(stderr, "av_executor_alloc failed\n");
+        return 1;
+    }
+    if (av_executor_nb_threads(e) != NB_THREADS) {
+        fprintf(stderr, "wrong number of threads: %d\n", av_executor_nb_threads(e));
+        ret = 1;
+        goto end;
+    }
+
+    if ((ret = run_outer(e, 0)) || (ret = run_outer(e, 1)))
+        goto end;
+
+    /* several threads submitting to the executor concurrently */
+    for (i = 0; i < NB_CALLERS; i++) {
+        callers[i].e   = e;
+        callers[i].ret = 0;
+        if ((ret = pthread_create(&callers[i].thread, NULL, caller_thread, &callers[i]))) {
+            fprintf(stderr, "pthread_create failed: %s.\n", strerror(ret));
+            while (i--)
+                pthread_join(callers[i].thread, NULL);
+            ret = 1;
+            goto end;
+        }
+    }
+    for (i = 0; i < NB_CALLERS; i++) {
+        pthread_join(callers[i].thread, NULL);
+        ret |= callers[i].ret;
+    }
+    if (ret)
+        goto end;
+
+    ret = test_slicethread(e);
+
+end:
+    av_executor_free(&e);
+    return ret;
+}
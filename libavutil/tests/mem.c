@@ -0,0 +1,147 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libavutil/error.h"
+#include "libavutil/mem.h"
+
+/* every block is preceded by a header recording the offset to the start of
+ * the underlying malloc() block, so that blocks can be aligned */
+#define HEADER 64
+
+typedef struct Stats {
+    int allocs, reallocs, frees, live;
+    size_t max_align;
+} Stats;
+
+static void *test_alloc(void *opaque, size_t size, size_t align)
+{
+    Stats *s = opaque;
+    uint8_t *base, *ptr;
+
+    if (!size || align > HEADER || (align & (align - 1)))
+        return NULL;
+    base = malloc(size + HEADER);
+    if (!base)
+        return NULL;
+    ptr = (uint8_t *)(((uintptr_t)base + HEADER) & ~(uintptr_t)(align - 1));
+    ((size_t *)ptr)[-1] = ptr - base;
+
+    if (align > s->max_align)
+        s->max_align = align;
+    s->allocs++;
+    s->live++;
+    return ptr;
+}
+
+static void test_free(void *opaque, void *ptr)
+{
+    Stats *s = opaque;
+    uint8_t *p = ptr;
+
+    free(p - ((size_t *)p)[-1]);
+    s->frees++;
+    s->live--;
+}
+
+static void *test_realloc(void *opaque, void *ptr, size_t size)
+{
+    Stats *s = opaque;
+    uint8_t *p = ptr, *base;
+    size_t offset;
+
+    if (!size)
+        return NULL;
+    if (!p)
+        return test_alloc(opaque, size, 16);
+    offset = ((size_t *)p)[-1];
+    base = realloc(p - offset, size + HEADER);
+    if (!base)
+        return NULL;
+    s->reallocs++;
+    return base + offset;
+}
+
+int main(void)
+{
+    static const char str[] = "allocated by the custom allocator";
+    Stats stats = { 0 };
+    AVMemAllocator allocator = {
+        .opaque  = &stats,
+        .alloc   = test_alloc,
+        .realloc = test_realloc,
+        .free    = test_free,
+    };
+    AVMemAllocator incomplete = allocator;
+    char *s;
+    void **array = NULL;
+    int nb = 0, ret;
+    uint8_t *buf;
+
+    incomplete.free = NULL;
+    if ((ret = av_mem_set_allocator(&incomplete)) != AVERROR(EINVAL)) {
+        printf("incomplete allocator not rejected: %d\n", ret);
+        return 1;
+    }
+    if ((ret = av_mem_set_allocator(&allocator)) < 0) {
+        printf("setting the allocator failed: %d\n", ret);
+        return 1;
+    }
+    if ((ret = av_mem_set_allocator(&allocator)) != AVERROR(EBUSY)) {
+        printf("allocator set twice: %d\n", ret);
+        return 1;
+    }
+
+    buf = av_mallocz(1000);
+    if (!buf || ((uintptr_t)buf & (stats.max_align - 1)) || buf[999]) {
+        printf("av_mallocz failed\n");
+        return 1;
+    }
+    buf = av_realloc(buf, 5000);
+    if (!buf) {
+        printf("av_realloc failed\n");
+        return 1;
+    }
+    memset(buf, 1, 5000);
+    av_freep(&buf);
+
+    s = av_strdup(str);
+    if (!s || strcmp(s, str)) {
+        printf("av_strdup failed\n");
+        return 1;
+    }
+    av_free(s);
+
+    for (int i = 0; i < 100; i++) {
+        if (av_dynarray_add_nofree(&array, &nb, (void *)str) < 0) {
+            printf("av_dynarray_add_nofree failed\n");
+            return 1;
+        }
+    }
+    av_freep(&array);
+    av_free(NULL);
+
+    printf("allocs %d, reallocs %d, frees %d, live %d\n",
+           stats.allocs, stats.reallocs, stats.frees, stats.live);
+
+    return stats.live != 0 || !stats.allocs || !stats.reallocs;
+}
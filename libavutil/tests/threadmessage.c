@@ -0,0 +1,137 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdatomic.h>
+#include <stdio.h>
+
+#include "libavutil/common.h"
+#include "libavutil/error.h"
+#include "libavutil/thread.h"
+#include "libavutil/threadmessage.h"
+
+#define MAX_SENDERS 3
+#define NB_MSGS     20000
+#define QUEUE_SIZE  4
+
+typedef struct Msg {
+    int sender;
+    int seq;
+} Msg;
+
+typedef struct Sender {
+    AVThreadMessageQueue *mq;
+    atomic_int           *nb_running;
+    int                   index;
+} Sender;
+
+static void *sender_thread(void *arg)
+{
+    Sender *s = arg;
+    Msg msgs[5];
+    int seq = 0;
+
+    while (seq < NB_MSGS) {
+        /* alternate single messages and batches of various sizes */
+        int nb = FFMIN(1 + seq % 5, NB_MSGS - seq), ret;
+
+        for (int i = 0; i < nb; i++)
+            msgs[i] = (Msg){ s->index, seq + i };
+        ret = av_thread_message_queue_send_batch(s->mq, msgs, nb, 0);
+        if (ret <= 0) {
+            printf("sender %d: send failed: %d\n", s->index, ret);
+            break;
+        }
+        seq += ret;
+    }
+
+    /* the last sender to finish ends the stream */
+    if (atomic_fetch_sub(s->nb_running, 1) == 1)
+        av_thread_message_queue_set_err_recv(s->mq, AVERROR_EOF);
+    return NULL;
+}
+
+static int test_queue(const char *name, unsigned flags, int nb_senders,
+                      unsigned queue_size)
+{
+    AVThreadMessageQueue *mq;
+    Sender senders[MAX_SENDERS];
+    pthread_t threads[MAX_SENDERS];
+    atomic_int nb_running = ATOMIC_VAR_INIT(nb_senders);
+    int next_seq[MAX_SENDERS] = { 0 };
+    int total = 0, ret;
+
+    ret = av_thread_message_queue_alloc2(&mq, queue_size, sizeof(Msg), flags);
+    if (ret < 0) {
+        printf("%s: alloc failed: %d\n", name, ret);
+        return 1;
+    }
+
+    for (int i = 0; i < nb_senders; i++) {
+        senders[i] = (Sender){ mq, &nb_running, i };
+        if (pthread_create(&threads[i], NULL, sender_thread, &senders[i])) {
+            printf("%s: pthread_create failed\n", name);
+            return 1;
+        }
+    }
+
+    while (1) {
+        Msg msgs[7];
+
+        ret = av_thread_message_queue_recv_batch(mq, msgs, 1 + total % 7, 0);
+        if (ret < 0)
+            break;
+        for (int i = 0; i < ret; i++) {
+            if (msgs[i].seq != next_seq[msgs[i].sender]++) {
+                printf("%s: message %d of sender %d out of order\n",
+                       name, msgs[i].seq, msgs[i].sender);
+                ret = AVERROR_BUG;
+            }
+        }
+        if (ret < 0)
+            break;
+        total += ret;
+    }
+
+    for (int i = 0; i < nb_senders; i++)
+        pthread_join(threads[i], NULL);
+    av_thread_message_queue_free(&mq);
+
+    printf("%s: %d messages, %s\n", name, total, av_err2str(ret));
+    return ret != AVERROR_EOF || total != nb_senders * NB_MSGS;
+}
+
+int main(void)
+{
+    AVThreadMessageQueue *mq;
+    int ret = 0;
+
+    if (av_thread_message_queue_alloc2(&mq, QUEUE_SIZE, sizeof(Msg),
+                                       AV_THREAD_MESSAGE_QUEUE_SPSC |
+                                       AV_THREAD_MESSAGE_QUEUE_MPSC) != AVERROR(EINVAL)) {
+        printf("invalid flags not rejected\n");
+        return 1;
+    }
+
+    ret |= test_queue("locked", 0,                            MAX_SENDERS, QUEUE_SIZE);
+    ret |= test_queue("spsc",   AV_THREAD_MESSAGE_QUEUE_SPSC, 1,           QUEUE_SIZE);
+    ret |= test_queue("spsc/1", AV_THREAD_MESSAGE_QUEUE_SPSC, 1,           1);
+    ret |= test_queue("mpsc",   AV_THREAD_MESSAGE_QUEUE_MPSC, MAX_SENDERS, QUEUE_SIZE);
+    ret |= test_queue("mpsc/1", AV_THREAD_MESSAGE_QUEUE_MPSC, MAX_SENDERS, 1);
+
+    return ret;
+}
@@ -19,29 +19,69 @@
  */
 
 #include <limits.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "common.h"
 #include "fifo.h"
 #include "mem.h"
 #include "threadmessage.h"
 #include "thread.h"
 
+/* number of times a thread checks a lock-free queue again before sleeping */
+#define SPIN_COUNT 1000
+
 struct AVThreadMessageQueue {
 #if HAVE_THREADS
     AVFifo *fifo;
     pthread_mutex_t lock;
     pthread_cond_t cond_recv;
     pthread_cond_t cond_send;
-    int err_send;
-    int err_recv;
+    atomic_int err_send;
+    atomic_int err_recv;
     unsigned elsize;
     void (*free_func)(void *msg);
+
+    /* lock-free queues only; the fifo is not used, the mutex and the
+     * condition variables only serve for the threads to sleep */
+    unsigned flags;
+    unsigned nelem;
+    uint8_t *msgs;
+    /* sequence number of every slot: twice the position of the next message
+     * to write in it when free, that + 1 when the message is written */
+    atomic_size_t *seq;
+    atomic_size_t send_pos;
+    atomic_size_t recv_pos;
+    atomic_int nb_send_waiting;
+    atomic_int nb_recv_waiting;
 #else
     int dummy;
 #endif
 };
 
-int av_thread_message_queue_alloc(AVThreadMessageQueue **mq,
-                                  unsigned nelem,
-                                  unsigned elsize)
+#if HAVE_THREADS
+static int alloc_lockfree(AVThreadMessageQueue *mq, unsigned nelem)
+{
+    if (!(mq->msgs = av_malloc_array(nelem, mq->elsize)) ||
+        !(mq->seq  = av_malloc_array(nelem, sizeof(*mq->seq))))
+        return AVERROR(ENOMEM);
+
+    for (unsigned i = 0; i < nelem; i++)
+        atomic_init(&mq->seq[i], 2 * (size_t)i);
+    atomic_init(&mq->send_pos, 0);
+    atomic_init(&mq->recv_pos, 0);
+    atomic_init(&mq->nb_send_waiting, 0);
+    atomic_init(&mq->nb_recv_waiting, 0);
+    mq->nelem = nelem;
+    return 0;
+}
+#endif
+
+int av_thread_message_queue_alloc2(AVThreadMessageQueue **mq,
+                                   unsigned nelem,
+                                   unsigned elsize,
+                                   unsigned flags)
 {
 #if HAVE_THREADS
     AVThreadMessageQueue *rmq;
@@ -49,6 +89,10 @@ int av_thread_message_queue_alloc(AVThreadMessageQueue **mq,
 
     if (nelem > INT_MAX / elsize)
         return AVERROR(EINVAL);
+    if (flags & ~(AV_THREAD_MESSAGE_QUEUE_SPSC | AV_THREAD_MESSAGE_QUEUE_MPSC) ||
+        flags == (AV_THREAD_MESSAGE_QUEUE_SPSC | AV_THREAD_MESSAGE_QUEUE_MPSC) ||
+        (flags && !nelem))
+        return AVERROR(EINVAL);
     if (!(rmq = av_mallocz(sizeof(*rmq))))
         return AVERROR(ENOMEM);
     if ((ret = pthread_mutex_init(&rmq->lock, NULL))) {
@@ -66,14 +110,20 @@ int av_thread_message_queue_alloc(AVThreadMessageQueue **mq,
         av_free(rmq);
         return AVERROR(ret);
     }
-    if (!(rmq->fifo = av_fifo_alloc2(nelem, elsize, 0))) {
+    rmq->elsize = elsize;
+    rmq->flags  = flags;
+    atomic_init(&rmq->err_send, 0);
+    atomic_init(&rmq->err_recv, 0);
+    if (flags ? (ret = alloc_lockfree(rmq, nelem)) < 0 :
+                !(rmq->fifo = av_fifo_alloc2(nelem, elsize, 0))) {
+        av_freep(&rmq->seq);
+        av_freep(&rmq->msgs);
         pthread_cond_destroy(&rmq->cond_send);
         pthread_cond_destroy(&rmq->cond_recv);
         pthread_mutex_destroy(&rmq->lock);
         av_free(rmq);
         return AVERROR(ENOMEM);
     }
-    rmq->elsize = elsize;
     *mq = rmq;
     return 0;
 #else
@@ -82,6 +132,13 @@ int av_thread_message_queue_alloc(AVThreadMessageQueue **mq,
 #endif /* HAVE_THREADS */
 }
 
+int av_thread_message_queue_alloc(AVThreadMessageQueue **mq,
+                                  unsigned nelem,
+                                  unsigned elsize)
+{
+    return av_thread_message_queue_alloc2(mq, nelem, elsize, 0);
+}
+
 void av_thread_message_queue_set_free_func(AVThreadMessageQueue *mq,
                                            void (*free_func)(void *msg))
 {
@@ -96,6 +153,8 @@ void av_thread_message_queue_free(AVThreadMessageQueue **mq)
     if (*mq) {
         av_thread_message_flush(*mq);
         av_fifo_freep2(&(*mq)->fifo);
+        av_freep(&(*mq)->seq);
+        av_freep(&(*mq)->msgs);
         pthread_cond_destroy(&(*mq)->cond_send);
         pthread_cond_destroy(&(*mq)->cond_recv);
         pthread_mutex_destroy(&(*mq)->lock);
@@ -108,6 +167,15 @@ int av_thread_message_queue_nb_elems(AVThreadMessageQueue *mq)
 {
 #if HAVE_THREADS
     int ret;
+
+    if (mq->flags) {
+        /* recv_pos never passes send_pos, so reading it first gives a
+         * nonnegative count, which may only be too large */
+        size_t recv_pos = atomic_load_explicit(&mq->recv_pos, memory_order_relaxed);
+        size_t send_pos = atomic_load_explicit(&mq->send_pos, memory_order_relaxed);
+        return FFMIN(send_pos - recv_pos, mq->nelem);
+    }
+
     pthread_mutex_lock(&mq->lock);
     ret = av_fifo_can_read(mq->fifo);
     pthread_mutex_unlock(&mq->lock);
@@ -121,6 +189,7 @@ int av_thread_message_queue_nb_elems(AVThreadMessageQueue *mq)
 
 static int av_thread_message_queue_send_locked(AVThreadMessageQueue *mq,
                                                void *msg,
+                                               unsigned nb_msgs,
                                                unsigned flags)
 {
     while (!mq->err_send && !av_fifo_can_write(mq->fifo)) {
@@ -130,14 +199,19 @@ static int av_thread_message_queue_send_locked(AVThreadMessageQueue *mq,
     }
     if (mq->err_send)
         return mq->err_send;
-    av_fifo_write(mq->fifo, msg, 1);
-    /* one message is sent, signal one receiver */
-    pthread_cond_signal(&mq->cond_recv);
-    return 0;
+    nb_msgs = FFMIN(nb_msgs, av_fifo_can_write(mq->fifo));
+    av_fifo_write(mq->fifo, msg, nb_msgs);
+    /* signal as many receivers as messages were sent */
+    if (nb_msgs > 1)
+        pthread_cond_broadcast(&mq->cond_recv);
+    else
+        pthread_cond_signal(&mq->cond_recv);
+    return nb_msgs;
 }
 
 static int av_thread_message_queue_recv_locked(AVThreadMessageQueue *mq,
                                                void *msg,
+                                               unsigned nb_msgs,
                                                unsigned flags)
 {
     while (!mq->err_recv && !av_fifo_can_read(mq->fifo)) {
@@ -147,23 +221,174 @@ static int av_thread_message_queue_recv_locked(AVThreadMessageQueue *mq,
     }
     if (!av_fifo_can_read(mq->fifo))
         return mq->err_recv;
-    av_fifo_read(mq->fifo, msg, 1);
-    /* one message space appeared, signal one sender */
-    pthread_cond_signal(&mq->cond_send);
-    return 0;
+    nb_msgs = FFMIN(nb_msgs, av_fifo_can_read(mq->fifo));
+    av_fifo_read(mq->fifo, msg, nb_msgs);
+    /* signal as many senders as message spaces appeared */
+    if (nb_msgs > 1)
+        pthread_cond_broadcast(&mq->cond_send);
+    else
+        pthread_cond_signal(&mq->cond_send);
+    return nb_msgs;
+}
+
+/* Wake up the threads sleeping on cond, if any. The caller has just
+ * published a change they may be waiting for; the fence pairs with the one
+ * in lockfree_wait(), so that either the sleeping thread sees the change
+ * before sleeping or this sees the thread sleeping. */
+static void lockfree_wake(AVThreadMessageQueue *mq, atomic_int *nb_waiting,
+                          pthread_cond_t *cond)
+{
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(nb_waiting, memory_order_relaxed)) {
+        pthread_mutex_lock(&mq->lock);
+        pthread_cond_broadcast(cond);
+        pthread_mutex_unlock(&mq->lock);
+    }
+}
+
+static void lockfree_wait(AVThreadMessageQueue *mq, atomic_int *nb_waiting,
+                          pthread_cond_t *cond, atomic_int *err,
+                          int (*ready)(AVThreadMessageQueue *mq))
+{
+    pthread_mutex_lock(&mq->lock);
+    atomic_fetch_add_explicit(nb_waiting, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    if (!atomic_load_explicit(err, memory_order_acquire) && !ready(mq))
+        pthread_cond_wait(cond, &mq->lock);
+    atomic_fetch_sub_explicit(nb_waiting, 1, memory_order_relaxed);
+    pthread_mutex_unlock(&mq->lock);
+}
+
+static int lockfree_can_send(AVThreadMessageQueue *mq)
+{
+    size_t pos = atomic_load_explicit(&mq->send_pos, memory_order_relaxed);
+    size_t seq = atomic_load_explicit(&mq->seq[pos % mq->nelem], memory_order_relaxed);
+    return (ptrdiff_t)(seq - 2 * pos) >= 0;
+}
+
+static int lockfree_can_recv(AVThreadMessageQueue *mq)
+{
+    size_t pos = atomic_load_explicit(&mq->recv_pos, memory_order_relaxed);
+    return atomic_load_explicit(&mq->seq[pos % mq->nelem], memory_order_relaxed) == 2 * pos + 1;
+}
+
+static int lockfree_send_one(AVThreadMessageQueue *mq, const uint8_t *msg)
+{
+    size_t pos = atomic_load_explicit(&mq->send_pos, memory_order_relaxed);
+    atomic_size_t *seq;
+
+    while (1) {
+        ptrdiff_t diff;
+
+        seq  = &mq->seq[pos % mq->nelem];
+        diff = atomic_load_explicit(seq, memory_order_acquire) - 2 * pos;
+        if (diff < 0)
+            return 0;
+        if (!diff) {
+            /* claim the slot; a single sender owns send_pos */
+            if (mq->flags & AV_THREAD_MESSAGE_QUEUE_SPSC) {
+                atomic_store_explicit(&mq->send_pos, pos + 1, memory_order_relaxed);
+                break;
+            }
+            if (atomic_compare_exchange_weak_explicit(&mq->send_pos, &pos, pos + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed))
+                break;
+        } else
+            pos = atomic_load_explicit(&mq->send_pos, memory_order_relaxed);
+    }
+
+    memcpy(mq->msgs + (pos % mq->nelem) * mq->elsize, msg, mq->elsize);
+    atomic_store_explicit(seq, 2 * pos + 1, memory_order_release);
+    return 1;
+}
+
+static int lockfree_recv_one(AVThreadMessageQueue *mq, uint8_t *msg)
+{
+    size_t pos = atomic_load_explicit(&mq->recv_pos, memory_order_relaxed);
+    atomic_size_t *seq = &mq->seq[pos % mq->nelem];
+    uint8_t *slot = mq->msgs + (pos % mq->nelem) * mq->elsize;
+
+    if (atomic_load_explicit(seq, memory_order_acquire) != 2 * pos + 1)
+        return 0;
+
+    if (msg)
+        memcpy(msg, slot, mq->elsize);
+    else if (mq->free_func)
+        mq->free_func(slot);
+    atomic_store_explicit(seq, 2 * (pos + mq->nelem), memory_order_release);
+    atomic_store_explicit(&mq->recv_pos, pos + 1, memory_order_relaxed);
+    return 1;
+}
+
+static int av_thread_message_queue_send_lockfree(AVThreadMessageQueue *mq,
+                                                 uint8_t *msg,
+                                                 unsigned nb_msgs,
+                                                 unsigned flags)
+{
+    for (int spins = 0;; spins++) {
+        unsigned sent = 0;
+        int err = atomic_load_explicit(&mq->err_send, memory_order_relaxed);
+
+        if (err)
+            return err;
+        while (sent < nb_msgs && lockfree_send_one(mq, msg + sent * mq->elsize))
+            sent++;
+        if (sent) {
+            lockfree_wake(mq, &mq->nb_recv_waiting, &mq->cond_recv);
+            return sent;
+        }
+        if ((flags & AV_THREAD_MESSAGE_NONBLOCK))
+            return AVERROR(EAGAIN);
+        if (spins >= SPIN_COUNT)
+            lockfree_wait(mq, &mq->nb_send_waiting, &mq->cond_send,
+                          &mq->err_send, lockfree_can_send);
+    }
+}
+
+static int av_thread_message_queue_recv_lockfree(AVThreadMessageQueue *mq,
+                                                 uint8_t *msg,
+                                                 unsigned nb_msgs,
+                                                 unsigned flags)
+{
+    for (int spins = 0;; spins++) {
+        unsigned received = 0;
+        /* read before the messages, which are sent before the error is set */
+        int err = atomic_load_explicit(&mq->err_recv, memory_order_acquire);
+
+        while (received < nb_msgs && lockfree_recv_one(mq, msg + received * mq->elsize))
+            received++;
+        if (received) {
+            lockfree_wake(mq, &mq->nb_send_waiting, &mq->cond_send);
+            return received;
+        }
+        if (err)
+            return err;
+        if ((flags & AV_THREAD_MESSAGE_NONBLOCK))
+            return AVERROR(EAGAIN);
+        if (spins >= SPIN_COUNT)
+            lockfree_wait(mq, &mq->nb_recv_waiting, &mq->cond_recv,
+                          &mq->err_recv, lockfree_can_recv);
+    }
 }
 
 #endif /* HAVE_THREADS */
 
-int av_thread_message_queue_send(AVThreadMessageQueue *mq,
-                                 void *msg,
-                                 unsigned flags)
+int av_thread_message_queue_send_batch(AVThreadMessageQueue *mq,
+                                       void *msgs,
+                                       unsigned nb_msgs,
+                                       unsigned flags)
 {
 #if HAVE_THREADS
     int ret;
 
+    if (!nb_msgs)
+        return AVERROR(EINVAL);
+    if (mq->flags)
+        return av_thread_message_queue_send_lockfree(mq, msgs, nb_msgs, flags);
+
     pthread_mutex_lock(&mq->lock);
-    ret = av_thread_message_queue_send_locked(mq, msg, flags);
+    ret = av_thread_message_queue_send_locked(mq, msgs, nb_msgs, flags);
     pthread_mutex_unlock(&mq->lock);
     return ret;
 #else
@@ -171,15 +396,21 @@ int av_thread_message_queue_send(AVThreadMessageQueue *mq,
 #endif /* HAVE_THREADS */
 }
 
-int av_thread_message_queue_recv(AVThreadMessageQueue *mq,
-                                 void *msg,
-                                 unsigned flags)
+int av_thread_message_queue_recv_batch(AVThreadMessageQueue *mq,
+                                       void *msgs,
+                                       unsigned nb_msgs,
+                                       unsigned flags)
 {
 #if HAVE_THREADS
     int ret;
 
+    if (!nb_msgs)
+        return AVERROR(EINVAL);
+    if (mq->flags)
+        return av_thread_message_queue_recv_lockfree(mq, msgs, nb_msgs, flags);
+
     pthread_mutex_lock(&mq->lock);
-    ret = av_thread_message_queue_recv_locked(mq, msg, flags);
+    ret = av_thread_message_queue_recv_locked(mq, msgs, nb_msgs, flags);
     pthread_mutex_unlock(&mq->lock);
     return ret;
 #else
@@ -187,6 +418,22 @@ int av_thread_message_queue_recv(AVThreadMessageQueue *mq,
 #endif /* HAVE_THREADS */
 }
 
+int av_thread_message_queue_send(AVThreadMessageQueue *mq,
+                                 void *msg,
+                                 unsigned flags)
+{
+    int ret = av_thread_message_queue_send_batch(mq, msg, 1, flags);
+    return FFMIN(ret, 0);
+}
+
+int av_thread_message_queue_recv(AVThreadMessageQueue *mq,
+                                 void *msg,
+                                 unsigned flags)
+{
+    int ret = av_thread_message_queue_recv_batch(mq, msg, 1, flags);
+    return FFMIN(ret, 0);
+}
+
 void av_thread_message_queue_set_err_send(AVThreadMessageQueue *mq,
                                           int err)
 {
@@ -225,6 +472,13 @@ void av_thread_message_flush(AVThreadMessageQueue *mq)
 #if HAVE_THREADS
     size_t used;
 
+    if (mq->flags) {
+        while (lockfree_recv_one(mq, NULL))
+            ;
+        lockfree_wake(mq, &mq->nb_send_waiting, &mq->cond_send);
+        return;
+    }
+
     pthread_mutex_lock(&mq->lock);
     used = av_fifo_can_read(mq->fifo);
     if (mq->free_func)
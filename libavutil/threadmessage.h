@@ -32,6 +32,23 @@ typedef enum AVThreadMessageFlags {
 
 } AVThreadMessageFlags;
 
+typedef enum AVThreadMessageQueueFlags {
+
+    /**
+     * Lock-free queue for a single sending thread and a single receiving
+     * thread. Threads waiting to send or receive spin for a short while
+     * before sleeping.
+     */
+    AV_THREAD_MESSAGE_QUEUE_SPSC = 1 << 0,
+
+    /**
+     * Lock-free queue for any number of sending threads and a single
+     * receiving thread, otherwise like AV_THREAD_MESSAGE_QUEUE_SPSC.
+     */
+    AV_THREAD_MESSAGE_QUEUE_MPSC = 1 << 1,
+
+} AVThreadMessageQueueFlags;
+
 /**
  * Allocate a new message queue.
  *
@@ -45,6 +62,19 @@ int av_thread_message_queue_alloc(AVThreadMessageQueue **mq,
                                   unsigned nelem,
                                   unsigned elsize);
 
+/**
+ * Allocate a new message queue, like av_thread_message_queue_alloc().
+ *
+ * @param flags   a combination of AVThreadMessageQueueFlags; 0 allocates a
+ *                queue protected by a mutex, usable by any number of threads
+ * @return  >=0 for success; <0 for error, in particular AVERROR(EINVAL) for
+ *          invalid flags or a lock-free queue of 0 elements
+ */
+int av_thread_message_queue_alloc2(AVThreadMessageQueue **mq,
+                                   unsigned nelem,
+                                   unsigned elsize,
+                                   unsigned flags);
+
 /**
  * Free a message queue.
  *
@@ -66,6 +96,39 @@ int av_thread_message_queue_recv(AVThreadMessageQueue *mq,
                                  void *msg,
                                  unsigned flags);
 
+/**
+ * Send several messages on the queue, in a single operation.
+ *
+ * Block until at least one message can be sent, unless
+ * AV_THREAD_MESSAGE_NONBLOCK is set, and send as many of the messages as fit
+ * in the queue.
+ *
+ * @param msgs    array of nb_msgs messages
+ * @param nb_msgs number of messages to send, must be > 0
+ * @return the number of messages sent, which are the first ones of msgs;
+ *         <0 for error
+ */
+int av_thread_message_queue_send_batch(AVThreadMessageQueue *mq,
+                                       void *msgs,
+                                       unsigned nb_msgs,
+                                       unsigned flags);
+
+/**
+ * Receive several messages from the queue, in a single operation.
+ *
+ * Block until at least one message is available, unless
+ * AV_THREAD_MESSAGE_NONBLOCK is set, and receive as many of the available
+ * messages as fit in msgs.
+ *
+ * @param msgs    array of room for nb_msgs messages
+ * @param nb_msgs maximum number of messages to receive, must be > 0
+ * @return the number of messages received; <0 for error
+ */
+int av_thread_message_queue_recv_batch(AVThreadMessageQueue *mq,
+                                       void *msgs,
+                                       unsigned nb_msgs,
+                                       unsigned flags);
+
 /**
  * Set the sending error code.
  *
@@ -109,6 +172,9 @@ int av_thread_message_queue_nb_elems(AVThreadMessageQueue *mq);
  * This function is mostly equivalent to reading and free-ing every message
  * except that it will be done in a single operation (no lock/unlock between
  * reads).
+ *
+ * With a lock-free queue, this must be called by the receiving thread or
+ * while no thread receives from the queue.
  */
 void av_thread_message_flush(AVThreadMessageQueue *mq);
 
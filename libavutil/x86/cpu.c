@@ -20,6 +20,7 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -254,6 +255,40 @@ int ff_get_cpu_flags_x86(void)
     return rval;
 }
 
+void ff_get_cpu_model_x86(char *buf, size_t size)
+{
+#ifdef cpuid
+    int eax, ebx, ecx, edx;
+    int max_std_level, max_ext_level;
+    int family = 0, model = 0, stepping = 0;
+    union { int i[3]; char c[12]; } vendor;
+    union { int i[12]; char c[49]; } brand = { { 0 } };
+    const char *name = "";
+
+    if (!cpuid_test())
+        return;
+
+    cpuid(0, max_std_level, vendor.i[0], vendor.i[2], vendor.i[1]);
+    if (max_std_level >= 1) {
+        cpuid(1, eax, ebx, ecx, edx);
+        family   = ((eax >> 8) & 0xf) + ((eax >> 20) & 0xff);
+        model    = ((eax >> 4) & 0xf) + ((eax >> 12) & 0xf0);
+        stepping = eax & 0xf;
+    }
+
+    cpuid(0x80000000, max_ext_level, ebx, ecx, edx);
+    if (max_ext_level >= 0x80000004) {
+        for (int i = 0; i < 3; i++)
+            cpuid(0x80000002 + i, brand.i[4 * i],     brand.i[4 * i + 1],
+                                  brand.i[4 * i + 2], brand.i[4 * i + 3]);
+        name = brand.c + strspn(brand.c, " ");
+    }
+
+    snprintf(buf, size, "%.12s %d/%d/%d %s",
+             vendor.c, family, model, stepping, name);
+#endif /* cpuid */
+}
+
 size_t ff_get_cpu_max_align_x86(void)
 {
     int flags = av_get_cpu_flags();
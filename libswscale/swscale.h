@@ -30,6 +30,7 @@
 #include <stdint.h>
 
 #include "libavutil/avutil.h"
+#include "libavutil/executor.h"
 #include "libavutil/frame.h"
 #include "libavutil/log.h"
 #include "libavutil/pixfmt.h"
@@ -163,6 +164,18 @@ struct SwsContext *sws_alloc_context(void);
 av_warn_unused_result
 int sws_init_context(struct SwsContext *sws_context, SwsFilter *srcFilter, SwsFilter *dstFilter);
 
+/**
+ * Run the slice threading jobs of the context on an executor shared with
+ * other contexts, codecs or filter graphs instead of threads owned by the
+ * context. The "threads" option then limits the number of jobs running
+ * concurrently, 0 meaning the number of threads of the executor plus the
+ * calling thread.
+ *
+ * Must be called before sws_init_context(). The executor must outlive the
+ * context.
+ */
+void sws_set_executor(struct SwsContext *c, AVExecutor *executor);
+
 /**
  * Free the swscaler context swsContext.
  * If swsContext is NULL, then does nothing.
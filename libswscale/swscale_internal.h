@@ -305,6 +305,7 @@ typedef struct SwsContext {
     struct SwsContext *parent;
 
     AVSliceThread      *slicethread;
+    AVExecutor         *executor;
     struct SwsContext **slice_ctx;
     int                *slice_err;
     int              nb_slice_ctx;
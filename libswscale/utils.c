@@ -1268,13 +1268,19 @@ static enum AVPixelFormat alphaless_fmt(enum AVPixelFormat fmt)
     }
 }
 
+void sws_set_executor(SwsContext *c, AVExecutor *executor)
+{
+    c->executor = executor;
+}
+
 static int context_init_threaded(SwsContext *c,
                                  SwsFilter *src_filter, SwsFilter *dst_filter)
 {
     int ret;
 
-    ret = avpriv_slicethread_create(&c->slicethread, (void*)c,
-                                    ff_sws_slice_worker, NULL, c->nb_threads);
+    ret = avpriv_slicethread_create_executor(&c->slicethread, (void*)c,
+                                             ff_sws_slice_worker, NULL, c->nb_threads,
+                                             c->executor);
     if (ret == AVERROR(ENOSYS)) {
         c->nb_threads = 1;
         return 0;
@@ -156,6 +156,18 @@ fate-filter-interlace-complex: CMD = framecrc -c:v pgmyuv -i $(SRC) -vf interlac
 FATE_FILTER_VSYNTH_PGMYUV-$(call ALLYES, NEGATE_FILTER PERMS_FILTER) += fate-filter-negate
 fate-filter-negate: CMD = framecrc -c:v pgmyuv -i $(SRC) -vf perms=random,negate
 
+FATE_FILTER_VSYNTH_PGMYUV-$(call ALLYES, LUTYUV_FILTER NEGATE_FILTER) += fate-filter-lut-fused
+fate-filter-lut-fused: CMD = framecrc -c:v pgmyuv -i $(SRC) -vf lutyuv=y=val*3/4,negate,lutyuv=u=val/2:v=negval,negate=components=y
+
+FATE_FILTER_VSYNTH_PGMYUV-$(call ALLYES, LUTYUV_FILTER EQ_FILTER NEGATE_FILTER) += fate-filter-eq-fused
+fate-filter-eq-fused: CMD = framecrc -c:v pgmyuv -i $(SRC) -vf lutyuv=y=val*3/4,eq=contrast=1.5:brightness=0.1:saturation=1.3,negate,eq=gamma=1.4:gamma_weight=0.7
+
+FATE_FILTER_VSYNTH_PGMYUV-$(call ALLYES, FORMAT_FILTER SCALE_FILTER LUTRGB_FILTER COLORLEVELS_FILTER NEGATE_FILTER) += fate-filter-colorlevels-fused
+fate-filter-colorlevels-fused: CMD = framecrc -c:v pgmyuv -i $(SRC) -vf scale,format=gbrp,lutrgb=r=val*3/4,colorlevels=rimin=0.1:gimax=0.8:bomin=0.05:romax=0.9,negate -flags +bitexact -sws_flags +accurate_rnd+bitexact
+
+FATE_FILTER_VSYNTH_PGMYUV-$(call ALLYES, HFLIP_FILTER GBLUR_FILTER NEGATE_FILTER LUTYUV_FILTER) += fate-filter-frame-threads
+fate-filter-frame-threads: CMD = framecrc -filter_frame_threads -filter_threads 4 -c:v pgmyuv -i $(SRC) -vf hflip,gblur,negate,lutyuv=y=val/2
+
 FATE_FILTER_VSYNTH_PGMYUV-$(CONFIG_HISTOGRAM_FILTER) += fate-filter-histogram-levels
 fate-filter-histogram-levels: CMD = framecrc -c:v pgmyuv -i $(SRC) -vf histogram -flags +bitexact -sws_flags +accurate_rnd+bitexact
 
@@ -721,6 +733,11 @@ FATE_FILTER-$(call ALLYES, TESTSRC2_FILTER SPLIT_FILTER AVGBLUR_FILTER        \
                            METADATA_FILTER WRAPPED_AVFRAME_ENCODER NULL_MUXER \
                            PIPE_PROTOCOL) += $(FATE_FILTER_REFCMP_METADATA-yes)
 
+FATE_FILTER-$(call ALLYES, TESTSRC_FILTER FORMAT_FILTER SPLIT_FILTER \
+                           NEGATE_FILTER DRAWBOX_FILTER NULLSINK_FILTER) += fate-filter-writable
+fate-filter-writable: libavfilter/tests/writable$(EXESUF)
+fate-filter-writable: CMD = run libavfilter/tests/writable$(EXESUF)
+
 FATE_SAMPLES_FFPROBE += $(FATE_METADATA_FILTER-yes)
 FATE_SAMPLES_FFMPEG += $(FATE_FILTER_SAMPLES-yes)
 FATE_FFMPEG += $(FATE_FILTER-yes)
@@ -57,6 +57,10 @@ fate-cpu_init: libavutil/tests/cpu_init$(EXESUF)
 fate-cpu_init: CMD = run libavutil/tests/cpu_init$(EXESUF)
 fate-cpu_init: CMP = null
 
+FATE_LIBAVUTIL += fate-cpu_autotune
+fate-cpu_autotune: libavutil/tests/cpu_autotune$(EXESUF)
+fate-cpu_autotune: CMD = run libavutil/tests/cpu_autotune$(EXESUF) $(TARGET_PATH)/tests/data/fate/cpu_autotune.cache
+
 FATE_LIBAVUTIL += fate-crc
 fate-crc: libavutil/tests/crc$(EXESUF)
 fate-crc: CMD = run libavutil/tests/crc$(EXESUF)
@@ -79,6 +83,11 @@ fate-encryption-info: libavutil/tests/encryption_info$(EXESUF)
 fate-encryption-info: CMD = run libavutil/tests/encryption_info$(EXESUF)
 fate-encryption-info: CMP = null
 
+FATE_LIBAVUTIL-$(HAVE_THREADS) += fate-executor
+fate-executor: libavutil/tests/executor$(EXESUF)
+fate-executor: CMD = run libavutil/tests/executor$(EXESUF)
+fate-executor: CMP = null
+
 FATE_LIBAVUTIL += fate-eval
 fate-eval: libavutil/tests/eval$(EXESUF)
 fate-eval: CMD = run libavutil/tests/eval$(EXESUF)
@@ -112,6 +121,10 @@ FATE_LIBAVUTIL += fate-md5
 fate-md5: libavutil/tests/md5$(EXESUF)
 fate-md5: CMD = run libavutil/tests/md5$(EXESUF)
 
+FATE_LIBAVUTIL += fate-mem
+fate-mem: libavutil/tests/mem$(EXESUF)
+fate-mem: CMD = run libavutil/tests/mem$(EXESUF)
+
 FATE_LIBAVUTIL += fate-murmur3
 fate-murmur3: libavutil/tests/murmur3$(EXESUF)
 fate-murmur3: CMD = run libavutil/tests/murmur3$(EXESUF)
@@ -148,6 +161,10 @@ FATE_LIBAVUTIL += fate-sha512
 fate-sha512: libavutil/tests/sha512$(EXESUF)
 fate-sha512: CMD = run libavutil/tests/sha512$(EXESUF)
 
+FATE_LIBAVUTIL-$(HAVE_THREADS) += fate-threadmessage
+fate-threadmessage: libavutil/tests/threadmessage$(EXESUF)
+fate-threadmessage: CMD = run libavutil/tests/threadmessage$(EXESUF)
+
 FATE_LIBAVUTIL += fate-tree
 fate-tree: libavutil/tests/tree$(EXESUF)
 fate-tree: CMD = run libavutil/tests/tree$(EXESUF)